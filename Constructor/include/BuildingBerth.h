@@ -52,6 +52,11 @@ namespace ConstructorImpl
         // Add construction object into building berth
         virtual Status      PlaceObject(PlacementParameters& parameters);
 
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Adds construction objects in order as PlaceObject calls do, see Core::SetElements
+        // nothing is placed if any object is not found
+        Status              PlaceObjects(const std::vector<PlacementParameters>& parameters);
+
         ///////////////////////////////////////////////////////////////////////////////////
         // Welds two groups into single one
         virtual bool        Weld(uint32_t group1, uint32_t group2);
@@ -87,6 +92,10 @@ namespace ConstructorImpl
         // virtual const GLMeshDescs& GetMeshDescs() const override;
 
     private:
+        ///////////////////////////////////////////////////////////////////////////////////
+        // placement of the object, construction is null for empty space
+        Status      toPlacement(const PlacementParameters& parameters, Placement& placement);
+
         Library     m_buildingBlocksLibrary;
         Core        m_core;
         Hull        m_hull;
@@ -11,15 +11,16 @@
 
 #include "Constructor.h"
 #include "MeshLibraryImpl.h"
+#include "ObjectConstructor.h"
 
 #include <list>
+#include <map>
 #include <memory>
 
 #include "Resources.h"
 
 namespace ConstructorImpl
 {
-    class Core;
 // on a low level object consists from a set of Cores
     class Hull : public IMesh
     {
@@ -36,12 +37,43 @@ namespace ConstructorImpl
         Hull(MeshLibrary& meshLibrary);
         virtual ~Hull() {};
 
-        // Construct mesh for object
-        void ConstructMesh(Core& objectCore);
+        // Construct mesh for object, geometry of every element is generated
+        // CoreType is one of BasicCore storages: Core, LinearCore, WideCore or BrickCore
+        template <class CoreType>
+        void ConstructMesh(CoreType& objectCore);
+
+        // Regenerates geometry of dirty regions of the core only (see BasicCore::TakeDirtyRegions),
+        // the mesh is constructed from scratch if the whole core is changed
+        // geometry is ordered by regions, elements of a region are in IterrateObject order
+        // ranges of dirty regions are patched in place, the rest of the mesh is not copied
+        // unless sizes of regions are changed: then following geometry is shifted once
+        template <class CoreType>
+        void UpdateMesh(CoreType& objectCore);
 
     private:
+        // geometry of a region in the mesh: offsets and sizes in Positions and Normals
+        struct Range
+        {
+            size_t  positions;
+            size_t  positionsSize;
+            size_t  normals;
+            size_t  normalsSize;
+        };
+
+        typedef std::map<vector3i_t, Range, RegionLess> Regions_t;
+        typedef std::vector< std::pair<vector3i_t, IMesh::Shape> > Parts_t;
+
+        template <class CoreType>
+        void constructRegions(CoreType& objectCore, Parts_t& parts);
+
+        void constructGeometry(int32_t x, int32_t y, int32_t z, const Element& e, const ConstructionDescription& construction, IMesh::Shape& shape) const;
+
+        // replaces geometry of regions by parts ordered by regions, empty parts remove regions
+        void patch(const Parts_t& parts);
+
         MeshLibrary&    m_library;
         IMesh::Desc     m_hullDescription;
+        Regions_t       m_regions;          // ranges of every region with elements
 
         PREVENT_COPY(Hull);
     };
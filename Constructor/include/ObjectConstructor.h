@@ -14,24 +14,75 @@
 #include "Constructor.h"
 
 #include "include/QuadTree.h"
+#include "include/LinearQuadTree.h"
+#include "include/WideQuadTree.h"
 #include "include/RangeList.h"
+#include "include/BrickMap.h"
+#include "include/PillarImage.h"
+#include "include/DisjointSets.h"
+#include "include/Stats.h"
 #include "ConstructionLibraryImpl.h"
 #include <vector>
 #include <list>
+#include <algorithm>
 #include <memory>
+#include <set>
+#include <map>
+#include <utility>
+#include <ostream>
 
 #include "Resources.h"
 
 namespace ConstructorImpl
 {
+    // construction of Core elements, elements of the same construction and type share it
+    struct ElementConstruction
+    {
+        const ConstructionDescription*  construction;
+        uint32_t                        type;
+    };
+
+    // element of Core packed to 12 bytes, the construction and the type are kept by the core,
+    // see BasicCore::GetConstruction and BasicCore::GetType
     struct Element
+    {
+        uint16_t    construction;       // index of ElementConstruction in the core
+        uint16_t    direction;
+        uint16_t    originalDirection;  //secondary direction required for generated elements
+        uint8_t     neighbourhood;      // faces covered by neighbours, pX..nZ of Directions
+        uint8_t     reserved;           // c_deferred while SetElements hasn't updated its neighbourhood
+        uint32_t    group;
+    };
+
+    // pointer free Element of saved constructions, see BasicCore::Save
+    struct StoredElement
+    {
+        static const uint32_t c_reference = UINT32_MAX; // cell covered by a bigger element
+
+        uint32_t    construction;   // primitiveUID of the construction or c_reference
+        uint32_t    type;
+        uint32_t    direction;
+        uint32_t    originalDirection;
+        uint32_t    neighbourhood;
+        uint32_t    group;
+    };
+
+    // element of a batch, see BasicCore::SetElements
+    struct Placement
     {
         const ConstructionDescription*  construction;
-        unsigned int                    type;
-        unsigned int                    direction;
-        unsigned int                    originalDirection; //secondary direction required for generated elements
-        unsigned int                    neighbourhood;
-        unsigned int                    group;
+        vector3i_t                      position;
+        Directions                      direction;
+        Directions                      copySettingsFrom;
+    };
+
+    // memory and shape of the construction, see BasicCore::GetStats
+    struct CoreStats
+    {
+        Utils::TreeStats    pillars;    // 2D map of pillars or the map of bricks
+        Utils::RangeStats   elements;   // ranges of elements of all pillars or bricks
+        size_t              contacts;   // contacts kept by all groups, see BasicCore::Weld
+        size_t              bytes;      // memory of the core, the library is not included
     };
 
     enum ConstructorElements : size_t
@@ -43,11 +94,305 @@ namespace ConstructorImpl
 
     typedef Utils::RangeList<Element> Pillar_t;
 
-    class Core : public IConstructable
+    ///////////////////////////////////////////////////////////////////////////////////
+    // Storages of Core elements, BasicCore is parametrized by one of them
+    // a storage keeps elements by signed positions and visits them as visitor(x, y, z, element)
+    // element images are the same for all storages, so constructions saved by one core can be loaded by another
+
+    ///////////////////////////////////////////////////////////////////////////////////
+    // Keeps construction as a 2D map of pillars (Y is up)
+    // PillarMap is a container of pillars with the QuadTree interface:
+    //    Utils::QuadTree, Utils::LinearQuadTree or Utils::WideQuadTree4x4
+    template <template <class> class PillarMap>
+    class PillarStorage
+    {
+    public:
+        // pillars grow at the ends of ranges if elements are inserted from the bottom
+        static const bool c_orderedInsert = true;
+
+        // the pillar is written only if it has the element, so a miss doesn't copy it
+        Element* get_item_at(const vector3i_t& position)
+        {
+            if (!find(position))
+                return nullptr;
+            return m_pillars.get_item_at(position.x, position.z)->get_item_at(toPillarIndex(position.y));
+        }
+
+        // read only get_item_at, pillars are not copied, so it can be called concurrently
+        const Element* find(const vector3i_t& position) const
+        {
+            const Pillar_t* pillar = m_pillars.find(position.x, position.z);
+            return pillar ? pillar->get_item_at(toPillarIndex(position.y)) : nullptr;
+        }
+
+        void insert(const vector3i_t& position, const Element& element)
+        {
+            m_pillars.item(position.x, position.z).insert(toPillarIndex(position.y), element);
+        }
+
+        // pillars in Z order, elements of a pillar from the bottom
+        template <class Visitor>
+        void visit(Visitor&& visitor)
+        {
+            m_pillars.visit([&](int32_t x, int32_t z, Pillar_t& pillar){
+                pillar.visit([&](size_t y, Element& e){
+                    visitor(x, fromPillarIndex(y), z, e);
+                });
+            });
+        }
+
+        // pillars are visited concurrently, elements of a pillar are visited by a single thread
+        template <class Visitor>
+        void parallel_for_each(Visitor&& visitor)
+        {
+            m_pillars.parallel_for_each([&](int32_t x, int32_t z, Pillar_t& pillar){
+                pillar.visit([&](size_t y, Element& e){
+                    visitor(x, fromPillarIndex(y), z, e);
+                });
+            });
+        }
+
+        template <class R, class Visitor, class Combine>
+        R parallel_reduce(const R& identity, Visitor&& visitor, Combine&& combine)
+        {
+            return m_pillars.parallel_reduce(identity, [&](int32_t x, int32_t z, Pillar_t& pillar, R& accumulator){
+                pillar.visit([&](size_t y, Element& e){
+                    visitor(x, fromPillarIndex(y), z, e, accumulator);
+                });
+            }, combine);
+        }
+
+        // pillars outside of the box are not visited at all, ranges of a pillar are clipped by the box
+        template <class Visitor>
+        void query(const BBox& box, Visitor&& visitor)
+        {
+            const size_t bottom = toPillarIndex(box.LFT.y);
+            const size_t top    = toPillarIndex(box.RBB.y);
+            m_pillars.query(box.LFT.x, box.LFT.z, box.RBB.x, box.RBB.z, [&](int32_t x, int32_t z, Pillar_t& pillar){
+                for (const Pillar_t::span range : pillar.ranges())
+                {
+                    const size_t first = std::max(range.start, bottom);
+                    const size_t last  = std::min(range.start + range.count, top);
+                    for (size_t y = first; y < last; ++y)
+                        visitor(x, fromPillarIndex(y), z, range.items[y - range.start]);
+                }
+            });
+        }
+
+        class Snapshot
+        {
+        public:
+            Snapshot(Snapshot&& other) : m_pillars(std::move(other.m_pillars)) {}
+
+            const Element* find(const vector3i_t& position) const
+            {
+                const Pillar_t* pillar = m_pillars.find(position.x, position.z);
+                return pillar ? pillar->get_item_at(toPillarIndex(position.y)) : nullptr;
+            }
+
+            template <class Visitor>
+            void visit(Visitor&& visitor) const
+            {
+                m_pillars.visit([&](int32_t x, int32_t z, const Pillar_t& pillar){
+                    pillar.visit([&](size_t y, const Element& e){
+                        visitor(x, fromPillarIndex(y), z, e);
+                    });
+                });
+            }
+
+            // writes image of elements, convert(element) makes StoredElement
+            template <class Convert>
+            void write(std::ostream& out, Convert&& convert) const
+            {
+                Utils::PillarImage<StoredElement>::write(out, m_pillars, convert);
+            }
+
+        private:
+            friend class PillarStorage;
+            typedef typename PillarMap<Pillar_t>::Snapshot PillarsSnapshot_t;
+
+            Snapshot(PillarsSnapshot_t&& pillars) : m_pillars(std::move(pillars)) {}
+
+            PillarsSnapshot_t m_pillars;
+        };
+
+        // pillars are shared with the snapshot until the storage modifies them
+        Snapshot snapshot() {return Snapshot(m_pillars.snapshot());}
+
+        // replaces elements by the image, convert(stored) makes Element
+        // pillars are created with a single bulk assign, no per element insertion
+        template <class Convert>
+        void inflate(const Utils::PillarImage<StoredElement>& image, Convert&& convert)
+        {
+            image.inflate(m_pillars, convert);
+        }
+
+        // pillars are leaves of the map, ranges of pillars are elements
+        void stats(Utils::TreeStats& map, Utils::RangeStats& elements)
+        {
+            map = m_pillars.stats();
+            m_pillars.visit([&](int32_t, int32_t, Pillar_t& pillar)
+            {
+                elements += pillar.stats();
+            });
+        }
+
+        void clear() {m_pillars.clear();}
+
+    private:
+        // pillars are indexed by unsigned numbers, Y is shifted by 2^31 to keep the order
+        static size_t  toPillarIndex(int32_t y)      { return static_cast<uint32_t>(y) ^ 0x80000000; }
+        static int32_t fromPillarIndex(size_t index) { return static_cast<int32_t>(static_cast<uint32_t>(index) ^ 0x80000000); }
+
+        PillarMap< Pillar_t > m_pillars;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////
+    // Keeps construction as dense bricks of 16^3 elements (see Utils::BrickMap)
+    // neighbours of an element are mostly in its own brick, so lookups of SetElement
+    // (morph, CopySettingsFrom, UpdateNeighbourhood) skip the hash table and pillar lists
+    // elements are visited brick by brick, images are built through a temporary pillar map
+    class BrickStorage
     {
     public:
-        Core(ConstructionLibrary& objectLibrary);
-        virtual ~Core() {};
+        // bricks are allocated whole, the order of insertion doesn't matter
+        static const bool c_orderedInsert = false;
+
+        typedef Utils::BrickMap<Element> Bricks_t;
+
+        Element* get_item_at(const vector3i_t& position)
+        {
+            return m_bricks.get_item_at(position.x, position.y, position.z);
+        }
+
+        // read only get_item_at, the cache of the last brick is not touched, so it can be called concurrently
+        const Element* find(const vector3i_t& position) const
+        {
+            return m_bricks.find(position.x, position.y, position.z);
+        }
+
+        void insert(const vector3i_t& position, const Element& element)
+        {
+            m_bricks.insert(position.x, position.y, position.z, element);
+        }
+
+        template <class Visitor>
+        void visit(Visitor&& visitor)
+        {
+            m_bricks.visit(visitor);
+        }
+
+        // bricks are visited concurrently, elements of a brick are visited by a single thread
+        template <class Visitor>
+        void parallel_for_each(Visitor&& visitor)
+        {
+            m_bricks.parallel_for_each(visitor);
+        }
+
+        template <class R, class Visitor, class Combine>
+        R parallel_reduce(const R& identity, Visitor&& visitor, Combine&& combine)
+        {
+            return m_bricks.parallel_reduce(identity, visitor, combine);
+        }
+
+        // bricks outside of the box are not visited at all
+        template <class Visitor>
+        void query(const BBox& box, Visitor&& visitor)
+        {
+            m_bricks.query(box.LFT.x, box.LFT.y, box.LFT.z, box.RBB.x, box.RBB.y, box.RBB.z, visitor);
+        }
+
+        class Snapshot
+        {
+        public:
+            Snapshot(Snapshot&& other) : m_bricks(std::move(other.m_bricks)) {}
+
+            const Element* find(const vector3i_t& position) const
+            {
+                return m_bricks.find(position.x, position.y, position.z);
+            }
+
+            template <class Visitor>
+            void visit(Visitor&& visitor) const
+            {
+                m_bricks.visit(visitor);
+            }
+
+            // pillars of the image are collected from bricks first
+            template <class Convert>
+            void write(std::ostream& out, Convert&& convert) const
+            {
+                PillarStorage<Utils::LinearQuadTree> pillars;
+                m_bricks.visit([&](int32_t x, int32_t y, int32_t z, const Element& e)
+                {
+                    pillars.insert(vector3i_t(x, y, z), e);
+                });
+                pillars.snapshot().write(out, convert);
+            }
+
+        private:
+            friend class BrickStorage;
+
+            Snapshot(Bricks_t::Snapshot&& bricks) : m_bricks(std::move(bricks)) {}
+
+            Bricks_t::Snapshot m_bricks;
+        };
+
+        // bricks are shared with the snapshot until the storage modifies them
+        Snapshot snapshot() {return Snapshot(m_bricks.snapshot());}
+
+        template <class Convert>
+        void inflate(const Utils::PillarImage<StoredElement>& image, Convert&& convert)
+        {
+            PillarStorage<Utils::LinearQuadTree> pillars;
+            pillars.inflate(image, convert);
+            m_bricks.clear();
+            pillars.visit([&](int32_t x, int32_t y, int32_t z, const Element& e)
+            {
+                m_bricks.insert(x, y, z, e);
+            });
+        }
+
+        // bricks are leaves of the map, every brick is a range of Bricks_t::c_volume elements
+        void stats(Utils::TreeStats& map, Utils::RangeStats& elements)
+        {
+            map = m_bricks.stats();
+            elements.ranges   = m_bricks.bricks_count();
+            elements.items    = m_bricks.size();
+            elements.capacity = m_bricks.bricks_count() * Bricks_t::c_volume;
+            elements.bytes    = m_bricks.bricks_count() * sizeof(Bricks_t::Brick);
+            map.bytes -= elements.bytes;
+        }
+
+        void clear() {m_bricks.clear();}
+
+    private:
+        Bricks_t m_bricks;
+    };
+
+    // orders coordinates of regions and cells, see BasicCore::TakeDirtyRegions
+    struct RegionLess
+    {
+        bool operator()(const vector3i_t& a, const vector3i_t& b) const
+        {
+            return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+        }
+    };
+
+    ///////////////////////////////////////////////////////////////////////////////////
+    // Core keeps construction elements (Y is up) in Storage:
+    //    PillarStorage<Utils::QuadTree>, PillarStorage<Utils::LinearQuadTree>, PillarStorage<Utils::WideQuadTree4x4> or BrickStorage
+    // all coordinates are signed, construction is not limited by the berth size
+    template <class Storage>
+    class BasicCore : public IConstructable
+    {
+    public:
+        BasicCore(ConstructionLibrary& objectLibrary);
+        virtual ~BasicCore() {};
+
+        // space is split into cubic regions of side 2^c_regionBits, the region of (x, y, z)
+        // is (x >> c_regionBits, y >> c_regionBits, z >> c_regionBits)
+        static const int c_regionBits = 4;
 
         ///////////////////////////////////////////////////////////////////////////////////
         // IConstructable interface
@@ -55,17 +400,49 @@ namespace ConstructorImpl
 
         ///////////////////////////////////////////////////////////////////////////////////
         // Adds element to specified position
+        // throws std::length_error if elements refer 65536 combinations of constructions and types already
         void SetElement(const ConstructionDescription& element, const vector3i_t& position, Directions direction, Directions copySettingsFrom);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Adds elements in the order of placements, the result is the same as SetElement calls
+        // cells of all elements are inserted to the storage at once in storage order,
+        // then elements are written in order of placements with groups of their sources,
+        // neighbourhoods of all elements are updated by a single pass at the end
+        // SetElement is called for every placement if placements overwrite existing elements
+        // or each other, morph (wedges) or the storage doesn't depend on the order of insertion
+        void SetElements(const std::vector<Placement>& placements);
         
         ///////////////////////////////////////////////////////////////////////////////////
-        // Weld two groups into single one
+        // Weld two groups into single one, the welded group gets id of group1
+        // groups are merged as disjoint sets, elements are not visited at all:
+        // only elements touching the other group update their neighbourhood
+        // false if the ids are the same or group2 has no elements (welded before)
         bool Weld(uint32_t group1, uint32_t group2);
 
         ///////////////////////////////////////////////////////////////////////////////////
         // Returns element desc on requested position
         // the function is not a constant, so element can be modified
+        // group of the element is updated to the id of its current group (see Weld)
+        // cells reserved by SetElements for the elements not placed yet are empty
         Element* GetElement(const vector3i_t& position);
 
+        ///////////////////////////////////////////////////////////////////////////////////
+        // id of the current group of the element, elements visited or found by the core
+        // may keep ids of groups welded since then (see Weld)
+        // read only, it can be called concurrently
+        uint32_t GetGroup(const Element& e) const {return m_ids[m_groups.find(e.group)];}
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // read only GetElement, the storage is not modified (shared parts are not copied),
+        // so it's used for lookups and can be called concurrently
+        const Element* FindElement(const vector3i_t& position) const;
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Construction and type of the element, they are kept by the core (see Element)
+        // cells covered by bigger elements refer a construction without primitive (Space)
+        const ConstructionDescription* GetConstruction(const Element& e) const {return m_constructions[e.construction].construction;}
+        uint32_t GetType(const Element& e) const {return m_constructions[e.construction].type;}
+
         ///////////////////////////////////////////////////////////////////////////////////
         // Updates neighborhood of component in pos
         void UpdateNeighbourhood(const vector3i_t& pos, Element& self);
@@ -76,12 +453,120 @@ namespace ConstructorImpl
 
         ///////////////////////////////////////////////////////////////////////////////////
         // Allows to iterrate through Core components
-        void IterrateObject(std::function<void(size_t, size_t, size_t, Element&)> visitor);
+        // visitor is called as visitor(x, y, z, element), see GetGroup for groups of elements
+        template <class Visitor>
+        void IterrateObject(Visitor&& visitor)
+        {
+            m_elements.visit(visitor);
+        }
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Iterrates through Core components in parallel
+        // parts of the storage (pillars or bricks) are visited concurrently,
+        // elements of a part are visited by a single thread
+        template <class Visitor>
+        void ParallelIterrateObject(Visitor&& visitor)
+        {
+            m_elements.parallel_for_each(visitor);
+        }
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Parallel reduction of Core components: every task accumulates its elements
+        // to its own copy of identity with visitor(x, y, z, element, accumulator)
+        // results of tasks are combined with combine(result, accumulator) in IterrateObject order
+        template <class R, class Visitor, class Combine>
+        R ReduceObject(const R& identity, Visitor&& visitor, Combine&& combine)
+        {
+            return m_elements.parallel_reduce(identity, visitor, combine);
+        }
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Iterrates through components inside of box [LFT, RBB) in IterrateObject order
+        // parts of the storage outside of the box are not visited at all
+        template <class Visitor>
+        void IterrateRegion(const BBox& box, Visitor&& visitor)
+        {
+            m_elements.query(box, visitor);
+        }
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Read only view of the construction at the moment of TakeSnapshot call
+        // pillars are shared with the core until the core modifies them, so the snapshot
+        // is cheap to take and to keep, and it can be read by another thread (meshing, autosave)
+        // GetGroup returns ids of groups at the moment of TakeSnapshot call
+        // NOTE: elements refer descriptions of the core and its library, the snapshot must not outlive them
+        class Snapshot
+        {
+        public:
+            const ConstructionDescription& ConstructionDesc() const {return m_desc;}
+
+            const ConstructionDescription* GetConstruction(const Element& e) const {return m_constructions[e.construction].construction;}
+            uint32_t GetType(const Element& e) const {return m_constructions[e.construction].type;}
+            uint32_t GetGroup(const Element& e) const {return m_groups[e.group];}
+
+            const Element* GetElement(const vector3i_t& position) const
+            {
+                return m_elements.find(position);
+            }
+
+            // visitor is called as visitor(x, y, z, element) in IterrateObject order
+            template <class Visitor>
+            void IterrateObject(Visitor&& visitor) const
+            {
+                m_elements.visit(visitor);
+            }
+
+            // writes image of elements, see BasicCore::Load
+            void Save(std::ostream& out) const
+            {
+                m_elements.write(out, [&](const Element& e)
+                {
+                    const StoredElement stored = {
+                        e.construction == c_referenceConstruction ? StoredElement::c_reference : GetConstruction(e)->primitiveUID,
+                        GetType(e), e.direction, e.originalDirection, e.neighbourhood, GetGroup(e)};
+                    return stored;
+                });
+            }
+
+        private:
+            friend class BasicCore;
+            typedef typename Storage::Snapshot ElementsSnapshot_t;
+
+            Snapshot(ElementsSnapshot_t&& elements, const ConstructionDescription& desc, const std::vector<ElementConstruction>& constructions, std::vector<uint32_t>&& groups)
+                : m_elements(std::move(elements)), m_desc(desc), m_constructions(constructions), m_groups(std::move(groups)) {}
+
+            ElementsSnapshot_t                  m_elements;
+            ConstructionDescription             m_desc;
+            std::vector<ElementConstruction>    m_constructions;    // constructions of the core at the moment of TakeSnapshot call
+            std::vector<uint32_t>               m_groups;           // id of the current group of every group id
+        };
+
+        Snapshot TakeSnapshot();
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Saves elements as a pointer free image, constructions are stored by primitiveUID
+        // the image can be loaded from a mapped file with Load
+        void Save(std::ostream& out);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Replaces construction by the saved image, data must be 8 bytes aligned
+        // false if the image is broken or refers unknown constructions, the berth is empty then
+        bool Load(const void* data, size_t size);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Collects memory usage and fragmentation of the storage, O(number of elements)
+        CoreStats GetStats();
 
         ///////////////////////////////////////////////////////////////////////////////////
         // Indicates that geometry was updated since last request
         bool IsUpdated();
 
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Moves regions of elements changed since the last call to regions, see c_regionBits
+        // true if the whole construction is changed (Reset, Load), regions are not listed then
+        // NOTE: changes made by the caller through GetElement are not tracked
+        bool TakeDirtyRegions(std::vector<vector3i_t>& regions);
+
         ///////////////////////////////////////////////////////////////////////////////////
         // Clear berth
         void Reset();
@@ -91,28 +576,129 @@ namespace ConstructorImpl
         // looks for relative element of item. Item will be searched in direction
         const NeighborDesc* findNeighbor(const Element& item, const vector3i_t& direction) const;
 
+        ///////////////////////////////////////////////////////////////////////////////////
+        // same as UpdateNeighbourhood, but neighbors are not modified
+        void updateOwnNeighbourhood(const vector3i_t& pos, Element& self);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // adds groups up to the id
+        void addGroup(uint32_t group);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // remembers neighbours of different groups, Weld updates them only
+        void addContact(const vector3i_t& first, uint32_t firstGroup, const vector3i_t& second, uint32_t secondGroup);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // counts the element of the group, Weld checks that the second group has elements
+        void addMember(uint32_t group);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // the element in position is going to be replaced, it's not counted by its group anymore
+        void replaceMember(const vector3i_t& position);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // the element in position is in place and belongs to the group
+        bool isMember(const vector3i_t& position, uint32_t group) const;
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // drops outdated and repeated contacts of groups grown over their limits
+        // elements must be in place, so it's called at the end of modifications
+        void compactGroups();
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // drops outdated and repeated contacts of the group
+        void compactGroup(uint32_t group);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // group of cells reserved by SetElements, such elements are not visible to GetElement
+        static const unsigned int c_pendingGroup = 0x80000000;
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // Element::reserved of elements written by SetElements, UpdateNeighbourhood doesn't see them
+        static const uint8_t c_deferred = 1;
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // construction of cells covered by bigger elements and of reserved cells
+        static const uint16_t c_referenceConstruction = 0;
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // index of the construction with the type in m_constructions, the construction is added once
+        // throws std::length_error if the index doesn't fit to Element
+        uint16_t constructionIndex(const ConstructionDescription& desc, uint32_t type);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // cells covered by the element besides of its position, they keep references to the element
+        void referenceCells(const ConstructionDescription& desc, const vector3i_t& position, std::vector<vector3i_t>& cells) const;
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // extends the bounding box of the core by the box of the element in position
+        // sums don't overflow: RBB of elements at INT32_MAX is saturated at INT32_MAX
+        void extendBoundingBox(const vector3i_t& position, const BBox& box);
+
+        ///////////////////////////////////////////////////////////////////////////////////
+        // remembers the region of the changed element
+        void markDirty(const vector3i_t& position);
+
         ///////////////////////////////////////////////////////////////////////////////////
         // converts self or neighbor to "joint/connector" objects, angle joints etc.
         void morph(const vector3i_t& position, Element& item);
 
         ///////////////////////////////////////////////////////////////////////////////////
-        // fast rotate operation on multiple by Pi/2 angles
+        // fast rotate operation on multiple by Pi/2 angles, see Orientation::rotate
         vector3i_t rotate(const vector3i_t& vec, unsigned int dst) const;
 
         ConstructionLibrary&        m_library;
 
         ConstructionDescription      m_desc;
-        Utils::QuadTree< Pillar_t >  m_pillars;
+        Storage                      m_elements;
 
         bool                         m_isDirty;
+        bool                         m_allDirty;        // every region is changed
+        std::set<vector3i_t, RegionLess> m_dirtyRegions;
 
         ConstructionDescription      m_reference;
 
+        typedef std::pair<const ConstructionDescription*, uint32_t> ConstructionKey_t;
+        std::vector<ElementConstruction>        m_constructions;        // constructions of elements, see Element
+        std::map<ConstructionKey_t, uint16_t>   m_constructionIndices;  // indices of m_constructions
+
         unsigned int                m_lastGroupIndex;
 
-        PREVENT_COPY(Core);
+        // neighbour cells of different groups: the cell of the group and the cell of another group
+        typedef std::pair<vector3i_t, vector3i_t> Contact;
+
+        // elements of a group are not listed, only its boundary is: contacts are appended only,
+        // outdated and repeated ones are dropped when the list grows twice, see compactGroup
+        struct GroupDesc
+        {
+            GroupDesc() : root(0), elements(0), limit(c_groupListLimit) {}
+
+            uint32_t                root;       // root of the set of element group ids
+            size_t                  elements;   // elements of the group, welded groups have none
+            std::vector<Contact>    contacts;   // contacts of elements with other groups
+            size_t                  limit;      // size of contacts that triggers compaction
+
+            bool overgrown() const {return contacts.size() > limit;}
+        };
+
+        static const size_t c_groupListLimit = 64;
+
+        Utils::DisjointSets         m_groups;           // sets of welded group ids, elements keep an id of their set
+        std::vector<uint32_t>       m_ids;              // id of the group of every root of a set
+        std::vector<GroupDesc>      m_groupDescs;       // indexed by group id
+        std::vector<uint32_t>       m_overgrownGroups;  // groups to compact, see compactGroups
+
+        PREVENT_COPY(BasicCore);
     };
 
+    template <class Storage> const int BasicCore<Storage>::c_regionBits;
+    template <class Storage> const size_t BasicCore<Storage>::c_groupListLimit;
+
+    typedef BasicCore< PillarStorage<Utils::QuadTree> >         Core;
+    typedef BasicCore< PillarStorage<Utils::LinearQuadTree> >   LinearCore;
+    typedef BasicCore< PillarStorage<Utils::WideQuadTree4x4> >  WideCore;
+    typedef BasicCore< BrickStorage >                           BrickCore;
+
 }//end  of namespace constructor
 
 // eof
\ No newline at end of file
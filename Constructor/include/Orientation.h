@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Orientation transforms of elements
+//
+// orientation of an element is a Directions value: the direction (DIRECTION_MASK)
+// and the modificator (MODIFICATOR_MASK). Transforms of all orientations are
+// precomputed, so rotation of a vector is a table lookup and a matrix product
+// without branches.
+//    - pX, nX, nZ, pY and nY directions rotate vectors, pZ and combinations
+//      of directions keep them as they are
+//    - LeftToRight modificator mirrors X before rotation, combinations
+//      of modificators don't mirror
+//    - meshes are not rotated by pY and nY
+//
+/////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Construction.h"
+#include "MathBasics.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace ConstructorImpl
+{
+    namespace Orientation
+    {
+        // every transform has the plain and the mirrored version
+        const size_t c_transformsCount = 12;
+
+        // transform slot of the direction byte of orientation:
+        // 0 - pZ and combinations, 1 - pX, 2 - nX, 3 - nZ, 4 - pY, 5 - nY
+        extern const uint8_t c_directionSlots[256];
+
+        // rotations of neighbour offsets, see rotate
+        extern const int32_t c_rotations[c_transformsCount][3][3];
+
+        // affine transforms of mesh points of the unit cell, see transform
+        extern const float c_transforms[c_transformsCount][3][4];
+
+        // index of the transform of orientation in the tables
+        inline size_t index(unsigned int orientation)
+        {
+            const size_t mirrored = (Directions::LeftToRight == (orientation & MODIFICATOR_MASK)) ? 1 : 0;
+            return c_directionSlots[orientation & DIRECTION_MASK] * 2 + mirrored;
+        }
+
+        // rotates neighbour offset by the transform of the tables
+        inline vector3i_t rotateBy(size_t transform, const vector3i_t& vec)
+        {
+            const int32_t (&m)[3][3] = c_rotations[transform];
+            return vector3i_t(
+                m[0][0] * vec.x + m[0][1] * vec.y + m[0][2] * vec.z,
+                m[1][0] * vec.x + m[1][1] * vec.y + m[1][2] * vec.z,
+                m[2][0] * vec.x + m[2][1] * vec.y + m[2][2] * vec.z);
+        }
+
+        // rotates neighbour offset by multiple of Pi/2 angles
+        inline vector3i_t rotate(const vector3i_t& vec, unsigned int orientation)
+        {
+            return rotateBy(index(orientation), vec);
+        }
+
+        // DirectionIndices value of the unit vector along an axis, -1 for other vectors
+        inline int directionIndex(const vector3i_t& vec)
+        {
+            if (1 != vec.x * vec.x + vec.y * vec.y + vec.z * vec.z)
+                return -1;
+            const int axis = vec.x ? 0 : (vec.y ? 1 : 2);
+            return (vec.x + vec.y + vec.z > 0) ? axis : axis + DirectionIndices::nX_idx;
+        }
+
+        // transforms mesh point of the unit cell and moves it by offset
+        inline void transform(const float* in, unsigned int orientation, const vector3f_t& offset, float* out)
+        {
+            const float (&m)[3][4] = c_transforms[index(orientation)];
+            out[0] = m[0][0] * in[0] + m[0][1] * in[1] + m[0][2] * in[2] + m[0][3] + offset.x;
+            out[1] = m[1][0] * in[0] + m[1][1] * in[1] + m[1][2] * in[2] + m[1][3] + offset.y;
+            out[2] = m[2][0] * in[0] + m[2][1] * in[1] + m[2][2] * in[2] + m[2][3] + offset.z;
+        }
+    }
+}
+
+// eof
@@ -1,6 +1,7 @@
 #include "BuildingBerth.h"
 #include "Library.h"
 #include "Resources.h"
+#include <cmath>
 
 using namespace ConstructorImpl;
 
@@ -45,20 +46,30 @@ ILibrary& BuildingBerth::GetLibrary()
 
 Status BuildingBerth::PlaceObject(PlacementParameters& parameters)
 {
-    const IConstructorObject* obj = m_buildingBlocksLibrary.GetObjectByName(parameters.name);
-    if (nullptr == obj)
-        return Status::ResourceNotFound;
+    Placement placement;
+    const Status status = toPlacement(parameters, placement);
+    if (Status::OK != status || nullptr == placement.construction)
+        return status;
 
-    if (ElementType::Space == obj->GetConstructionId())
-        return Status::OK;
-
-    const ConstructionDescription* desc = m_buildingBlocksLibrary.GetConstructionLibrary().GetConstructionDescription(obj->GetConstructionId());
-    if (nullptr == desc)
-        return Status::ResourceNotFound;
+    m_core.SetElement(*placement.construction, placement.position, placement.direction, placement.copySettingsFrom);
+    return Status::OK;
+}
 
-    vector3i_t pos = vector3i_t(parameters.position.x, parameters.position.y, parameters.position.z);
-    m_core.SetElement(*desc, pos, (Directions)parameters.orientation, (Directions)parameters.placeDirection);
+Status BuildingBerth::PlaceObjects(const std::vector<PlacementParameters>& parameters)
+{
+    std::vector<Placement> placements;
+    placements.reserve(parameters.size());
+    for (const auto& object : parameters)
+    {
+        Placement placement;
+        const Status status = toPlacement(object, placement);
+        if (Status::OK != status)
+            return status;
+        if (placement.construction)
+            placements.push_back(placement);
+    }
 
+    m_core.SetElements(placements);
     return Status::OK;
 }
 
@@ -80,15 +91,15 @@ bool BuildingBerth::Weld(uint32_t group1, uint32_t group2)
 
 uint32_t BuildingBerth::GetGroup(const vector3i_t& position)
 {
-    Element *el = m_core.GetElement(position);
-    return el ? el->group : ~0x0;
+    const Element* el = m_core.FindElement(position);
+    return el ? m_core.GetGroup(*el) : ~0x0;
 }
 
 IMesh& BuildingBerth::GetMesh()
 {
     if (m_core.IsUpdated())
     {
-        m_hull.ConstructMesh(m_core);
+        m_hull.UpdateMesh(m_core);
     }
     return m_hull;
 }
@@ -97,4 +108,34 @@ BBox BuildingBerth::GetBoundingBox() const
 {
     return m_core.ConstructionDesc().boundingBox;
 }
+
+// float coordinates are rounded down, cells out of int32 range are clamped to its ends
+static int32_t toCell(float coordinate)
+{
+    const double cell = floor(static_cast<double>(coordinate));
+    if (cell < INT32_MIN)
+        return INT32_MIN;
+    return (cell > INT32_MAX) ? INT32_MAX : static_cast<int32_t>(cell);
+}
+
+Status BuildingBerth::toPlacement(const PlacementParameters& parameters, Placement& placement)
+{
+    placement.construction = nullptr;
+    const IConstructorObject* obj = m_buildingBlocksLibrary.GetObjectByName(parameters.name);
+    if (nullptr == obj)
+        return Status::ResourceNotFound;
+
+    if (ElementType::Space == obj->GetConstructionId())
+        return Status::OK;
+
+    placement.construction = m_buildingBlocksLibrary.GetConstructionLibrary().GetConstructionDescription(obj->GetConstructionId());
+    if (nullptr == placement.construction)
+        return Status::ResourceNotFound;
+
+    // position may be any int32 cell, negative coordinates are rounded down
+    placement.position = vector3i_t(toCell(parameters.position.x), toCell(parameters.position.y), toCell(parameters.position.z));
+    placement.direction = (Directions)parameters.orientation;
+    placement.copySettingsFrom = (Directions)parameters.placeDirection;
+    return Status::OK;
+}
 // eof
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ConstructionLibraryImpl.h"
 #include <memory>
+#include <cstring>
 
 using namespace ConstructorImpl;
 
@@ -13,6 +14,7 @@ void ConstructionLibrary::Cleanup()
     m_primitiveNameIdMap.clear(); 
     m_primitives.clear();
     m_primitives.resize(ElementType::SimplePrimitivesCount);
+    m_neighborTables.clear();
 }
 
 Status ConstructionLibrary::RegisterPrimitive(std::string name, IConstructablePtr& element)
@@ -23,6 +25,7 @@ Status ConstructionLibrary::RegisterPrimitive(std::string name, IConstructablePt
     size_t id = m_primitives.size();
     m_primitives.push_back(element);
     m_primitiveNameIdMap[name] = id;
+    buildNeighborTable(id);
 
     return Status::OK;
 }
@@ -33,6 +36,7 @@ void ConstructionLibrary::RegisterSimplePrimitive(std::string name, IConstructab
     assert(id < ElementType::SimplePrimitivesCount);
     m_primitives[id].reset(element);
     m_primitiveNameIdMap[name] = id;
+    buildNeighborTable(id);
 }
 
 const uint32_t ConstructionLibrary::GetConstructionId(std::string& name) const
@@ -43,7 +47,7 @@ const uint32_t ConstructionLibrary::GetConstructionId(std::string& name) const
 
 const ConstructionDescription* ConstructionLibrary::GetConstructionDescription(uint32_t type) const
 {
-    return (type >= m_primitives.size()) ? nullptr : &m_primitives[type]->ConstructionDesc();
+    return (type >= m_primitives.size() || !m_primitives[type]) ? nullptr : &m_primitives[type]->ConstructionDesc();
 }
 
 const ConstructionDescription* ConstructionLibrary::GetConstructionDescription(const std::string& name) const
@@ -52,4 +56,30 @@ const ConstructionDescription* ConstructionLibrary::GetConstructionDescription(c
     return (found != m_primitiveNameIdMap.end()) ? &m_primitives[found->second]->ConstructionDesc() : nullptr;
 }
 
+void ConstructionLibrary::buildNeighborTable(size_t id)
+{
+    const ConstructionDescription& desc = m_primitives[id]->ConstructionDesc();
+    if (desc.primitiveUID != id || desc.neighbors.size() >= NeighborTable::c_none)
+        return;
+    if (m_neighborTables.size() <= id)
+        m_neighborTables.resize(id + 1, NeighborTable());
+
+    NeighborTable table;
+    table.construction = &desc;
+    memset(table.relations, NeighborTable::c_none, sizeof(table.relations));
+    for (size_t transform = 0; transform < Orientation::c_transformsCount; ++transform)
+    {
+        for (size_t i = 0; i < desc.neighbors.size(); ++i)
+        {
+            const int direction = Orientation::directionIndex(Orientation::rotateBy(transform, desc.neighbors[i].relationPosition));
+            if (direction < 0)
+                return;
+            uint8_t& relation = table.relations[transform][direction];
+            if (NeighborTable::c_none == relation)
+                relation = static_cast<uint8_t>(i);
+        }
+    }
+    m_neighborTables[id] = table;
+}
+
 // eof
\ No newline at end of file
@@ -7,6 +7,7 @@
 #pragma once
 #include "Library.h"
 #include "Constructor.h"
+#include "Orientation.h"
 #include <vector>
 #include <map>
 #include <string>
@@ -18,6 +19,17 @@
 /////////////////////////////////////////////////////////////////////
 namespace ConstructorImpl
 {
+    // relations of a construction facing world directions for every orientation transform,
+    // see Orientation::index; directions are indexed as DirectionIndices (pX, pY, pZ, nX, nY, nZ)
+    // if several relations face the same direction, the first one is taken
+    struct NeighborTable
+    {
+        static const uint8_t c_none = 0xff;
+
+        const ConstructionDescription*  construction;   // null if the table is not built
+        uint8_t                         relations[Orientation::c_transformsCount][6]; // index in neighbors or c_none
+    };
+
     class ConstructionLibrary
     {
     public:
@@ -30,14 +42,27 @@ namespace ConstructorImpl
         const ConstructionDescription* GetConstructionDescription(uint32_t type) const;
         void RegisterSimplePrimitive(std::string name, IConstructable* element);
 
+        // neighbour table of the registered construction, null if relations of the construction
+        // are not unit vectors or it's not a construction of the library
+        const NeighborTable* GetNeighborTable(const ConstructionDescription& desc) const
+        {
+            const size_t id = desc.primitiveUID;
+            return (id < m_neighborTables.size() && m_neighborTables[id].construction == &desc) ? &m_neighborTables[id] : nullptr;
+        }
+
         void Cleanup();
 
         ConstructionLibrary();
         virtual ~ConstructionLibrary() {};
 
+    private:
+        // tables are indexed by primitiveUID, constructions registered with other ids are not indexed
+        void buildNeighborTable(size_t id);
+
     private: // arguments
         std::map<std::string, size_t>   m_primitiveNameIdMap;
         std::vector<IConstructablePtr>  m_primitives;
+        std::vector<NeighborTable>      m_neighborTables;
         ConstructionDescription         m_dummy;
     };
 }
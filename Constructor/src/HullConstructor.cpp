@@ -1,7 +1,9 @@
 #include "HullConstructor.h"
 #include "ObjectConstructor.h"
 #include "Library.h"
+#include <algorithm>
 #include <assert.h>
+#include <iterator>
 
 using namespace ConstructorImpl;
 
@@ -33,20 +35,196 @@ Hull::Hull(MeshLibrary& library)
     m_hullDescription.Shapes[ConstructorElements::MeshIndex].LayoutType = IMesh::LayoutType::Triangle;
 }
 
-void Hull::ConstructMesh(Core& objectCore)
+// a region range to be placed in a buffer: moved from the old offset or written from data
+struct Segment
 {
+    size_t                      from;
+    size_t                      to;
+    size_t                      size;
+    const std::vector<float>*   data;
+};
+
+// segments are ordered by new offsets, the buffer is resized to size
+static void PatchBuffer(std::vector<float>& buffer, const std::vector<Segment>& segments, size_t size)
+{
+    if (buffer.size() < size)
+        buffer.resize(size);
+
+    // unchanged ranges shifted right are moved from the end, shifted left from the beginning,
+    // so no range is overwritten before it is moved
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it)
+    {
+        if (!it->data && it->to > it->from)
+            std::copy_backward(buffer.begin() + it->from, buffer.begin() + it->from + it->size, buffer.begin() + it->to + it->size);
+    }
+    for (const auto& segment : segments)
+    {
+        if (!segment.data && segment.to < segment.from)
+            std::copy(buffer.begin() + segment.from, buffer.begin() + segment.from + segment.size, buffer.begin() + segment.to);
+    }
+    for (const auto& segment : segments)
+    {
+        if (segment.data)
+            std::copy(segment.data->begin(), segment.data->end(), buffer.begin() + segment.to);
+    }
+    buffer.resize(size);
+}
+
+template <class CoreType>
+void Hull::ConstructMesh(CoreType& objectCore)
+{
+    std::vector<vector3i_t> dirty;
+    objectCore.TakeDirtyRegions(dirty);
+    Parts_t parts;
+    constructRegions(objectCore, parts);
+    patch(parts);
+}
+
+template <class CoreType>
+void Hull::UpdateMesh(CoreType& objectCore)
+{
+    std::vector<vector3i_t> dirty;
+    Parts_t parts;
+    if (objectCore.TakeDirtyRegions(dirty))
+    {
+        constructRegions(objectCore, parts);
+    }
+    else
+    {
+        std::sort(dirty.begin(), dirty.end(), RegionLess());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+        const int32_t side = 1 << CoreType::c_regionBits;
+        parts.resize(dirty.size());
+        for (size_t i = 0; i < dirty.size(); ++i)
+        {
+            IMesh::Shape& part = parts[i].second;
+            parts[i].first = dirty[i];
+            const vector3i_t lft = dirty[i] * side;
+            objectCore.IterrateRegion(BBox(lft, lft + vector3i_t(side, side, side)), [&](int32_t x, int32_t y, int32_t z, Element& e)
+            {
+                constructGeometry(x, y, z, e, *objectCore.GetConstruction(e), part);
+            });
+        }
+    }
+    patch(parts);
+}
+
+template <class CoreType>
+void Hull::constructRegions(CoreType& objectCore, Parts_t& parts)
+{
+    // every task builds geometry of its part of the core split by regions,
+    // parts are concatenated in the core order, so the mesh doesn't depend on threads count
+    const int bits = CoreType::c_regionBits;
+    Parts_t result = objectCore.ReduceObject(Parts_t(), [&](int32_t x, int32_t y, int32_t z, Element& e, Parts_t& part)
+    {
+        const vector3i_t region(x >> bits, y >> bits, z >> bits);
+        if (part.empty() || part.back().first != region)
+            part.push_back(std::make_pair(region, IMesh::Shape()));
+        constructGeometry(x, y, z, e, *objectCore.GetConstruction(e), part.back().second);
+    }, [](Parts_t& result, Parts_t& part)
+    {
+        std::move(part.begin(), part.end(), std::back_inserter(result));
+    });
+
+    // a region may be split between parts, stable sort keeps elements of a region in the core order
+    RegionLess less;
+    std::stable_sort(result.begin(), result.end(), [&](const Parts_t::value_type& a, const Parts_t::value_type& b)
+    {
+        return less(a.first, b.first);
+    });
+    for (auto& part : result)
+    {
+        if (parts.empty() || parts.back().first != part.first)
+        {
+            parts.push_back(std::move(part));
+            continue;
+        }
+        IMesh::Shape& region = parts.back().second;
+        region.Positions.Data.insert(region.Positions.Data.end(), part.second.Positions.Data.begin(), part.second.Positions.Data.end());
+        region.Normals.Data.insert(region.Normals.Data.end(), part.second.Normals.Data.begin(), part.second.Normals.Data.end());
+    }
+
+    // the whole mesh is replaced
+    m_regions.clear();
     m_hullDescription.Shapes[ConstructorElements::MeshIndex].Positions.Data.clear();
     m_hullDescription.Shapes[ConstructorElements::MeshIndex].Normals.Data.clear();
+}
 
-    objectCore.IterrateObject([&](size_t x, size_t y, size_t z, Element& e)
+void Hull::constructGeometry(int32_t x, int32_t y, int32_t z, const Element& e, const ConstructionDescription& construction, IMesh::Shape& shape) const
+{
+    MeshProperties prop = {~static_cast<uint32_t>(e.neighbourhood), vector3f_t(x,y,z), e.direction};
+    m_library.GetMeshObject(construction.primitiveUID).ConstructGeometry(prop, shape);
+}
+
+void Hull::patch(const Parts_t& parts)
+{
+    // merge ranges with parts in the regions order, new offsets are assigned on the way
+    RegionLess less;
+    std::vector<Segment> positions;
+    std::vector<Segment> normals;
+    size_t positionsSize = 0;
+    size_t normalsSize = 0;
+    auto region = m_regions.begin();
+    auto part = parts.begin();
+    while (region != m_regions.end() || part != parts.end())
     {
-        MeshProperties prop = {~e.neighbourhood, vector3f_t(x,y,z), e.direction};
-        m_library.GetMeshObject(e.construction->primitiveUID).ConstructGeometry(prop, m_hullDescription.Shapes[ConstructorElements::MeshIndex]);
-    });
+        if (part == parts.end() || (region != m_regions.end() && less(region->first, part->first)))
+        {
+            Range& range = region->second;
+            const Segment position = {range.positions, positionsSize, range.positionsSize, nullptr};
+            const Segment normal = {range.normals, normalsSize, range.normalsSize, nullptr};
+            positions.push_back(position);
+            normals.push_back(normal);
+            range.positions = positionsSize;
+            range.normals = normalsSize;
+            positionsSize += range.positionsSize;
+            normalsSize += range.normalsSize;
+            ++region;
+            continue;
+        }
+
+        const bool exists = region != m_regions.end() && !less(part->first, region->first);
+        const IMesh::Shape& shape = part->second;
+        if (shape.Positions.Data.empty())
+        {
+            if (exists)
+                region = m_regions.erase(region);
+        }
+        else
+        {
+            if (!exists)
+                region = m_regions.insert(region, std::make_pair(part->first, Range()));
+            const Range range = {positionsSize, shape.Positions.Data.size(), normalsSize, shape.Normals.Data.size()};
+            const Segment position = {0, range.positions, range.positionsSize, &shape.Positions.Data};
+            const Segment normal = {0, range.normals, range.normalsSize, &shape.Normals.Data};
+            positions.push_back(position);
+            normals.push_back(normal);
+            region->second = range;
+            positionsSize += range.positionsSize;
+            normalsSize += range.normalsSize;
+            ++region;
+        }
+        ++part;
+    }
+
+    IMesh::Shape& mesh = m_hullDescription.Shapes[ConstructorElements::MeshIndex];
+    PatchBuffer(mesh.Positions.Data, positions, positionsSize);
+    PatchBuffer(mesh.Normals.Data, normals, normalsSize);
 }
 
 const IMesh::Desc& Hull::GetDesc() const
 {
     return m_hullDescription;
 }
+
+template void Hull::ConstructMesh<Core>(Core& objectCore);
+template void Hull::ConstructMesh<LinearCore>(LinearCore& objectCore);
+template void Hull::ConstructMesh<WideCore>(WideCore& objectCore);
+template void Hull::ConstructMesh<BrickCore>(BrickCore& objectCore);
+template void Hull::UpdateMesh<Core>(Core& objectCore);
+template void Hull::UpdateMesh<LinearCore>(LinearCore& objectCore);
+template void Hull::UpdateMesh<WideCore>(WideCore& objectCore);
+template void Hull::UpdateMesh<BrickCore>(BrickCore& objectCore);
+
 // eof
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Library.h"
+#include "Orientation.h"
 #include <memory>
+#include <algorithm>
 
 ///////////////////////////////////////////////////////////////////////////////////
 // base class for all primitive meshes
@@ -24,34 +26,7 @@ public:
 protected:
     void rotate(const float* in, uint32_t dst, const vector3f_t& offset, float* out) const
     {
-        memcpy(out, in, sizeof(float) * 3);
-
-        switch(dst & MODIFICATOR_MASK)
-        {
-        case Directions::LeftToRight:
-            out[0] = 1 - out[0];
-            break;
-        }
-        
-        float tmp = out[0];
-        switch(dst & DIRECTION_MASK)
-        {
-        case Directions::nX :
-            out[0] = 1 - out[2];
-            out[2] = tmp;
-            break;
-        case Directions::pX :
-            out[0] = out[2];
-            out[2] = 1 - tmp;
-            break;
-        case Directions::nZ : 
-            out[0] = 1 - out[0];
-            out[2] = 1 - out[2];
-            break;
-        default:
-            break;
-        }
-        out[0] += offset.x; out[1] += offset.y; out[2] += offset.z;
+        ConstructorImpl::Orientation::transform(in, dst, offset, out);
     }
 
     void copyTriangles(IMesh::Shape& out_descriptor, const vector3f_t& offset, uint32_t orientation, const index_t* vertexIndices, const index_t* normalIndices, size_t size) const
@@ -60,8 +35,11 @@ protected:
         assert(0 == size % 3);
         std::vector<float>& vertices = out_descriptor.Positions.Data;
         std::vector<float>& normals = out_descriptor.Normals.Data;
-        vertices.reserve(vertices.size() + size * 3);
-        normals.reserve(normals.size() + size * 3);
+        // exact reserve would reallocate the shape on every element of a big mesh, so capacity grows twice at least
+        if (vertices.capacity() < vertices.size() + size * 3)
+            vertices.reserve(std::max(2 * vertices.capacity(), vertices.size() + size * 3));
+        if (normals.capacity() < normals.size() + size * 3)
+            normals.reserve(std::max(2 * normals.capacity(), normals.size() + size * 3));
 
         const int directIndexOrder[3] = {0, 1, 2};
         const int morrorIndexOrder[3] = {1, 0, 2};
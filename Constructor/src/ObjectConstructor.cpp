@@ -1,6 +1,8 @@
 #include "ObjectConstructor.h"
+#include "Orientation.h"
 #include "Library.h"
 #include <assert.h>
+#include <stdexcept>
 
 using namespace ConstructorImpl;
 
@@ -12,36 +14,40 @@ using namespace ConstructorImpl;
 #define max(a, b) (a)>(b) ? (a) : (b)
 #endif
 
-Core::Core(ConstructionLibrary& constructionLibrary) 
+template <class Storage>
+BasicCore<Storage>::BasicCore(ConstructionLibrary& constructionLibrary) 
     : m_library(constructionLibrary)
-    , m_pillars(256)
+    , m_elements()
     , m_isDirty(false)
+    , m_allDirty(true)
     , m_lastGroupIndex(0)
 {
-    m_desc.boundingBox = BBox(vector3i_t(INT32_MAX, INT32_MAX, INT32_MAX), vector3i_t(0,0,0));
+    m_desc.boundingBox = BBox(vector3i_t(INT32_MAX, INT32_MAX, INT32_MAX), vector3i_t(INT32_MIN, INT32_MIN, INT32_MIN));
+    constructionIndex(m_reference, ElementType::Space);
+    addGroup(0);
 }
 
-void Core::SetElement(const ConstructionDescription& desc, const vector3i_t& position, Directions direction, Directions copySettingsFrom)
+template <class Storage>
+void BasicCore<Storage>::SetElement(const ConstructionDescription& desc, const vector3i_t& position, Directions direction, Directions copySettingsFrom)
 {
     copySettingsFrom;
-    m_isDirty = true;
+    // constructions are resolved first, so the core is not changed if they don't fit to it
+    std::vector<vector3i_t> cells;
+    referenceCells(desc, position, cells);
+    const uint16_t construction = constructionIndex(desc, desc.primitiveUID);
+    const uint16_t reference = cells.empty() ? c_referenceConstruction : constructionIndex(m_reference, desc.primitiveUID);
+    markDirty(position);
+    replaceMember(position);
 
     m_desc.direction = direction;
     m_desc.primitiveUID = desc.primitiveUID;
 
-    m_desc.boundingBox.LFT = vector3f_t(
-        min(position.x + desc.boundingBox.LFT.x, m_desc.boundingBox.LFT.x),
-        min(position.y + desc.boundingBox.LFT.y, m_desc.boundingBox.LFT.y),
-        min(position.z + desc.boundingBox.LFT.z, m_desc.boundingBox.LFT.z));
-    m_desc.boundingBox.RBB = vector3f_t(
-        max(position.x + desc.boundingBox.RBB.x, m_desc.boundingBox.RBB.x),
-        max(position.y + desc.boundingBox.RBB.y, m_desc.boundingBox.RBB.y),
-        max(position.z + desc.boundingBox.RBB.z, m_desc.boundingBox.RBB.z));
+    extendBoundingBox(position, desc.boundingBox);
 
     // Y is UP direction
-    Element element = {&desc, desc.primitiveUID, direction, direction, 0};
+    Element element = {construction, direction, direction, 0, 0, 0};
     // if priitive can be morfed, morf it
-    if (ElementType::Wedge == element.construction->primitiveUID)
+    if (ElementType::Wedge == desc.primitiveUID)
     {
         morph(position, element);
     }
@@ -50,79 +56,312 @@ void Core::SetElement(const ConstructionDescription& desc, const vector3i_t& pos
     // notify neighbours about new element
     UpdateNeighbourhood(position, element);
 
-    m_pillars.item(position.x, position.z).insert(position.y, element);
+    m_elements.insert(position, element);
+    addMember(GetGroup(element));
+
+    for (const auto& cell : cells)
+    {
+        const Element ref = {reference, direction, direction, 0, 0, 0};
+        replaceMember(cell);
+        m_elements.insert(cell, ref);
+        markDirty(cell);
+    }
+    compactGroups();
+}
+
+template <class Storage>
+void BasicCore<Storage>::SetElements(const std::vector<Placement>& placements)
+{
+    // storages which don't depend on the order of insertion place elements one by one
+    if (!Storage::c_orderedInsert)
+    {
+        for (const auto& placement : placements)
+            SetElement(*placement.construction, placement.position, placement.direction, placement.copySettingsFrom);
+        return;
+    }
+
+    // constructions are resolved first, so the core is not changed if they don't fit to it
+    std::vector<vector3i_t> cells;
+    std::vector< std::pair<uint16_t, uint16_t> > constructions;
+    bool morphs = false;
+    for (const auto& placement : placements)
+    {
+        const ConstructionDescription& desc = *placement.construction;
+        const size_t first = cells.size();
+        cells.push_back(placement.position);
+        referenceCells(desc, placement.position, cells);
+        const uint16_t construction = constructionIndex(desc, desc.primitiveUID);
+        const uint16_t reference = (cells.size() == first + 1) ? c_referenceConstruction : constructionIndex(m_reference, desc.primitiveUID);
+        constructions.push_back(std::make_pair(construction, reference));
+        morphs = morphs || ElementType::Wedge == desc.primitiveUID;
+    }
+
+    // cells are reserved pillar by pillar from the bottom, so storages grow at the ends of ranges
+    std::sort(cells.begin(), cells.end(), [](const vector3i_t& a, const vector3i_t& b)
+    {
+        return a.x != b.x ? a.x < b.x : (a.z != b.z ? a.z < b.z : a.y < b.y);
+    });
+    bool overwrites = cells.end() != std::adjacent_find(cells.begin(), cells.end());
+    for (auto cell = cells.begin(); cell != cells.end() && !overwrites; ++cell)
+        overwrites = nullptr != FindElement(*cell);
+
+    // replaced elements and morphed neighbours change neighbourhoods in order of placements
+    if (overwrites || morphs)
+    {
+        for (const auto& placement : placements)
+            SetElement(*placement.construction, placement.position, placement.direction, placement.copySettingsFrom);
+        return;
+    }
+
+    const Element pending = {c_referenceConstruction, 0, 0, 0, 0, c_pendingGroup};
+    for (const auto& cell : cells)
+        m_elements.insert(cell, pending);
 
-    if (vector3i_t(1,1,1) != (desc.boundingBox.RBB - desc.boundingBox.LFT))
+    // reserved cells are replaced by elements, an element sees groups of previous ones
+    for (size_t i = 0; i < placements.size(); ++i)
     {
-        for (int x = desc.boundingBox.LFT.x; x < desc.boundingBox.RBB.x; ++x)
+        const Placement& placement = placements[i];
+        const ConstructionDescription& desc = *placement.construction;
+        const vector3i_t& position = placement.position;
+        markDirty(position);
+
+        extendBoundingBox(position, desc.boundingBox);
+
+        Element element = {constructions[i].first, placement.direction, placement.direction, 0, c_deferred, 0};
+        CopySettingsFrom(position, element, placement.copySettingsFrom);
+        *m_elements.get_item_at(position) = element;
+        addMember(GetGroup(element));
+
+        cells.clear();
+        referenceCells(desc, position, cells);
+        for (const auto& cell : cells)
         {
-            for (int z = desc.boundingBox.LFT.z; z < desc.boundingBox.RBB.z; ++z)
-            {
-                if (x || z)
-                {
-                    Element ref = {&m_reference, desc.primitiveUID, direction, direction, 0};
-                    m_pillars.item(position.x + x, position.z + z).insert(position.y, ref);
-                }
-            }
+            const Element ref = {constructions[i].second, placement.direction, placement.direction, 0, c_deferred, 0};
+            *m_elements.get_item_at(cell) = ref;
+            markDirty(cell);
         }
     }
+    if (!placements.empty())
+    {
+        m_desc.direction = placements.back().direction;
+        m_desc.primitiveUID = placements.back().construction->primitiveUID;
+    }
+
+    // neighbourhoods are updated in order of placements, so deferred elements are the next ones
+    for (const auto& placement : placements)
+    {
+        Element& element = *m_elements.get_item_at(placement.position);
+        element.reserved = 0;
+        UpdateNeighbourhood(placement.position, element);
+
+        cells.clear();
+        referenceCells(*placement.construction, placement.position, cells);
+        for (const auto& cell : cells)
+            m_elements.get_item_at(cell)->reserved = 0;
+    }
+    compactGroups();
 }
 
-bool Core::Weld(uint32_t group1, uint32_t group2)
+template <class Storage>
+bool BasicCore<Storage>::Weld(uint32_t group1, uint32_t group2)
 {
-    if (group1 == group2)
+    if (group1 == group2 || (group1 & c_pendingGroup) || group2 >= m_groupDescs.size() || !m_groupDescs[group2].elements)
         return false;
+    // new groups don't get the id of the welded one
+    m_lastGroupIndex = max(m_lastGroupIndex, group1);
+    addGroup(group1);
+    GroupDesc& desc1 = m_groupDescs[group1];
+    GroupDesc& desc2 = m_groupDescs[group2];
+
+    // the id was welded to another group before, the second group is relabelled only
+    const uint32_t root1 = m_groups.find(desc1.root);
+    if (m_ids[root1] != group1)
+    {
+        m_ids[desc2.root] = group1;
+        desc1 = std::move(desc2);
+        desc2 = GroupDesc();
+        return true;
+    }
 
-    bool res = false;
+    // contacts between the groups are in both lists, so the shorter list is checked only:
+    // its contacts with other groups are moved to the longer list, outdated ones are dropped
+    const bool firstLonger = desc1.contacts.size() >= desc2.contacts.size();
+    const uint32_t own   = firstLonger ? group2 : group1;
+    const uint32_t other = firstLonger ? group1 : group2;
+    std::vector<Contact>& longer = firstLonger ? desc1.contacts : desc2.contacts;
+    std::vector<Contact> shorter;
+    shorter.swap(firstLonger ? desc2.contacts : desc1.contacts);
+
+    std::vector<Contact> boundary;
+    for (const Contact& contact : shorter)
+    {
+        const Element* element = FindElement(contact.second);
+        if (!element || !isMember(contact.first, own))
+            continue;
+        const uint32_t group = GetGroup(*element);
+        if (group == other)
+            boundary.push_back(contact);
+        else if (group != own)
+            longer.push_back(contact);
+    }
 
-    m_pillars.for_each([&](size_t x, size_t z, Pillar_t& pillar)
+    const uint32_t root = m_groups.unite(root1, desc2.root);
+    m_ids[root] = group1;
+    desc1.root = root;
+    desc1.elements += desc2.elements;
+    desc1.limit = max(desc1.limit, desc2.limit);
+    if (&longer != &desc1.contacts)
+        desc1.contacts.swap(longer);
+    desc2 = GroupDesc();
+
+    // elements of the boundary see their new neighbours
+    for (const Contact& contact : boundary)
     {
-        pillar.for_each([&](size_t y, Element& e)
-        {
-            if (e.group == group2 || e.group == group1)
-            {
-                res = res || e.group == group2;
-                e.group = group1;
-                UpdateNeighbourhood(vector3i_t(x, y, z), e);
-            }
-        });
-    });
-    return res;
+        if (Element* first = GetElement(contact.first))
+            updateOwnNeighbourhood(contact.first, *first);
+        markDirty(contact.first);
+        if (Element* second = GetElement(contact.second))
+            updateOwnNeighbourhood(contact.second, *second);
+        markDirty(contact.second);
+    }
+
+    // contacts of the boundary kept by the longer list are inside of the group now
+    if (desc1.overgrown())
+        compactGroup(group1);
+    return true;
+}
+
+template <class Storage>
+Element* BasicCore<Storage>::GetElement(const vector3i_t& position)
+{
+    Element* element = m_elements.get_item_at(position);
+    if (!element || (element->group & c_pendingGroup))
+        return nullptr;
+
+    // the element gets the id of its group if the id belongs to the set (see Weld)
+    const uint32_t root = m_groups.find(element->group);
+    element->group = (m_groups.find(m_ids[root]) == root) ? m_ids[root] : root;
+    return element;
+}
+
+template <class Storage>
+const Element* BasicCore<Storage>::FindElement(const vector3i_t& position) const
+{
+    const Element* element = m_elements.find(position);
+    return (element && !(element->group & c_pendingGroup)) ? element : nullptr;
+}
+
+template <class Storage>
+typename BasicCore<Storage>::Snapshot BasicCore<Storage>::TakeSnapshot()
+{
+    std::vector<uint32_t> groups(m_groups.size());
+    for (uint32_t id = 0; id < groups.size(); ++id)
+        groups[id] = m_ids[m_groups.find(id)];
+    return Snapshot(m_elements.snapshot(), m_desc, m_constructions, std::move(groups));
+}
+
+template <class Storage>
+void BasicCore<Storage>::Save(std::ostream& out)
+{
+    TakeSnapshot().Save(out);
 }
 
-Element* Core::GetElement(const vector3i_t& position)
+template <class Storage>
+bool BasicCore<Storage>::Load(const void* data, size_t size)
 {
-    auto pillar = m_pillars.get_item_at(position.x, position.z);
-    return pillar ? pillar->get_item_at(position.y) : nullptr;
+    Reset();
+    Utils::PillarImage<StoredElement> image;
+    if (!image.attach(data, size))
+        return false;
+
+    bool valid = true;
+    try
+    {
+        m_elements.inflate(image, [&](const StoredElement& stored)
+        {
+            const ConstructionDescription* desc = (StoredElement::c_reference == stored.construction) ? 
+                &m_reference : m_library.GetConstructionDescription(stored.construction);
+            valid = valid && desc;
+            m_lastGroupIndex = max(m_lastGroupIndex, stored.group);
+            const Element element = {desc ? constructionIndex(*desc, stored.type) : c_referenceConstruction,
+                static_cast<uint16_t>(stored.direction), static_cast<uint16_t>(stored.originalDirection),
+                static_cast<uint8_t>(stored.neighbourhood), 0, stored.group};
+            return element;
+        });
+    }
+    catch (const std::length_error&)
+    {
+        // the image has more constructions than elements can refer
+        valid = false;
+    }
+    if (!valid)
+    {
+        Reset();
+        return false;
+    }
+
+    addGroup(m_lastGroupIndex);
+
+    // bounding box, element counts and contacts of groups are restored from elements
+    IterrateObject([&](int32_t x, int32_t y, int32_t z, Element& e)
+    {
+        const ConstructionDescription& desc = *GetConstruction(e);
+        if (&desc == &m_reference)
+            return;
+        const vector3i_t position(x, y, z);
+        extendBoundingBox(position, desc.boundingBox);
+        addMember(GetGroup(e));
+        for (const auto& neighbor : desc.neighbors)
+        {
+            const vector3i_t neighborPosition = position + rotate(neighbor.relationPosition, e.direction);
+            const Element* item = FindElement(neighborPosition);
+            if (item && GetGroup(*item) != GetGroup(e))
+                addContact(position, GetGroup(e), neighborPosition, GetGroup(*item));
+        }
+    });
+    compactGroups();
+    return true;
 }
 
-void Core::UpdateNeighbourhood(const vector3i_t& pos, Element& self)
+template <class Storage>
+void BasicCore<Storage>::UpdateNeighbourhood(const vector3i_t& pos, Element& self)
 {
-    for (auto neighbor : self.construction->neighbors)
+    markDirty(pos);
+    for (const auto& neighbor : GetConstruction(self)->neighbors)
     {
         vector3i_t relativeDirection = rotate(neighbor.relationPosition, self.direction);
 
-        Element* item = GetElement(relativeDirection + pos);
-        if (!item || item->group != self.group )
+        const Element* item = FindElement(relativeDirection + pos);
+        if (!item || c_deferred == item->reserved)
             continue;
+        if (GetGroup(*item) != GetGroup(self))
+        {
+            addContact(pos, GetGroup(self), relativeDirection + pos, GetGroup(*item));
+            continue;
+        }
 
         const NeighborDesc* itemNeighbour = findNeighbor(*item, relativeDirection);
         if (!itemNeighbour)
             continue;
 
+        // the neighbour is written only if its flag changes
         if (itemNeighbour->relationWeight <= neighbor.relationWeight)
         {
-            item->neighbourhood |= itemNeighbour->relationFlag;
+            const uint8_t flag = static_cast<uint8_t>(itemNeighbour->relationFlag);
+            if (flag != (item->neighbourhood & flag))
+                GetElement(relativeDirection + pos)->neighbourhood |= flag;
+            markDirty(relativeDirection + pos);
         }
 
         if (itemNeighbour->relationWeight >= neighbor.relationWeight)
         {
-            self.neighbourhood |= neighbor.relationFlag;
+            self.neighbourhood |= static_cast<uint8_t>(neighbor.relationFlag);
         }
     }
 }
 
-void Core::CopySettingsFrom(const vector3i_t& pos, Element& self, Directions copySettingsFrom)
+template <class Storage>
+void BasicCore<Storage>::CopySettingsFrom(const vector3i_t& pos, Element& self, Directions copySettingsFrom)
 {
     copySettingsFrom;
     pos;
@@ -134,7 +373,7 @@ void Core::CopySettingsFrom(const vector3i_t& pos, Element& self, Directions cop
     }
 
     vector3i_t neighbour = rotate(vector3i_t(0,0,1), copySettingsFrom);
-    Element* item = GetElement(neighbour + pos);
+    const Element* item = FindElement(neighbour + pos);
     if (item)
     {
         self.group = item->group;
@@ -142,41 +381,238 @@ void Core::CopySettingsFrom(const vector3i_t& pos, Element& self, Directions cop
     else
     {
         self.group = ++m_lastGroupIndex;
+        addGroup(self.group);
     }
 }
 
-void Core::IterrateObject(std::function<void(size_t, size_t, size_t, Element&)> visitor) 
+template <class Storage>
+CoreStats BasicCore<Storage>::GetStats()
 {
-    m_pillars.for_each([&](size_t x, size_t z, Pillar_t& pillar){
-        pillar.for_each([&](size_t y, Element& e){
-            visitor(x,y,z,e);
-        });
-    });
+    CoreStats stats;
+    m_elements.stats(stats.pillars, stats.elements);
+    stats.bytes = sizeof(*this) + stats.pillars.bytes + stats.elements.bytes;
+    stats.bytes += m_groupDescs.capacity() * sizeof(GroupDesc) + m_ids.capacity() * sizeof(uint32_t);
+    stats.bytes += m_groups.size() * (sizeof(uint32_t) + sizeof(uint8_t));
+    stats.contacts = 0;
+    for (const auto& desc : m_groupDescs)
+    {
+        stats.contacts += desc.contacts.size();
+        stats.bytes += desc.contacts.capacity() * sizeof(Contact);
+    }
+    return stats;
 }
 
-bool Core::IsUpdated() 
+template <class Storage>
+bool BasicCore<Storage>::IsUpdated() 
 {
     bool state = m_isDirty; 
     m_isDirty = false; 
     return state;
 }
 
-void Core::Reset()
+template <class Storage>
+bool BasicCore<Storage>::TakeDirtyRegions(std::vector<vector3i_t>& regions)
+{
+    const bool all = m_allDirty;
+    regions.assign(m_dirtyRegions.begin(), m_dirtyRegions.end());
+    m_dirtyRegions.clear();
+    m_allDirty = false;
+    return all;
+}
+
+template <class Storage>
+void BasicCore<Storage>::Reset()
 {
     m_isDirty = true;
+    m_allDirty = true;
+    m_dirtyRegions.clear();
     m_lastGroupIndex = 0;
-    m_pillars.clear();
-    m_desc.boundingBox = BBox(vector3i_t(INT32_MAX, INT32_MAX, INT32_MAX), vector3i_t(0,0,0));
+    m_elements.clear();
+    m_groups.clear();
+    m_ids.clear();
+    m_groupDescs.clear();
+    m_overgrownGroups.clear();
+    addGroup(0);
+    m_desc.boundingBox = BBox(vector3i_t(INT32_MAX, INT32_MAX, INT32_MAX), vector3i_t(INT32_MIN, INT32_MIN, INT32_MIN));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
 // private section
 ///////////////////////////////////////////////////////////////////////////////////
 
-const NeighborDesc* Core::findNeighbor(const Element& item, const vector3i_t& direction) const
+template <class Storage>
+void BasicCore<Storage>::updateOwnNeighbourhood(const vector3i_t& pos, Element& self)
+{
+    for (const auto& neighbor : GetConstruction(self)->neighbors)
+    {
+        vector3i_t relativeDirection = rotate(neighbor.relationPosition, self.direction);
+
+        const Element* item = FindElement(relativeDirection + pos);
+        if (!item || GetGroup(*item) != GetGroup(self))
+            continue;
+
+        const NeighborDesc* itemNeighbour = findNeighbor(*item, relativeDirection);
+        if (itemNeighbour && itemNeighbour->relationWeight >= neighbor.relationWeight)
+        {
+            self.neighbourhood |= static_cast<uint8_t>(neighbor.relationFlag);
+        }
+    }
+}
+
+template <class Storage>
+void BasicCore<Storage>::referenceCells(const ConstructionDescription& desc, const vector3i_t& position, std::vector<vector3i_t>& cells) const
+{
+    if (vector3i_t(1,1,1) == (desc.boundingBox.RBB - desc.boundingBox.LFT))
+        return;
+    for (int x = desc.boundingBox.LFT.x; x < desc.boundingBox.RBB.x; ++x)
+    {
+        for (int z = desc.boundingBox.LFT.z; z < desc.boundingBox.RBB.z; ++z)
+        {
+            if (x || z)
+                cells.push_back(vector3i_t(position.x + x, position.y, position.z + z));
+        }
+    }
+}
+
+template <class Storage>
+uint16_t BasicCore<Storage>::constructionIndex(const ConstructionDescription& desc, uint32_t type)
+{
+    const ConstructionKey_t key(&desc, type);
+    auto found = m_constructionIndices.find(key);
+    if (found != m_constructionIndices.end())
+        return found->second;
+
+    if (m_constructions.size() > UINT16_MAX)
+        throw std::length_error("too many constructions in the core");
+    const uint16_t index = static_cast<uint16_t>(m_constructions.size());
+    const ElementConstruction construction = {&desc, type};
+    m_constructions.push_back(construction);
+    m_constructionIndices[key] = index;
+    return index;
+}
+
+template <class Storage>
+void BasicCore<Storage>::extendBoundingBox(const vector3i_t& position, const BBox& box)
+{
+    BBox& bounds = m_desc.boundingBox;
+    for (int i = 0; i < 3; ++i)
+    {
+        const int64_t lft = int64_t(position[i]) + box.LFT[i];
+        const int64_t rbb = int64_t(position[i]) + box.RBB[i];
+        if (lft < bounds.LFT[i])
+            bounds.LFT[i] = static_cast<int32_t>(lft < INT32_MIN ? INT32_MIN : lft);
+        if (rbb > bounds.RBB[i])
+            bounds.RBB[i] = static_cast<int32_t>(rbb > INT32_MAX ? INT32_MAX : rbb);
+    }
+}
+
+template <class Storage>
+void BasicCore<Storage>::markDirty(const vector3i_t& position)
 {
+    m_isDirty = true;
+    if (!m_allDirty)
+        m_dirtyRegions.insert(vector3i_t(position.x >> c_regionBits, position.y >> c_regionBits, position.z >> c_regionBits));
+}
+
+template <class Storage>
+void BasicCore<Storage>::addGroup(uint32_t group)
+{
+    // every id starts as a set and a group of its own
+    for (uint32_t id = static_cast<uint32_t>(m_groupDescs.size()); id <= group; ++id)
+    {
+        m_ids.push_back(id);
+        m_groupDescs.push_back(GroupDesc());
+        m_groupDescs.back().root = id;
+    }
+    m_groups.resize(m_groupDescs.size());
+}
+
+template <class Storage>
+void BasicCore<Storage>::addContact(const vector3i_t& first, uint32_t firstGroup, const vector3i_t& second, uint32_t secondGroup)
+{
+    GroupDesc& desc1 = m_groupDescs[firstGroup];
+    desc1.contacts.push_back(Contact(first, second));
+    if (desc1.contacts.size() == desc1.limit + 1)
+        m_overgrownGroups.push_back(firstGroup);
+
+    GroupDesc& desc2 = m_groupDescs[secondGroup];
+    desc2.contacts.push_back(Contact(second, first));
+    if (desc2.contacts.size() == desc2.limit + 1)
+        m_overgrownGroups.push_back(secondGroup);
+}
+
+template <class Storage>
+void BasicCore<Storage>::addMember(uint32_t group)
+{
+    ++m_groupDescs[group].elements;
+}
+
+template <class Storage>
+void BasicCore<Storage>::replaceMember(const vector3i_t& position)
+{
+    const Element* element = FindElement(position);
+    if (!element || c_referenceConstruction == element->construction)
+        return;
+    --m_groupDescs[GetGroup(*element)].elements;
+}
+
+template <class Storage>
+bool BasicCore<Storage>::isMember(const vector3i_t& position, uint32_t group) const
+{
+    // cells of bigger elements refer the reference construction, they are not members
+    const Element* element = FindElement(position);
+    return element && c_referenceConstruction != element->construction && group == GetGroup(*element);
+}
+
+template <class Storage>
+void BasicCore<Storage>::compactGroups()
+{
+    for (const auto group : m_overgrownGroups)
+    {
+        if (m_groupDescs[group].overgrown())
+            compactGroup(group);
+    }
+    m_overgrownGroups.clear();
+}
+
+template <class Storage>
+void BasicCore<Storage>::compactGroup(uint32_t group)
+{
+    GroupDesc& desc = m_groupDescs[group];
+    const RegionLess less;
+
+    // contacts are valid while the member touches an element of another group
+    auto outdated = [&](const Contact& contact)
+    {
+        const Element* other = FindElement(contact.second);
+        return !other || group == GetGroup(*other) || !isMember(contact.first, group);
+    };
+    desc.contacts.erase(std::remove_if(desc.contacts.begin(), desc.contacts.end(), outdated), desc.contacts.end());
+    std::sort(desc.contacts.begin(), desc.contacts.end(), [&](const Contact& a, const Contact& b)
+    {
+        return less(a.first, b.first) || (!less(b.first, a.first) && less(a.second, b.second));
+    });
+    desc.contacts.erase(std::unique(desc.contacts.begin(), desc.contacts.end()), desc.contacts.end());
+
+    desc.limit = (2 * desc.contacts.size() > c_groupListLimit) ? 2 * desc.contacts.size() : c_groupListLimit;
+}
+
+template <class Storage>
+const NeighborDesc* BasicCore<Storage>::findNeighbor(const Element& item, const vector3i_t& direction) const
+{
+    // constructions of the library have direct tables, others are scanned
+    const ConstructionDescription& desc = *GetConstruction(item);
+    if (const NeighborTable* table = m_library.GetNeighborTable(desc))
+    {
+        const int facing = Orientation::directionIndex(-direction);
+        if (facing < 0)
+            return nullptr;
+        const uint8_t relation = table->relations[Orientation::index(item.direction)][facing];
+        return (NeighborTable::c_none == relation) ? nullptr : &desc.neighbors[relation];
+    }
+
     const vector3i_t negative(-direction);
-    for (const auto& relations : item.construction->neighbors)
+    for (const auto& relations : desc.neighbors)
     {
         if (rotate(relations.relationPosition, item.direction) == negative)
             return &relations;
@@ -184,22 +620,23 @@ const NeighborDesc* Core::findNeighbor(const Element& item, const vector3i_t& di
     return nullptr;
 }
 
-void Core::morph(const vector3i_t& position, Element& self)
+template <class Storage>
+void BasicCore<Storage>::morph(const vector3i_t& position, Element& self)
 {
     // fing neighbor on behind
-    vector3i_t neighborPosition = rotate(self.construction->neighbors[DirectionIndices::nZ_idx].relationPosition, self.direction);
-    Element* item = GetElement(neighborPosition + position);
+    vector3i_t neighborPosition = rotate(GetConstruction(self)->neighbors[DirectionIndices::nZ_idx].relationPosition, self.direction);
+    const Element* item = FindElement(neighborPosition + position);
     vector3i_t sD = rotate(vector3i_t(0, 0, 1), self.originalDirection);
 
     // morph self
-    if (item && (item->type == Wedge))
+    if (item && (GetType(*item) == Wedge))
     {
         //calculate absolute directions of current object and neighbour
         vector3i_t iD = rotate(vector3i_t(0, 0, 1), item->originalDirection);
         // morph objects if they are perpendicular
         if (iD.x * sD.x + iD.z * sD.z == 0 )
         {
-            self.construction = m_library.GetConstructionDescription(WedgeOutCorner);
+            self.construction = constructionIndex(*m_library.GetConstructionDescription(WedgeOutCorner), GetType(self));
             //mirror wedge angle if required
             if (iD.x * sD.z - iD.z * sD.x > 0)
             {
@@ -207,16 +644,16 @@ void Core::morph(const vector3i_t& position, Element& self)
             }
         }
     }
-    neighborPosition = rotate(self.construction->neighbors[DirectionIndices::pZ_idx].relationPosition, self.originalDirection);
-    item = GetElement(neighborPosition + position);
-    if (item && (item->type == Wedge))
+    neighborPosition = rotate(GetConstruction(self)->neighbors[DirectionIndices::pZ_idx].relationPosition, self.originalDirection);
+    item = FindElement(neighborPosition + position);
+    if (item && (GetType(*item) == Wedge))
     {
         //calculate absolute directions of current object and neighbour
         vector3i_t iD = rotate(vector3i_t(0, 0, 1), item->originalDirection);
         // morph objects if they are perpendicular
         if (iD.x * sD.x + iD.z * sD.z == 0 )
         {
-            self.construction = m_library.GetConstructionDescription(WedgeInCorner);
+            self.construction = constructionIndex(*m_library.GetConstructionDescription(WedgeInCorner), GetType(self));
             //mirror wedge angle if required
             if (iD.x * sD.z - iD.z * sD.x < 0)
             {
@@ -224,60 +661,55 @@ void Core::morph(const vector3i_t& position, Element& self)
             }
         }
     }
-    neighborPosition = rotate(self.construction->neighbors[DirectionIndices::nX_idx].relationPosition, self.originalDirection);
-    item = GetElement(neighborPosition + position);
+    neighborPosition = rotate(GetConstruction(self)->neighbors[DirectionIndices::nX_idx].relationPosition, self.originalDirection);
+    item = FindElement(neighborPosition + position);
 
-    // morph neighbor
-    if (item && item->type == Wedge)
+    // morph neighbor, it's written only if it's morphed
+    if (item && GetType(*item) == Wedge)
     {
         //calculate absolute directions of current object and neighbour
         vector3i_t iD = rotate(vector3i_t(0, 0, 1), item->originalDirection);
         // morph objects if they are perpendicular
         if (iD.x * sD.x + iD.z * sD.z == 0)
         {
-            item->direction |= Directions::LeftToRight;
-            item->construction = m_library.GetConstructionDescription( (iD.x * sD.z - iD.z * sD.x < 0) ? WedgeOutCorner : WedgeInCorner);
+            Element* morphed = GetElement(neighborPosition + position);
+            morphed->construction = constructionIndex(*m_library.GetConstructionDescription( (iD.x * sD.z - iD.z * sD.x < 0) ? WedgeOutCorner : WedgeInCorner), GetType(*morphed));
+            markDirty(neighborPosition + position);
+            morphed->direction |= Directions::LeftToRight;
         }
     }
 
-    neighborPosition = rotate(self.construction->neighbors[DirectionIndices::pX_idx].relationPosition, self.originalDirection);
-    item = GetElement(neighborPosition + position);
+    neighborPosition = rotate(GetConstruction(self)->neighbors[DirectionIndices::pX_idx].relationPosition, self.originalDirection);
+    item = FindElement(neighborPosition + position);
 
     // morph neighbor
-    if (item && item->type == Wedge)
+    if (item && GetType(*item) == Wedge)
     {
         //calculate absolute directions of current object and neighbour
         vector3i_t iD = rotate(vector3i_t(0, 0, 1), item->originalDirection);
         // morph objects if they are perpendicular
         if (iD.x * sD.x + iD.z * sD.z == 0)
         {
-            item->construction = m_library.GetConstructionDescription( (iD.x * sD.z - iD.z * sD.x > 0) ? WedgeOutCorner : WedgeInCorner);
+            markDirty(neighborPosition + position);
+            Element* morphed = GetElement(neighborPosition + position);
+            morphed->construction = constructionIndex(*m_library.GetConstructionDescription( (iD.x * sD.z - iD.z * sD.x > 0) ? WedgeOutCorner : WedgeInCorner), GetType(*morphed));
         }
     }
 }
 
 
-vector3i_t Core::rotate(const vector3i_t& vec, unsigned int dst) const
+template <class Storage>
+vector3i_t BasicCore<Storage>::rotate(const vector3i_t& vec, unsigned int dst) const
 {
-    vector3i_t out = vec;
-
-    switch(dst & MODIFICATOR_MASK)
-    {
-    case Directions::LeftToRight:
-        out.x = -out.x;
-        break;
-    }
-
-    switch(dst & DIRECTION_MASK)
-    {
-    case Directions::nX : return vector3i_t(-out.z, out.y,  out.x);
-    case Directions::pX : return vector3i_t( out.z, out.y, -out.x);
-    case Directions::nZ : return vector3i_t(-out.x, vec.y, -out.z);
-    case Directions::nY : return vector3i_t( out.x, -out.z, out.y); // GHM GUANO
-    case Directions::pY : return vector3i_t( out.x,  out.z, out.y); // GHM GUANO
-    }
-
-    return out;
+    return Orientation::rotate(vec, dst);
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// supported storages
+///////////////////////////////////////////////////////////////////////////////////
+template class BasicCore< PillarStorage<Utils::QuadTree> >;
+template class BasicCore< PillarStorage<Utils::LinearQuadTree> >;
+template class BasicCore< PillarStorage<Utils::WideQuadTree4x4> >;
+template class BasicCore< BrickStorage >;
+
 // eof
\ No newline at end of file
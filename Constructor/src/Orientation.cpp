@@ -0,0 +1,62 @@
+#include "Orientation.h"
+
+// tables are defined once for all translation units, see Orientation.h
+namespace ConstructorImpl
+{
+    namespace Orientation
+    {
+        const uint8_t c_directionSlots[256] =
+        {
+            0, 1, 4, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0,
+            5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        };
+
+        const int32_t c_rotations[c_transformsCount][3][3] =
+        {
+            {{ 1,  0,  0}, { 0,  1,  0}, { 0,  0,  1}}, // pZ
+            {{-1,  0,  0}, { 0,  1,  0}, { 0,  0,  1}}, // pZ mirrored
+            {{ 0,  0,  1}, { 0,  1,  0}, {-1,  0,  0}}, // pX
+            {{ 0,  0,  1}, { 0,  1,  0}, { 1,  0,  0}}, // pX mirrored
+            {{ 0,  0, -1}, { 0,  1,  0}, { 1,  0,  0}}, // nX
+            {{ 0,  0, -1}, { 0,  1,  0}, {-1,  0,  0}}, // nX mirrored
+            {{-1,  0,  0}, { 0,  1,  0}, { 0,  0, -1}}, // nZ
+            {{ 1,  0,  0}, { 0,  1,  0}, { 0,  0, -1}}, // nZ mirrored
+            {{ 1,  0,  0}, { 0,  0,  1}, { 0,  1,  0}}, // pY
+            {{-1,  0,  0}, { 0,  0,  1}, { 0,  1,  0}}, // pY mirrored
+            {{ 1,  0,  0}, { 0,  0, -1}, { 0,  1,  0}}, // nY
+            {{-1,  0,  0}, { 0,  0, -1}, { 0,  1,  0}}, // nY mirrored
+        };
+
+        const float c_transforms[c_transformsCount][3][4] =
+        {
+            {{ 1,  0,  0,  0}, { 0,  1,  0,  0}, { 0,  0,  1,  0}}, // pZ
+            {{-1,  0,  0,  1}, { 0,  1,  0,  0}, { 0,  0,  1,  0}}, // pZ mirrored
+            {{ 0,  0,  1,  0}, { 0,  1,  0,  0}, {-1,  0,  0,  1}}, // pX
+            {{ 0,  0,  1,  0}, { 0,  1,  0,  0}, { 1,  0,  0,  0}}, // pX mirrored
+            {{ 0,  0, -1,  1}, { 0,  1,  0,  0}, { 1,  0,  0,  0}}, // nX
+            {{ 0,  0, -1,  1}, { 0,  1,  0,  0}, {-1,  0,  0,  1}}, // nX mirrored
+            {{-1,  0,  0,  1}, { 0,  1,  0,  0}, { 0,  0, -1,  1}}, // nZ
+            {{ 1,  0,  0,  0}, { 0,  1,  0,  0}, { 0,  0, -1,  1}}, // nZ mirrored
+            {{ 1,  0,  0,  0}, { 0,  1,  0,  0}, { 0,  0,  1,  0}}, // pY
+            {{-1,  0,  0,  1}, { 0,  1,  0,  0}, { 0,  0,  1,  0}}, // pY mirrored
+            {{ 1,  0,  0,  0}, { 0,  1,  0,  0}, { 0,  0,  1,  0}}, // nY
+            {{-1,  0,  0,  1}, { 0,  1,  0,  0}, { 0,  0,  1,  0}}, // nY mirrored
+        };
+    }
+}
+
+// eof
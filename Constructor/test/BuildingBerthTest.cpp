@@ -251,7 +251,7 @@ TEST_F(BuildingBerthTest, Generated_NoWedgeMorfing)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::nZ);
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,1), Directions::pZ);
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::Wedge, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::Wedge, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_OuterWedgeAngle)
@@ -259,7 +259,7 @@ TEST_F(BuildingBerthTest, Generated_OuterWedgeAngle)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::nX);
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,1), Directions::pZ);
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_PiramidTop_1)
@@ -270,13 +270,13 @@ TEST_F(BuildingBerthTest, Generated_PiramidTop_1)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::nZ);
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_PiramidTop_2)
@@ -287,13 +287,13 @@ TEST_F(BuildingBerthTest, Generated_PiramidTop_2)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(1,0,0), Directions::pX);
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_PiramidTop_3)
@@ -304,13 +304,13 @@ TEST_F(BuildingBerthTest, Generated_PiramidTop_3)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::nZ);
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_PiramidTop_4)
@@ -329,13 +329,13 @@ TEST_F(BuildingBerthTest, Generated_PiramidTop_4)
     }
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_PiramidTop_5)
@@ -354,13 +354,13 @@ TEST_F(BuildingBerthTest, Generated_PiramidTop_5)
     }
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_InnerWedgeAngle)
@@ -368,7 +368,7 @@ TEST_F(BuildingBerthTest, Generated_InnerWedgeAngle)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::nX);
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,1), Directions::nZ);
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_ConeHall_1)
@@ -379,13 +379,13 @@ TEST_F(BuildingBerthTest, Generated_ConeHall_1)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::pZ);
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_ConeHall_2)
@@ -396,13 +396,13 @@ TEST_F(BuildingBerthTest, Generated_ConeHall_2)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(1,0,0), Directions::nX);
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_ConeHall_3)
@@ -413,13 +413,13 @@ TEST_F(BuildingBerthTest, Generated_ConeHall_3)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::pZ);
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(1,0,1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_ConeHall_4)
@@ -438,13 +438,13 @@ TEST_F(BuildingBerthTest, Generated_ConeHall_4)
     }
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_ConeHall_5)
@@ -463,13 +463,13 @@ TEST_F(BuildingBerthTest, Generated_ConeHall_5)
     }
 
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(size - 1,0,size - 1));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, Generated_WedgeSpikes)
@@ -478,16 +478,16 @@ TEST_F(BuildingBerthTest, Generated_WedgeSpikes)
     m_builder->SetElement(ElementType::Wedge, vector3i_t(3,0,4), Directions::pZ);
     m_builder->SetElement(ElementType::Wedge, vector3i_t(4,0,4), Directions::nX);
     Element *el = m_builder->GetCore().GetElement(vector3i_t(3,0,4));
-    ASSERT_EQ(ElementType::WedgeOutCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeOutCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
     el = m_builder->GetCore().GetElement(vector3i_t(4,0,4));
-    ASSERT_EQ(ElementType::WedgeInCorner, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::WedgeInCorner, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, CilindricPillar)
 {
     m_builder->SetElement(ElementType::Cilinder, vector3i_t(0,0,0), Directions::nX);
     Element *el = m_builder->GetCore().GetElement(vector3i_t(0,0,0));
-    ASSERT_EQ(ElementType::Cilinder, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::Cilinder, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
 }
 
 TEST_F(BuildingBerthTest, ElementGroups)
@@ -589,7 +589,28 @@ TEST_F(BuildingBerthTest, WeldingGroups)
 
     EXPECT_NE(el1->group, el2->group);
     EXPECT_TRUE(m_builder->Weld(el1->group, el2->group));
-    EXPECT_EQ(el1->group, el2->group);
+    EXPECT_EQ(m_builder->GetGroup(vector3i_t(0,0,0)), m_builder->GetGroup(vector3i_t(0,10,0)));
+    EXPECT_FALSE(m_builder->Weld(el1->group, el2->group)) << "the welded group has no elements";
+}
+
+TEST_F(BuildingBerthTest, WeldingToEmptyGroup)
+{
+    m_builder->SetElement(ElementType::Cube, vector3i_t(0,0,0), Directions::pZ);
+    m_builder->SetElement(ElementType::Cube, vector3i_t(0,10,0), Directions::pZ, Directions::pZ);
+    const uint32_t group1 = m_builder->GetGroup(vector3i_t(0,0,0));
+    const uint32_t group2 = m_builder->GetGroup(vector3i_t(0,10,0));
+
+    // the second group is relabelled even if the first one has no elements
+    EXPECT_TRUE(m_builder->Weld(100, group2));
+    EXPECT_EQ(100, m_builder->GetGroup(vector3i_t(0,10,0)));
+    EXPECT_EQ(group1, m_builder->GetGroup(vector3i_t(0,0,0)));
+
+    // the id of the welded group is free, it's reused as a label
+    EXPECT_TRUE(m_builder->Weld(group1, 100));
+    EXPECT_TRUE(m_builder->Weld(100, group1));
+    EXPECT_EQ(100, m_builder->GetGroup(vector3i_t(0,0,0)));
+    EXPECT_EQ(100, m_builder->GetGroup(vector3i_t(0,10,0)));
+    EXPECT_EQ(100, m_builder->GetCore().GetElement(vector3i_t(0,10,0))->group);
 }
 
 TEST_F(BuildingBerthTest, WeldingNeighbours)
@@ -742,6 +763,94 @@ TEST_F(BuildingBerthTest, AddCubeShapedObject)
 
     Element* el = m_builder->GetCore().GetElement(vector3i_t(0, 0, 0));
     ASSERT_TRUE(nullptr != el);
-    ASSERT_EQ(ElementType::Cube, el->construction->primitiveUID);
+    ASSERT_EQ(ElementType::Cube, m_builder->GetCore().GetConstruction(*el)->primitiveUID);
+}
+
+TEST_F(BuildingBerthTest, PlaceObjectsAsBatch)
+{
+    ObjectProperties properties = {"Cube", "", "", "Cube"};
+    IConstructorObjectPtr ptr( new ConstructorObjectBase(properties));
+    m_builder->GetLibrary().RegisterObject("Cube", ptr);
+    std::vector<PlacementParameters> objects;
+    for (int y = 2; y >= 0; --y)
+    {
+        Vector pos = { 0.0f, float(y), 0.0f };
+        PlacementParameters params = { "Cube", pos, Directions::pZ, Directions::nY };
+        objects.push_back(params);
+    }
+    Vector pos = { 1.0f, 0.0f, 0.0f };
+    PlacementParameters nothing = { "Nothing", pos, Directions::pZ, Directions::nY };
+    objects.push_back(nothing);
+    ASSERT_EQ(Status::ResourceNotFound, m_builder->PlaceObjects(objects));
+    ASSERT_TRUE(nullptr == m_builder->GetCore().GetElement(vector3i_t(0,0,0))) << "nothing is placed";
+
+    objects.pop_back();
+    ASSERT_EQ(Status::OK, m_builder->PlaceObjects(objects));
+    // cubes are placed from the top, so elements above the ground don't find groups below them
+    EXPECT_EQ(0, m_builder->GetGroup(vector3i_t(0,0,0)));
+    EXPECT_NE(0, m_builder->GetGroup(vector3i_t(0,1,0)));
+    EXPECT_NE(m_builder->GetGroup(vector3i_t(0,1,0)), m_builder->GetGroup(vector3i_t(0,2,0)));
+    EXPECT_EQ(0, m_builder->GetCore().GetElement(vector3i_t(0,1,0))->neighbourhood);
+}
+
+TEST_F(BuildingBerthTest, ElementNeighborhoodInNegativeCoordinates)
+{
+    m_builder->SetElement(ElementType::Cube, vector3i_t(-1,0,-1), Directions::pZ);
+    m_builder->SetElement(ElementType::Cube, vector3i_t(-1,1,-1), Directions::pZ);
+    m_builder->SetElement(ElementType::Cube, vector3i_t(-2,0,-1), Directions::pZ);
+    m_builder->SetElement(ElementType::Cube, vector3i_t(-1,-1,-1), Directions::pZ);
+
+    const ConstructionDescription desc = m_builder->GetCore().ConstructionDesc();
+    EXPECT_EQ(vector3i_t(-2,-1,-1), desc.boundingBox.LFT);
+    EXPECT_EQ(vector3i_t(0,2,0), desc.boundingBox.RBB);
+
+    Element *el = m_builder->GetCore().GetElement(vector3i_t(-1,0,-1));
+    ASSERT_TRUE(nullptr != el);
+    ASSERT_EQ(Directions::pY | Directions::nX, el->neighbourhood) << "element below the ground is a separate group";
+}
+
+TEST_F(BuildingBerthTest, PlaceObjectFarFromOrigin)
+{
+    ObjectProperties properties = {"Cube", "", "", "Cube"};
+    IConstructorObjectPtr ptr( new ConstructorObjectBase(properties));
+    m_builder->GetLibrary().RegisterObject("Cube", ptr);
+    Vector pos = { -100000.5f, 3.0f, 70000.0f };
+    PlacementParameters params = { "Cube", pos, Directions::pZ, Directions::nY };
+    ASSERT_EQ(Status::OK, m_builder->PlaceObject(params));
+
+    size_t count = 0;
+    m_builder->GetCore().IterrateObject([&](int32_t x, int32_t y, int32_t z, Element& item)
+    {
+        ++count;
+        EXPECT_EQ(vector3i_t(-100001, 3, 70000), vector3i_t(x, y, z));
+        EXPECT_EQ(ElementType::Cube, m_builder->GetCore().GetConstruction(item)->primitiveUID);
+    });
+    ASSERT_EQ(1, count);
+}
+
+TEST_F(BuildingBerthTest, PlaceObjectAtInt32Limits)
+{
+    ObjectProperties properties = {"Cube", "", "", "Cube"};
+    IConstructorObjectPtr ptr( new ConstructorObjectBase(properties));
+    m_builder->GetLibrary().RegisterObject("Cube", ptr);
+    // 2^31 is the nearest float to INT32_MAX, it's clamped to the last cell
+    Vector pos = { 2147483648.0f, 3.0f, -2147483648.0f };
+    PlacementParameters params = { "Cube", pos, Directions::pZ, Directions::nY };
+    ASSERT_EQ(Status::OK, m_builder->PlaceObject(params));
+    ASSERT_TRUE(m_builder->SetElement(ElementType::Cube, vector3i_t(INT32_MAX, 0, INT32_MAX), Directions::pZ, Directions::nY));
+
+    ASSERT_TRUE(nullptr != m_builder->GetCore().GetElement(vector3i_t(INT32_MAX, 3, INT32_MIN)));
+    ASSERT_TRUE(nullptr != m_builder->GetCore().GetElement(vector3i_t(INT32_MAX, 0, INT32_MAX)));
+    size_t count = 0;
+    m_builder->GetCore().IterrateObject([&](int32_t x, int32_t, int32_t, Element&)
+    {
+        ++count;
+        EXPECT_EQ(INT32_MAX, x);
+    });
+    ASSERT_EQ(2, count);
+
+    const BBox box = m_builder->GetBoundingBox();
+    EXPECT_EQ(vector3i_t(INT32_MAX, 0, INT32_MIN), box.LFT);
+    EXPECT_EQ(vector3i_t(INT32_MAX, 4, INT32_MAX), box.RBB) << "right bounds are saturated";
 }
-// eof
\ No newline at end of file
+// eof
@@ -0,0 +1,871 @@
+#include "BuildingBerth.h"
+#include "HullConstructor.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <set>
+#include <random>
+#include <stdexcept>
+
+using namespace ConstructorImpl;
+
+// checks that all Core storages produce the same constructions
+// the reference is the Core of building berth
+class CoreStorageTest : public ::testing::Test
+{
+public:
+
+    void SetUp()
+    {
+        m_builder.reset(new BuildingBerth);
+        m_linearCore.reset(new LinearCore(GetConstructionLibrary()));
+        m_wideCore.reset(new WideCore(GetConstructionLibrary()));
+        m_brickCore.reset(new BrickCore(GetConstructionLibrary()));
+    }
+    void TearDown()
+    {
+        m_brickCore.reset();
+        m_wideCore.reset();
+        m_linearCore.reset();
+        m_builder.reset();
+    }
+
+protected:
+    ConstructionLibrary& GetConstructionLibrary()
+    {
+        return static_cast<Library&>(m_builder->GetLibrary()).GetConstructionLibrary();
+    }
+
+    void SetElement(ElementType type, const vector3i_t& position, Directions direction, Directions copySettingsFrom = Directions::nY)
+    {
+        const ConstructionDescription& desc = *GetConstructionLibrary().GetConstructionDescription(type);
+        m_builder->GetCore().SetElement(desc, position, direction, copySettingsFrom);
+        m_linearCore->SetElement(desc, position, direction, copySettingsFrom);
+        m_wideCore->SetElement(desc, position, direction, copySettingsFrom);
+        m_brickCore->SetElement(desc, position, direction, copySettingsFrom);
+    }
+
+    template <class CoreType>
+    void CompareWithReference(CoreType& core)
+    {
+        size_t count = 0;
+        m_builder->GetCore().IterrateObject([&](int32_t x, int32_t y, int32_t z, Element& expected)
+        {
+            ++count;
+            Element* actual = core.GetElement(vector3i_t(x, y, z));
+            ASSERT_TRUE(nullptr != actual) << "missing element [" << x << "," << y << "," << z << "]";
+            EXPECT_EQ(m_builder->GetCore().GetConstruction(expected)->primitiveUID, core.GetConstruction(*actual)->primitiveUID);
+            EXPECT_EQ(m_builder->GetCore().GetType(expected), core.GetType(*actual));
+            EXPECT_EQ(expected.direction,          actual->direction);
+            EXPECT_EQ(expected.originalDirection,  actual->originalDirection);
+            EXPECT_EQ(expected.neighbourhood,      actual->neighbourhood);
+            EXPECT_EQ(m_builder->GetCore().GetGroup(expected), core.GetGroup(*actual));
+        });
+
+        size_t actualCount = 0;
+        core.IterrateObject([&](int32_t, int32_t, int32_t, Element&) { ++actualCount; });
+        EXPECT_EQ(count, actualCount);
+    }
+
+    std::unique_ptr<BuildingBerth>  m_builder;
+    std::unique_ptr<LinearCore>     m_linearCore;
+    std::unique_ptr<WideCore>       m_wideCore;
+    std::unique_ptr<BrickCore>      m_brickCore;
+};
+
+TEST_F(CoreStorageTest, IterrateRegion)
+{
+    for (int x = -4; x < 4; ++x)
+        for (int z = -4; z < 4; ++z)
+            for (int y = 0; y < 4; ++y)
+                SetElement(ElementType::Cube, vector3i_t(x,y,z), Directions::pZ);
+
+    const BBox box(vector3i_t(-2,1,-1), vector3i_t(1,3,5));
+    std::vector<vector3i_t> expected;
+    m_builder->GetCore().IterrateObject([&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        if (box.LFT.x <= x && x < box.RBB.x && box.LFT.y <= y && y < box.RBB.y && box.LFT.z <= z && z < box.RBB.z)
+            expected.push_back(vector3i_t(x, y, z));
+    });
+    ASSERT_EQ(3 * 2 * 5, expected.size()) << "box is clipped by the construction";
+
+    std::vector<vector3i_t> actual;
+    m_builder->GetCore().IterrateRegion(box, [&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        actual.push_back(vector3i_t(x, y, z));
+    });
+    EXPECT_EQ(expected, actual);
+
+    actual.clear();
+    m_linearCore->IterrateRegion(box, [&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        actual.push_back(vector3i_t(x, y, z));
+    });
+    EXPECT_EQ(expected, actual);
+
+    actual.clear();
+    m_wideCore->IterrateRegion(box, [&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        actual.push_back(vector3i_t(x, y, z));
+    });
+    EXPECT_EQ(expected, actual);
+
+    // bricks are visited in their own order
+    std::vector<vector3i_t> bricksOrder;
+    m_brickCore->IterrateObject([&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        if (std::find(expected.begin(), expected.end(), vector3i_t(x, y, z)) != expected.end())
+            bricksOrder.push_back(vector3i_t(x, y, z));
+    });
+    ASSERT_EQ(expected.size(), bricksOrder.size());
+    actual.clear();
+    m_brickCore->IterrateRegion(box, [&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        actual.push_back(vector3i_t(x, y, z));
+    });
+    EXPECT_EQ(bricksOrder, actual);
+}
+
+// geometry of elements built serially region by region, see Hull::UpdateMesh
+template <class CoreType>
+IMesh::Shape SerialMesh(CoreType& core, MeshLibrary& meshLibrary)
+{
+    const int32_t bits = CoreType::c_regionBits;
+    const int32_t side = 1 << bits;
+    std::set<vector3i_t, RegionLess> regions;
+    core.IterrateObject([&](int32_t x, int32_t y, int32_t z, Element&)
+    {
+        regions.insert(vector3i_t(x >> bits, y >> bits, z >> bits));
+    });
+
+    IMesh::Shape result;
+    for (const auto& region : regions)
+    {
+        const vector3i_t lft = region * side;
+        core.IterrateRegion(BBox(lft, lft + vector3i_t(side, side, side)), [&](int32_t x, int32_t y, int32_t z, Element& e)
+        {
+            MeshProperties prop = {~static_cast<uint32_t>(e.neighbourhood), vector3f_t(x,y,z), e.direction};
+            meshLibrary.GetMeshObject(core.GetConstruction(e)->primitiveUID).ConstructGeometry(prop, result);
+        });
+    }
+    return result;
+}
+
+template <class CoreType>
+void CheckHull(CoreType& core, MeshLibrary& meshLibrary)
+{
+    const IMesh::Shape expected = SerialMesh(core, meshLibrary);
+    ASSERT_FALSE(expected.Positions.Data.empty());
+    Hull hull(meshLibrary);
+    hull.ConstructMesh(core);
+    EXPECT_EQ(expected.Positions.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data);
+    EXPECT_EQ(expected.Normals.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data);
+}
+
+TEST_F(CoreStorageTest, HullMatchesSerialConstruction)
+{
+    const int cubeScales = 16;
+    for (int x = -cubeScales; x < cubeScales; ++x)
+        for (int z = -cubeScales; z < cubeScales; ++z)
+            for (int y = 0; y < 4; ++y)
+            {
+                if ((x + y + z) % 3)
+                    SetElement(ElementType::Cube, vector3i_t(x,y,z), Directions::pZ);
+            }
+
+    MeshLibrary& meshLibrary = static_cast<Library&>(m_builder->GetLibrary()).GetMeshLibrary();
+    CheckHull(m_builder->GetCore(), meshLibrary);
+    CheckHull(*m_linearCore, meshLibrary);
+    CheckHull(*m_wideCore, meshLibrary);
+    CheckHull(*m_brickCore, meshLibrary);
+}
+
+// edits regenerate geometry of their regions only, the result is the same as the mesh built from scratch
+template <class CoreType>
+void CheckIncrementalHull(CoreType& core, ConstructionLibrary& library, MeshLibrary& meshLibrary)
+{
+    const ConstructionDescription& cube = *library.GetConstructionDescription(ElementType::Cube);
+    const ConstructionDescription& wedge = *library.GetConstructionDescription(ElementType::Wedge);
+    for (int x = -20; x < 20; ++x)
+        for (int z = -20; z < 20; ++z)
+            core.SetElement(cube, vector3i_t(x,0,z), Directions::pZ, Directions::nY);
+
+    Hull hull(meshLibrary);
+    hull.UpdateMesh(core);
+    const size_t initialSize = hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data.size();
+    ASSERT_LT(0, initialSize);
+
+    // edits in different regions, a separate group on the top and a wedge corner
+    core.SetElement(cube, vector3i_t(15,1,-1), Directions::pZ, Directions::nY);
+    core.SetElement(cube, vector3i_t(-17,1,3), Directions::pZ, Directions::pZ);
+    const uint32_t group = core.GetElement(vector3i_t(-17,1,3))->group;
+    core.SetElement(cube, vector3i_t(-16,1,3), Directions::pZ, Directions::nX);
+    core.SetElement(wedge, vector3i_t(0,1,-1), Directions::pZ, Directions::nY);
+    core.SetElement(wedge, vector3i_t(1,1,-1), Directions::pX, Directions::nY);
+    hull.UpdateMesh(core);
+
+    Hull reference(meshLibrary);
+    reference.ConstructMesh(core);
+    EXPECT_EQ(reference.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data);
+    EXPECT_EQ(reference.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data);
+
+    // welded group loses faces inside of the construction
+    const size_t beforeWeld = hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data.size();
+    ASSERT_TRUE(core.Weld(0, group));
+    hull.UpdateMesh(core);
+    EXPECT_GT(beforeWeld, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data.size());
+    reference.ConstructMesh(core);
+    EXPECT_EQ(reference.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data);
+    EXPECT_EQ(reference.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data);
+
+    // new regions between and before existing ones shift the following geometry
+    core.SetElement(cube, vector3i_t(-5,40,-5), Directions::pZ, Directions::pZ);
+    core.SetElement(cube, vector3i_t(20,40,20), Directions::pZ, Directions::pZ);
+    core.SetElement(cube, vector3i_t(-30,1,0), Directions::pZ, Directions::pZ);
+    core.SetElement(cube, vector3i_t(-10,1,-10), Directions::pZ, Directions::nY);
+    hull.UpdateMesh(core);
+    reference.ConstructMesh(core);
+    EXPECT_EQ(reference.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data);
+    EXPECT_EQ(reference.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data, hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Normals.Data);
+
+    // a single cube changes its region and regions of its neighbours only
+    core.SetElement(cube, vector3i_t(5,1,5), Directions::pZ, Directions::nY);
+    core.SetElement(cube, vector3i_t(16,1,-1), Directions::pZ, Directions::nY);
+    std::vector<vector3i_t> regions;
+    ASSERT_FALSE(core.TakeDirtyRegions(regions));
+    ASSERT_EQ(3, regions.size());
+    EXPECT_EQ(vector3i_t(0,0,-1), regions[0]);
+    EXPECT_EQ(vector3i_t(0,0,0), regions[1]);
+    EXPECT_EQ(vector3i_t(1,0,-1), regions[2]);
+
+    core.Reset();
+    hull.UpdateMesh(core);
+    EXPECT_TRUE(hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data.empty());
+}
+
+TEST_F(CoreStorageTest, IncrementalHull)
+{
+    MeshLibrary& meshLibrary = static_cast<Library&>(m_builder->GetLibrary()).GetMeshLibrary();
+    CheckIncrementalHull(m_builder->GetCore(), GetConstructionLibrary(), meshLibrary);
+    CheckIncrementalHull(*m_linearCore, GetConstructionLibrary(), meshLibrary);
+    CheckIncrementalHull(*m_wideCore, GetConstructionLibrary(), meshLibrary);
+    CheckIncrementalHull(*m_brickCore, GetConstructionLibrary(), meshLibrary);
+}
+
+TEST_F(CoreStorageTest, SpongeSystem)
+{
+    const size_t cubeScales = 8;
+    for (size_t x = 0; x < cubeScales; ++x)
+        for (size_t y = 0; y < cubeScales; ++y)
+            for (size_t z = 0; z < cubeScales; ++z)
+            {
+                if ((x+y+z) % 2)
+                    SetElement(ElementType::Cube, vector3i_t(x,y,z), Directions::pZ);
+            }
+
+    CompareWithReference(*m_linearCore);
+    CompareWithReference(*m_wideCore);
+    CompareWithReference(*m_brickCore);
+}
+
+TEST_F(CoreStorageTest, WeldedCubeWithPillar)
+{
+    const size_t cubeScales = 9;
+    for (size_t x = 0; x < cubeScales; ++x)
+        for (size_t y = 0; y < cubeScales; ++y)
+            for (size_t z = 0; z < cubeScales; ++z)
+            {
+                if (x != cubeScales/2 || z != cubeScales/2)
+                    SetElement(ElementType::Cube, vector3i_t(x,y,z), Directions::pZ);
+            }
+
+    for (size_t y = 1; y < cubeScales - 1; ++y)
+    {
+        SetElement(ElementType::Cube, vector3i_t(cubeScales/2, y, cubeScales/2), Directions::pZ);
+    }
+    CompareWithReference(*m_linearCore);
+    CompareWithReference(*m_wideCore);
+    CompareWithReference(*m_brickCore);
+
+    EXPECT_TRUE(m_builder->GetCore().Weld(0, 1));
+    EXPECT_TRUE(m_linearCore->Weld(0, 1));
+    EXPECT_TRUE(m_wideCore->Weld(0, 1));
+    EXPECT_TRUE(m_brickCore->Weld(0, 1));
+    CompareWithReference(*m_linearCore);
+    CompareWithReference(*m_wideCore);
+    CompareWithReference(*m_brickCore);
+}
+
+TEST_F(CoreStorageTest, WedgesAndPlatforms)
+{
+    SetElement(ElementType::Wedge, vector3i_t(0,0,1), Directions::nX);
+    SetElement(ElementType::Wedge, vector3i_t(1,0,0), Directions::pX);
+    SetElement(ElementType::Wedge, vector3i_t(1,0,1), Directions::pZ);
+    SetElement(ElementType::Wedge, vector3i_t(0,0,0), Directions::nZ);
+    SetElement(ElementType::CilindricPlatform, vector3i_t(5,0,5), Directions::pZ);
+    SetElement(ElementType::Cube, vector3i_t(5,1,5), Directions::pZ, Directions::nY);
+
+    CompareWithReference(*m_linearCore);
+    CompareWithReference(*m_wideCore);
+    CompareWithReference(*m_brickCore);
+}
+
+TEST_F(CoreStorageTest, SnapshotKeepsConstruction)
+{
+    for (int x = -4; x < 4; ++x)
+        for (int z = -4; z < 4; ++z)
+            SetElement(ElementType::Cube, vector3i_t(x,0,z), Directions::pZ);
+    SetElement(ElementType::Cube, vector3i_t(0,2,0), Directions::pZ);
+
+    std::vector<Element> expected;
+    std::vector<vector3i_t> positions;
+    m_builder->GetCore().IterrateObject([&](int32_t x, int32_t y, int32_t z, Element& e)
+    {
+        expected.push_back(e);
+        positions.push_back(vector3i_t(x, y, z));
+    });
+
+    Core::Snapshot snapshot = m_builder->GetCore().TakeSnapshot();
+    LinearCore::Snapshot linearSnapshot = m_linearCore->TakeSnapshot();
+    WideCore::Snapshot wideSnapshot = m_wideCore->TakeSnapshot();
+    BrickCore::Snapshot brickSnapshot = m_brickCore->TakeSnapshot();
+
+    // new elements, then the welded one updates neighbourhood of existing elements
+    for (int x = -8; x < 8; ++x)
+        SetElement(ElementType::Cube, vector3i_t(x,1,8), Directions::pZ);
+    SetElement(ElementType::Cube, vector3i_t(0,1,0), Directions::pZ, Directions::pY);
+    const uint32_t group = m_builder->GetCore().GetElement(vector3i_t(0,1,0))->group;
+    EXPECT_TRUE(m_builder->GetCore().Weld(0, group));
+    EXPECT_TRUE(m_linearCore->Weld(0, group));
+    EXPECT_TRUE(m_wideCore->Weld(0, group));
+    EXPECT_TRUE(m_brickCore->Weld(0, group));
+
+    auto check = [&](int32_t x, int32_t y, int32_t z, const Element& actual, size_t& index)
+    {
+        ASSERT_LT(index, expected.size());
+        EXPECT_EQ(positions[index], vector3i_t(x, y, z));
+        EXPECT_EQ(expected[index].neighbourhood, actual.neighbourhood);
+        EXPECT_EQ(expected[index].group, actual.group);
+        ++index;
+    };
+    size_t index = 0;
+    snapshot.IterrateObject([&](int32_t x, int32_t y, int32_t z, const Element& e) {check(x, y, z, e, index);});
+    EXPECT_EQ(expected.size(), index);
+    index = 0;
+    linearSnapshot.IterrateObject([&](int32_t x, int32_t y, int32_t z, const Element& e) {check(x, y, z, e, index);});
+    EXPECT_EQ(expected.size(), index);
+    index = 0;
+    wideSnapshot.IterrateObject([&](int32_t x, int32_t y, int32_t z, const Element& e) {check(x, y, z, e, index);});
+    EXPECT_EQ(expected.size(), index);
+
+    EXPECT_TRUE(nullptr == snapshot.GetElement(vector3i_t(0,1,0)));
+    EXPECT_TRUE(nullptr == linearSnapshot.GetElement(vector3i_t(0,1,0)));
+    EXPECT_TRUE(nullptr == wideSnapshot.GetElement(vector3i_t(0,1,0)));
+    EXPECT_TRUE(nullptr == brickSnapshot.GetElement(vector3i_t(0,1,0)));
+    EXPECT_TRUE(nullptr != m_builder->GetCore().GetElement(vector3i_t(0,1,0)));
+    EXPECT_NE(snapshot.GetElement(vector3i_t(0,0,0))->neighbourhood,
+              m_builder->GetCore().GetElement(vector3i_t(0,0,0))->neighbourhood) << "welding doesn't change the snapshot";
+    CompareWithReference(*m_linearCore);
+    CompareWithReference(*m_wideCore);
+    CompareWithReference(*m_brickCore);
+
+    // bricks are visited in their own order, elements are the same
+    size_t count = 0;
+    brickSnapshot.IterrateObject([&](int32_t x, int32_t y, int32_t z, const Element& e)
+    {
+        const size_t at = std::find(positions.begin(), positions.end(), vector3i_t(x, y, z)) - positions.begin();
+        ASSERT_LT(at, positions.size());
+        EXPECT_EQ(expected[at].neighbourhood, e.neighbourhood);
+        EXPECT_EQ(expected[at].group, e.group);
+        EXPECT_EQ(&e, brickSnapshot.GetElement(vector3i_t(x, y, z)));
+        ++count;
+    });
+    EXPECT_EQ(expected.size(), count);
+}
+
+TEST_F(CoreStorageTest, LookupsDontCopySharedElements)
+{
+    for (int x = -4; x < 4; ++x)
+        for (int z = -4; z < 4; ++z)
+            SetElement(ElementType::Cube, vector3i_t(x,0,z), Directions::pZ);
+
+    Core::Snapshot snapshot = m_builder->GetCore().TakeSnapshot();
+    LinearCore::Snapshot linearSnapshot = m_linearCore->TakeSnapshot();
+    WideCore::Snapshot wideSnapshot = m_wideCore->TakeSnapshot();
+
+    // lookups and misses of GetElement read elements shared with snapshots
+    for (int x = -5; x < 5; ++x)
+    {
+        for (int z = -5; z < 5; ++z)
+        {
+            EXPECT_TRUE(nullptr == m_builder->GetCore().GetElement(vector3i_t(x,1,z)));
+            EXPECT_TRUE(nullptr == m_linearCore->GetElement(vector3i_t(x,1,z)));
+            EXPECT_TRUE(nullptr == m_wideCore->GetElement(vector3i_t(x,1,z)));
+            const vector3i_t position(x,0,z);
+            EXPECT_EQ(snapshot.GetElement(position), m_builder->GetCore().FindElement(position));
+            EXPECT_EQ(linearSnapshot.GetElement(position), m_linearCore->FindElement(position));
+            EXPECT_EQ(wideSnapshot.GetElement(position), m_wideCore->FindElement(position));
+        }
+    }
+    EXPECT_EQ(snapshot.GetElement(vector3i_t(0,0,0))->group, m_builder->GetGroup(vector3i_t(0,0,0)));
+    EXPECT_EQ(snapshot.GetElement(vector3i_t(0,0,0)), m_builder->GetCore().FindElement(vector3i_t(0,0,0)));
+}
+
+TEST_F(CoreStorageTest, SaveAndLoad)
+{
+    SetElement(ElementType::Wedge, vector3i_t(0,0,1), Directions::nX);
+    SetElement(ElementType::Wedge, vector3i_t(1,0,0), Directions::pX);
+    SetElement(ElementType::Wedge, vector3i_t(1,0,1), Directions::pZ);
+    SetElement(ElementType::CilindricPlatform, vector3i_t(-5,0,5), Directions::pZ);
+    SetElement(ElementType::Cube, vector3i_t(-5,1,5), Directions::pZ, Directions::nY);
+    for (int x = -4; x < 4; ++x)
+        SetElement(ElementType::Cube, vector3i_t(x,0,-3), Directions::pZ);
+
+    std::ostringstream out;
+    m_builder->GetCore().Save(out);
+    const std::string bytes = out.str();
+    std::vector<uint64_t> image((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(image.data(), bytes.data(), bytes.size());
+
+    // the linear core has the same elements, so its image is the same
+    std::ostringstream linearOut;
+    m_linearCore->Save(linearOut);
+    EXPECT_EQ(bytes, linearOut.str());
+    std::ostringstream wideOut;
+    m_wideCore->Save(wideOut);
+    EXPECT_EQ(bytes, wideOut.str());
+    std::ostringstream brickOut;
+    m_brickCore->Save(brickOut);
+    EXPECT_EQ(bytes, brickOut.str());
+
+    m_linearCore->Reset();
+    ASSERT_TRUE(m_linearCore->Load(image.data(), bytes.size()));
+    CompareWithReference(*m_linearCore);
+    EXPECT_EQ(m_builder->GetCore().ConstructionDesc().boundingBox.LFT, m_linearCore->ConstructionDesc().boundingBox.LFT);
+    EXPECT_EQ(m_builder->GetCore().ConstructionDesc().boundingBox.RBB, m_linearCore->ConstructionDesc().boundingBox.RBB);
+
+    m_wideCore->Reset();
+    ASSERT_TRUE(m_wideCore->Load(image.data(), bytes.size()));
+    CompareWithReference(*m_wideCore);
+
+    m_brickCore->Reset();
+    ASSERT_TRUE(m_brickCore->Load(image.data(), bytes.size()));
+    CompareWithReference(*m_brickCore);
+
+    Core core(GetConstructionLibrary());
+    ASSERT_TRUE(core.Load(image.data(), bytes.size()));
+    CompareWithReference(core);
+
+    // new elements get new groups
+    core.SetElement(*GetConstructionLibrary().GetConstructionDescription(ElementType::Cube), vector3i_t(10,5,10), Directions::pZ, Directions::pZ);
+    m_builder->GetCore().SetElement(*GetConstructionLibrary().GetConstructionDescription(ElementType::Cube), vector3i_t(10,5,10), Directions::pZ, Directions::pZ);
+    CompareWithReference(core);
+
+    // unknown construction
+    reinterpret_cast<StoredElement*>(reinterpret_cast<char*>(image.data()) + bytes.size())[-1].construction = ElementType::SimplePrimitivesCount + 100;
+    EXPECT_FALSE(core.Load(image.data(), bytes.size()));
+    size_t count = 0;
+    core.IterrateObject([&](int32_t, int32_t, int32_t, Element&) { ++count; });
+    EXPECT_EQ(0, count);
+    EXPECT_FALSE(core.Load(image.data(), bytes.size() - 1));
+}
+
+TEST_F(CoreStorageTest, Stats)
+{
+    for (int x = -4; x < 4; ++x)
+        for (int z = -4; z < 4; ++z)
+            for (int y = 0; y < 3; ++y)
+                SetElement(ElementType::Cube, vector3i_t(x,y,z), Directions::pZ);
+    // a hole splits the pillar into two ranges
+    SetElement(ElementType::Cube, vector3i_t(0,5,0), Directions::pZ);
+
+    const CoreStats stats = m_builder->GetCore().GetStats();
+    const CoreStats linearStats = m_linearCore->GetStats();
+    EXPECT_EQ(64, stats.pillars.leaves);
+    EXPECT_EQ(65, stats.elements.ranges);
+    EXPECT_EQ(8 * 8 * 3 + 1, stats.elements.items);
+    EXPECT_LT(0, stats.pillars.fill);
+    EXPECT_LE(stats.pillars.bytes + stats.elements.bytes, stats.bytes);
+
+    EXPECT_EQ(stats.pillars.leaves, linearStats.pillars.leaves);
+    EXPECT_EQ(stats.elements.ranges, linearStats.elements.ranges);
+    EXPECT_EQ(stats.elements.items, linearStats.elements.items);
+
+    // 8x8 pillars at [-4, 4) fill 4 leaves of 4x4 completely
+    const CoreStats wideStats = m_wideCore->GetStats();
+    EXPECT_EQ(stats.pillars.leaves, wideStats.pillars.leaves);
+    EXPECT_EQ(4, wideStats.pillars.nodes[wideStats.pillars.nodes.size() - 2]);
+    EXPECT_EQ(stats.elements.ranges, wideStats.elements.ranges);
+    EXPECT_EQ(stats.elements.items, wideStats.elements.items);
+
+    // 8x8 columns at [-4, 4) take 4 bricks, the element at y = 5 is in one of them
+    const CoreStats brickStats = m_brickCore->GetStats();
+    EXPECT_EQ(4, brickStats.pillars.leaves);
+    EXPECT_EQ(4, brickStats.elements.ranges);
+    EXPECT_EQ(stats.elements.items, brickStats.elements.items);
+    EXPECT_EQ(4 * BrickStorage::Bricks_t::c_volume, brickStats.elements.capacity);
+    EXPECT_LE(brickStats.pillars.bytes + brickStats.elements.bytes, brickStats.bytes);
+}
+
+TEST_F(CoreStorageTest, PackedElements)
+{
+    ASSERT_EQ(12, sizeof(Element));
+
+    // the platform covers 3x3 cells, the second wedge is morphed to a corner
+    SetElement(ElementType::CilindricPlatform, vector3i_t(0,0,0), Directions::pZ);
+    SetElement(ElementType::Wedge, vector3i_t(5,0,0), Directions::nX);
+    SetElement(ElementType::Wedge, vector3i_t(5,0,1), Directions::pZ);
+    CompareWithReference(*m_linearCore);
+    CompareWithReference(*m_wideCore);
+    CompareWithReference(*m_brickCore);
+
+    Core& core = m_builder->GetCore();
+    const Element* platform = core.GetElement(vector3i_t(0,0,0));
+    const Element* covered = core.GetElement(vector3i_t(1,0,1));
+    const Element* corner = core.GetElement(vector3i_t(5,0,1));
+    ASSERT_TRUE(nullptr != platform && nullptr != covered && nullptr != corner);
+    EXPECT_EQ(ElementType::CilindricPlatform, core.GetConstruction(*platform)->primitiveUID);
+    EXPECT_EQ(ElementType::CilindricPlatform, core.GetType(*platform));
+    EXPECT_EQ(ElementType::Space, core.GetConstruction(*covered)->primitiveUID);
+    EXPECT_EQ(ElementType::CilindricPlatform, core.GetType(*covered));
+    EXPECT_EQ(ElementType::WedgeOutCorner, core.GetConstruction(*corner)->primitiveUID);
+    EXPECT_EQ(ElementType::Wedge, core.GetType(*corner));
+
+    // the snapshot keeps constructions of its elements
+    Core::Snapshot snapshot = core.TakeSnapshot();
+    SetElement(ElementType::Sphere, vector3i_t(0,5,0), Directions::pZ);
+    const Element* stored = snapshot.GetElement(vector3i_t(5,0,1));
+    ASSERT_TRUE(nullptr != stored);
+    EXPECT_EQ(core.GetConstruction(*corner), snapshot.GetConstruction(*stored));
+    EXPECT_EQ(ElementType::Wedge, snapshot.GetType(*stored));
+    EXPECT_EQ(ElementType::CilindricPlatform, snapshot.GetType(*snapshot.GetElement(vector3i_t(1,0,1))));
+}
+
+TEST_F(CoreStorageTest, ConstructionsOverflow)
+{
+    // the reference of covered cells takes the first index, other indices are distinct constructions
+    std::vector<ConstructionDescription> descs(UINT16_MAX + 1);
+    for (size_t i = 0; i < descs.size(); ++i)
+    {
+        descs[i].primitiveUID = static_cast<ElementType>(ElementType::UserCreated + i);
+        descs[i].boundingBox = BBox(vector3i_t(0,0,0), vector3i_t(1,1,1));
+    }
+    for (int32_t i = 0; i < UINT16_MAX; ++i)
+        m_linearCore->SetElement(descs[i], vector3i_t(i % 256, 0, i / 256), Directions::pZ, Directions::nY);
+
+    const vector3i_t last(0, 1, 0);
+    EXPECT_THROW(m_linearCore->SetElement(descs.back(), last, Directions::pZ, Directions::nY), std::length_error);
+    EXPECT_TRUE(nullptr == m_linearCore->GetElement(last));
+    m_linearCore->SetElement(descs[7], last, Directions::pZ, Directions::nY);
+    EXPECT_EQ(&descs[7], m_linearCore->GetConstruction(*m_linearCore->GetElement(last)));
+}
+
+// layers of a slab are separate groups welded one by one,
+// the result is the same as the slab built as a single group
+template <class CoreType>
+void CheckWeldedLayers(ConstructionLibrary& library)
+{
+    const ConstructionDescription& cube = *library.GetConstructionDescription(ElementType::Cube);
+    const int side = 5;
+    const int layers = 5;
+    CoreType reference(library);
+    CoreType core(library);
+    std::vector<uint32_t> groups;
+    for (int y = 0; y < layers; ++y)
+        for (int z = 0; z < side; ++z)
+            for (int x = 0; x < side; ++x)
+            {
+                reference.SetElement(cube, vector3i_t(x,y,z), Directions::pZ, Directions::nY);
+                // the first element of a layer starts a new group, others copy it from the previous one
+                const Directions from = y ? (x ? Directions::nX : (z ? Directions::nZ : Directions::pZ)) : Directions::nY;
+                core.SetElement(cube, vector3i_t(x,y,z), Directions::pZ, from);
+                if (!x && !z)
+                    groups.push_back(core.GetElement(vector3i_t(x,y,z))->group);
+            }
+    ASSERT_EQ(0, groups[0]);
+    ASSERT_NE(groups[3], groups[4]);
+    ASSERT_EQ(0, core.GetElement(vector3i_t(1,0,1))->neighbourhood & Directions::pY) << "layers are not welded yet";
+
+    EXPECT_TRUE(core.Weld(groups[3], groups[4]));
+    EXPECT_TRUE(core.Weld(groups[1], groups[2]));
+    EXPECT_FALSE(core.Weld(groups[3], groups[4]));
+    EXPECT_FALSE(core.Weld(groups[0], groups[4])) << "id of the welded group";
+    EXPECT_TRUE(core.Weld(0, groups[3]));
+    EXPECT_TRUE(core.Weld(0, groups[1]));
+
+    size_t count = 0;
+    reference.IterrateObject([&](int32_t x, int32_t y, int32_t z, Element& expected)
+    {
+        const Element* actual = core.GetElement(vector3i_t(x,y,z));
+        ASSERT_TRUE(nullptr != actual);
+        EXPECT_EQ(0, actual->group);
+        EXPECT_EQ(expected.neighbourhood, actual->neighbourhood) << "[" << x << "," << y << "," << z << "]";
+        ++count;
+    });
+    EXPECT_EQ(side * side * layers, count);
+}
+
+TEST_F(CoreStorageTest, WeldedLayers)
+{
+    CheckWeldedLayers<Core>(GetConstructionLibrary());
+    CheckWeldedLayers<LinearCore>(GetConstructionLibrary());
+    CheckWeldedLayers<WideCore>(GetConstructionLibrary());
+    CheckWeldedLayers<BrickCore>(GetConstructionLibrary());
+}
+
+TEST_F(CoreStorageTest, SaveWeldedGroups)
+{
+    SetElement(ElementType::Cube, vector3i_t(0,0,0), Directions::pZ);
+    SetElement(ElementType::Cube, vector3i_t(0,1,0), Directions::pZ, Directions::pZ);
+    SetElement(ElementType::Cube, vector3i_t(0,2,0), Directions::pZ, Directions::pZ);
+    const uint32_t group1 = m_builder->GetCore().GetElement(vector3i_t(0,1,0))->group;
+    const uint32_t group2 = m_builder->GetCore().GetElement(vector3i_t(0,2,0))->group;
+    ASSERT_NE(group1, group2);
+    Core::Snapshot before = m_builder->GetCore().TakeSnapshot();
+    ASSERT_TRUE(m_builder->GetCore().Weld(group1, group2));
+    Core::Snapshot after = m_builder->GetCore().TakeSnapshot();
+
+    // the old snapshot keeps the old group id, elements keep ids of their sets
+    EXPECT_EQ(group2, before.GetGroup(*before.GetElement(vector3i_t(0,2,0))));
+    EXPECT_EQ(group1, after.GetGroup(*after.GetElement(vector3i_t(0,2,0))));
+    EXPECT_EQ(group1, m_builder->GetGroup(vector3i_t(0,2,0)));
+
+    std::ostringstream out;
+    after.Save(out);
+    const std::string bytes = out.str();
+    std::vector<uint64_t> image((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(image.data(), bytes.data(), bytes.size());
+    ASSERT_TRUE(m_linearCore->Load(image.data(), bytes.size()));
+    EXPECT_EQ(group1, m_linearCore->GetElement(vector3i_t(0,2,0))->group);
+
+    // contacts of loaded groups are restored
+    EXPECT_EQ(0, m_linearCore->GetElement(vector3i_t(0,0,0))->neighbourhood);
+    EXPECT_TRUE(m_linearCore->Weld(0, group1));
+    EXPECT_EQ(Directions::pY, m_linearCore->GetElement(vector3i_t(0,0,0))->neighbourhood);
+    EXPECT_TRUE(m_builder->GetCore().Weld(0, group1));
+    CompareWithReference(*m_linearCore);
+}
+
+TEST_F(CoreStorageTest, ContactsDontGrow)
+{
+    Core& core = m_builder->GetCore();
+    const ConstructionDescription& cube = *GetConstructionLibrary().GetConstructionDescription(ElementType::Cube);
+    core.SetElement(cube, vector3i_t(0,0,0), Directions::pZ, Directions::nY);
+    core.SetElement(cube, vector3i_t(0,1,1), Directions::pZ, Directions::pZ);
+    EXPECT_EQ(0, core.GetStats().contacts);
+
+    // the upper cube is replaced by the cube of the same group touching the ground group
+    for (int i = 0; i < 1000; ++i)
+        core.SetElement(cube, vector3i_t(0,1,0), Directions::pZ, Directions::pZ);
+    EXPECT_GT(200, core.GetStats().contacts) << "repeated contacts are dropped";
+
+    const uint32_t group = core.GetElement(vector3i_t(0,1,1))->group;
+    ASSERT_EQ(group, core.GetElement(vector3i_t(0,1,0))->group);
+    EXPECT_TRUE(core.Weld(0, group));
+    EXPECT_EQ(Directions::pY, core.GetElement(vector3i_t(0,0,0))->neighbourhood);
+    EXPECT_EQ(0, core.GetElement(vector3i_t(0,1,1))->group);
+}
+
+// random placements of different elements, cells of elements don't intersect unless overwrite is set
+std::vector<Placement> RandomPlacements(ConstructionLibrary& library, size_t count, bool overwrite)
+{
+    const ElementType types[] = {ElementType::Cube, ElementType::Cube, ElementType::Wedge, ElementType::Wedge, ElementType::Ledder, ElementType::Sphere, ElementType::CilindricPlatform};
+    const Directions directions[] = {Directions::pZ, Directions::pX, Directions::nZ, Directions::nX};
+    const Directions sources[] = {Directions::nY, Directions::nY, Directions::pZ, Directions::nX, Directions::pX};
+    std::set<vector3i_t, RegionLess> used;
+    std::vector<Placement> placements;
+    while (placements.size() < count)
+    {
+        const ConstructionDescription* desc = library.GetConstructionDescription(types[rand() % (sizeof(types) / sizeof(types[0]))]);
+        const Placement placement = {desc, vector3i_t(rand() % 12 - 6, rand() % 5, rand() % 12 - 6),
+            directions[rand() % 4], sources[rand() % 5]};
+        const BBox& box = desc->boundingBox;
+        bool free = true;
+        for (int x = box.LFT.x; x < box.RBB.x; ++x)
+            for (int z = box.LFT.z; z < box.RBB.z; ++z)
+                free = free && !used.count(placement.position + vector3i_t(x, 0, z));
+        if (!free && !overwrite)
+            continue;
+        for (int x = box.LFT.x; x < box.RBB.x; ++x)
+            for (int z = box.LFT.z; z < box.RBB.z; ++z)
+                used.insert(placement.position + vector3i_t(x, 0, z));
+        placements.push_back(placement);
+    }
+    return placements;
+}
+
+// SetElements gives the same construction as SetElement calls
+template <class CoreType>
+void CheckBatch(ConstructionLibrary& library, const std::vector<Placement>& before, const std::vector<Placement>& placements)
+{
+    CoreType sequential(library);
+    CoreType batch(library);
+    for (const auto& p : before)
+    {
+        sequential.SetElement(*p.construction, p.position, p.direction, p.copySettingsFrom);
+        batch.SetElement(*p.construction, p.position, p.direction, p.copySettingsFrom);
+    }
+    for (const auto& p : placements)
+        sequential.SetElement(*p.construction, p.position, p.direction, p.copySettingsFrom);
+    batch.SetElements(placements);
+
+    EXPECT_EQ(sequential.ConstructionDesc().boundingBox.LFT, batch.ConstructionDesc().boundingBox.LFT);
+    EXPECT_EQ(sequential.ConstructionDesc().boundingBox.RBB, batch.ConstructionDesc().boundingBox.RBB);
+    size_t expected = 0;
+    sequential.IterrateObject([&](int32_t x, int32_t y, int32_t z, Element& e)
+    {
+        const Element* actual = batch.GetElement(vector3i_t(x,y,z));
+        ASSERT_TRUE(nullptr != actual) << "[" << x << "," << y << "," << z << "]";
+        EXPECT_EQ(sequential.GetConstruction(e)->primitiveUID, batch.GetConstruction(*actual)->primitiveUID);
+        EXPECT_EQ(sequential.GetType(e), batch.GetType(*actual));
+        EXPECT_EQ(e.direction, actual->direction);
+        EXPECT_EQ(e.originalDirection, actual->originalDirection);
+        EXPECT_EQ(e.neighbourhood, actual->neighbourhood) << "[" << x << "," << y << "," << z << "]";
+        EXPECT_EQ(e.group, actual->group);
+        ++expected;
+    });
+    size_t count = 0;
+    batch.IterrateObject([&](int32_t, int32_t, int32_t, Element&) {++count;});
+    EXPECT_EQ(expected, count);
+}
+
+TEST_F(CoreStorageTest, BatchMatchesSequentialPlacement)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        const std::vector<Placement> placements = RandomPlacements(GetConstructionLibrary(), 300, false);
+        CheckBatch<Core>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+        CheckBatch<LinearCore>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+        CheckBatch<WideCore>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+        CheckBatch<BrickCore>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+    }
+}
+
+// wedges are placed one by one, other batches update neighbourhoods at the end
+TEST_F(CoreStorageTest, BatchWithoutWedgesMatchesSequentialPlacement)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        std::vector<Placement> placements = RandomPlacements(GetConstructionLibrary(), 300, false);
+        placements.erase(std::remove_if(placements.begin(), placements.end(), [](const Placement& p)
+        {
+            return ElementType::Wedge == p.construction->primitiveUID;
+        }), placements.end());
+        CheckBatch<Core>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+        CheckBatch<LinearCore>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+        CheckBatch<WideCore>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+        CheckBatch<BrickCore>(GetConstructionLibrary(), std::vector<Placement>(), placements);
+    }
+}
+
+TEST_F(CoreStorageTest, BatchOverwritesElements)
+{
+    const std::vector<Placement> before = RandomPlacements(GetConstructionLibrary(), 100, false);
+    const std::vector<Placement> placements = RandomPlacements(GetConstructionLibrary(), 200, true);
+    CheckBatch<Core>(GetConstructionLibrary(), before, placements);
+    CheckBatch<LinearCore>(GetConstructionLibrary(), before, placements);
+    CheckBatch<WideCore>(GetConstructionLibrary(), before, placements);
+    CheckBatch<BrickCore>(GetConstructionLibrary(), before, placements);
+}
+
+// builds shapes of BuildingBerthTest with every storage, compare the time of tests
+class CoreStorageBenchmark : public CoreStorageTest
+{
+protected:
+    static const int c_side = 64;
+
+    template <class CoreType>
+    void Build(CoreType& core, bool sponge)
+    {
+        const ConstructionDescription& desc = *GetConstructionLibrary().GetConstructionDescription(ElementType::Cube);
+        for (int x = 0; x < c_side; ++x)
+            for (int y = 0; y < c_side; ++y)
+                for (int z = 0; z < c_side; ++z)
+                {
+                    if (!sponge || (x + y + z) % 2)
+                        core.SetElement(desc, vector3i_t(x,y,z), Directions::pZ, Directions::nY);
+                }
+
+        size_t count = 0;
+        core.IterrateObject([&](int32_t, int32_t, int32_t, Element&) {++count;});
+        EXPECT_EQ(sponge ? c_side * c_side * c_side / 2 : c_side * c_side * c_side, count);
+        core.Weld(0, 1);
+    }
+};
+
+const int CoreStorageBenchmark::c_side;
+
+TEST_F(CoreStorageBenchmark, SolidCubeCore)         {Core core(GetConstructionLibrary()); Build(core, false);}
+TEST_F(CoreStorageBenchmark, SolidCubeLinearCore)   {Build(*m_linearCore, false);}
+TEST_F(CoreStorageBenchmark, SolidCubeWideCore)     {Build(*m_wideCore, false);}
+TEST_F(CoreStorageBenchmark, SolidCubeBrickCore)    {Build(*m_brickCore, false);}
+TEST_F(CoreStorageBenchmark, SpongeCore)            {Core core(GetConstructionLibrary()); Build(core, true);}
+TEST_F(CoreStorageBenchmark, SpongeLinearCore)      {Build(*m_linearCore, true);}
+TEST_F(CoreStorageBenchmark, SpongeWideCore)        {Build(*m_wideCore, true);}
+TEST_F(CoreStorageBenchmark, SpongeBrickCore)       {Build(*m_brickCore, true);}
+
+// the cube placed in random order, element by element or as a single batch
+class BatchBenchmark : public CoreStorageBenchmark
+{
+protected:
+    template <class CoreType>
+    void Place(CoreType& core, bool batch)
+    {
+        const ConstructionDescription* desc = GetConstructionLibrary().GetConstructionDescription(ElementType::Cube);
+        std::vector<Placement> placements;
+        for (int x = 0; x < c_side; ++x)
+            for (int y = 0; y < c_side; ++y)
+                for (int z = 0; z < c_side; ++z)
+                {
+                    const Placement placement = {desc, vector3i_t(x, y, z), Directions::pZ, Directions::nY};
+                    placements.push_back(placement);
+                }
+        std::mt19937 random(5489u);
+        std::shuffle(placements.begin(), placements.end(), random);
+
+        if (batch)
+            core.SetElements(placements);
+        else
+            for (const auto& p : placements)
+                core.SetElement(*p.construction, p.position, p.direction, p.copySettingsFrom);
+        EXPECT_EQ(vector3i_t(c_side, c_side, c_side), core.ConstructionDesc().boundingBox.RBB);
+    }
+};
+
+TEST_F(BatchBenchmark, SequentialLinearCore)    {Place(*m_linearCore, false);}
+TEST_F(BatchBenchmark, BatchLinearCore)         {Place(*m_linearCore, true);}
+TEST_F(BatchBenchmark, SequentialWideCore)      {Place(*m_wideCore, false);}
+TEST_F(BatchBenchmark, BatchWideCore)           {Place(*m_wideCore, true);}
+TEST_F(BatchBenchmark, SequentialBrickCore)     {Place(*m_brickCore, false);}
+TEST_F(BatchBenchmark, BatchBrickCore)          {Place(*m_brickCore, true);}
+
+// single cube edits on the sponge, the mesh is constructed from scratch or updated after every edit
+class HullBenchmark : public CoreStorageBenchmark
+{
+protected:
+    void Edit(bool incremental)
+    {
+        Build(*m_linearCore, true);
+        MeshLibrary& meshLibrary = static_cast<Library&>(m_builder->GetLibrary()).GetMeshLibrary();
+        const ConstructionDescription& desc = *GetConstructionLibrary().GetConstructionDescription(ElementType::Cube);
+        Hull hull(meshLibrary);
+        hull.ConstructMesh(*m_linearCore);
+        for (int i = 0; i < 20; ++i)
+        {
+            m_linearCore->SetElement(desc, vector3i_t(i, c_side, i), Directions::pZ, Directions::nY);
+            if (incremental)
+                hull.UpdateMesh(*m_linearCore);
+            else
+                hull.ConstructMesh(*m_linearCore);
+        }
+        EXPECT_FALSE(hull.GetDesc().Shapes[ConstructorElements::MeshIndex].Positions.Data.empty());
+    }
+};
+
+TEST_F(HullBenchmark, ConstructAfterEdits)  {Edit(false);}
+TEST_F(HullBenchmark, UpdateAfterEdits)     {Edit(true);}
+
+// eof
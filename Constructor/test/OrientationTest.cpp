@@ -0,0 +1,184 @@
+#include "Orientation.h"
+#include "BuildingBerth.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace ConstructorImpl;
+
+// rotation of Core before the tables, the reference of Orientation::rotate
+static vector3i_t ReferenceRotate(const vector3i_t& vec, unsigned int dst)
+{
+    vector3i_t out = vec;
+
+    switch(dst & MODIFICATOR_MASK)
+    {
+    case Directions::LeftToRight:
+        out.x = -out.x;
+        break;
+    }
+
+    switch(dst & DIRECTION_MASK)
+    {
+    case Directions::nX : return vector3i_t(-out.z, out.y,  out.x);
+    case Directions::pX : return vector3i_t( out.z, out.y, -out.x);
+    case Directions::nZ : return vector3i_t(-out.x, vec.y, -out.z);
+    case Directions::nY : return vector3i_t( out.x, -out.z, out.y);
+    case Directions::pY : return vector3i_t( out.x,  out.z, out.y);
+    }
+
+    return out;
+}
+
+// mesh rotation before the tables, the reference of Orientation::transform
+static void ReferenceTransform(const float* in, uint32_t dst, const vector3f_t& offset, float* out)
+{
+    out[0] = in[0]; out[1] = in[1]; out[2] = in[2];
+
+    switch(dst & MODIFICATOR_MASK)
+    {
+    case Directions::LeftToRight:
+        out[0] = 1 - out[0];
+        break;
+    }
+
+    float tmp = out[0];
+    switch(dst & DIRECTION_MASK)
+    {
+    case Directions::nX :
+        out[0] = 1 - out[2];
+        out[2] = tmp;
+        break;
+    case Directions::pX :
+        out[0] = out[2];
+        out[2] = 1 - tmp;
+        break;
+    case Directions::nZ :
+        out[0] = 1 - out[0];
+        out[2] = 1 - out[2];
+        break;
+    default:
+        break;
+    }
+    out[0] += offset.x; out[1] += offset.y; out[2] += offset.z;
+}
+
+// orientations of every transform slot, plain and mirrored, and orientations with spurious bits:
+// no direction, combinations of directions, other modificators and their combinations
+static std::vector<unsigned int> Orientations()
+{
+    const unsigned int directions[] = {Directions::pZ, Directions::pX, Directions::nX, Directions::nZ, Directions::pY, Directions::nY,
+        Directions::NO, Directions::pX | Directions::pY, Directions::nX | Directions::nZ, 0x40, 0x80, Directions::All};
+    const unsigned int modificators[] = {0, Directions::LeftToRight, Directions::FrontToBack, Directions::UpSideDown,
+        Directions::LeftToRight | Directions::FrontToBack, 0x8000};
+    std::vector<unsigned int> orientations;
+    for (auto direction : directions)
+        for (auto modificator : modificators)
+            orientations.push_back(direction | modificator);
+    // bits above 16 are ignored
+    orientations.push_back(0x10000 | Directions::pX | Directions::LeftToRight);
+    return orientations;
+}
+
+TEST(OrientationTest, OrientationsReachEveryTransform)
+{
+    std::vector<bool> reached(Orientation::c_transformsCount, false);
+    for (auto orientation : Orientations())
+        reached[Orientation::index(orientation)] = true;
+    EXPECT_EQ(std::vector<bool>(Orientation::c_transformsCount, true), reached);
+}
+
+TEST(OrientationTest, RotationsMatchReference)
+{
+    std::vector<vector3i_t> vectors;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            for (int z = -1; z <= 1; ++z)
+                vectors.push_back(vector3i_t(x, y, z));
+    vectors.push_back(vector3i_t(2, -3, 5));
+
+    for (auto dst : Orientations())
+    {
+        for (const auto& vec : vectors)
+            ASSERT_EQ(ReferenceRotate(vec, dst), Orientation::rotate(vec, dst)) << "orientation " << dst;
+    }
+}
+
+TEST(OrientationTest, TransformsMatchReference)
+{
+    // coordinates of vertices and normals of primitive meshes
+    const float points[][3] =
+    {
+        {0.0f, 0.0f, 0.0f},
+        {1.0f, 0.0f, 1.0f},
+        {0.0f, 1.0f, 1.0f},
+        {0.5f, 0.25f, 0.75f},
+        {0.0f, 0.707106f, 0.707106f},
+        {-1.0f, 0.0f, 0.0f},
+        {0.0f, -1.0f, 0.0f},
+        {0.0f, 0.0f, -1.0f},
+    };
+    const vector3f_t offsets[] = {vector3f_t(0, 0, 0), vector3f_t(-100001, 3, 70000)};
+
+    for (auto dst : Orientations())
+    {
+        for (const auto& point : points)
+        {
+            for (const auto& offset : offsets)
+            {
+                float expected[3];
+                float actual[3];
+                ReferenceTransform(point, dst, offset, expected);
+                Orientation::transform(point, dst, offset, actual);
+                ASSERT_EQ(expected[0], actual[0]) << "orientation " << dst;
+                ASSERT_EQ(expected[1], actual[1]) << "orientation " << dst;
+                ASSERT_EQ(expected[2], actual[2]) << "orientation " << dst;
+            }
+        }
+    }
+}
+
+TEST(OrientationTest, NeighborTablesMatchScan)
+{
+    BuildingBerth berth;
+    const ConstructionLibrary& library = static_cast<Library&>(berth.GetLibrary()).GetConstructionLibrary();
+    std::vector<vector3i_t> directions;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            for (int z = -1; z <= 1; ++z)
+                directions.push_back(vector3i_t(x, y, z));
+
+    for (uint32_t type = ElementType::Cube; type < ElementType::SimplePrimitivesCount; ++type)
+    {
+        const ConstructionDescription& desc = *library.GetConstructionDescription(type);
+        const NeighborTable* table = library.GetNeighborTable(desc);
+        ASSERT_TRUE(nullptr != table) << "primitive " << type;
+
+        for (auto orientation : Orientations())
+        {
+            for (const auto& direction : directions)
+            {
+                // the lookup of Core before the tables
+                const NeighborDesc* expected = nullptr;
+                for (const auto& relation : desc.neighbors)
+                {
+                    if (Orientation::rotate(relation.relationPosition, orientation) == direction)
+                    {
+                        expected = &relation;
+                        break;
+                    }
+                }
+
+                const int facing = Orientation::directionIndex(direction);
+                const uint8_t relation = (facing < 0) ? NeighborTable::c_none : table->relations[Orientation::index(orientation)][facing];
+                const NeighborDesc* actual = (NeighborTable::c_none == relation) ? nullptr : &desc.neighbors[relation];
+                ASSERT_EQ(expected, actual) << "primitive " << type << " orientation " << orientation;
+            }
+        }
+
+        // copies of descriptions are not indexed
+        ConstructionDescription copy = desc;
+        ASSERT_TRUE(nullptr == library.GetNeighborTable(copy));
+    }
+}
+
+// eof
@@ -0,0 +1,352 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "Parallel.h"
+#include "Stats.h"
+
+namespace Utils
+{
+    // Sparse 3D map of dense bricks: space is split into cubes of side 2^Bits,
+    // every cube with items is a brick, a plain array of items with an occupancy bitmask.
+    // Bricks are found by their coordinates in a hash table, an item inside of a brick
+    // is addressed by index arithmetic, so items next to each other are next to each other
+    // in memory and neighbour lookups mostly end up in the same brick.
+    // get_item_at remembers the last brick, so the lookups of neighbours skip the hash table.
+    // Items are visited brick by brick in the order bricks were created,
+    // inside of a brick Y changes first, then Z, then X.
+    // Bricks are shared with snapshots: snapshot() copies the table of bricks only,
+    // the first modification of a shared brick copies the brick.
+    // T must be default constructible, free cells of bricks keep T()
+    // NOTE: pointers returned by get_item_at and insert are valid until the next insertion or removal
+    template <class T, size_t Bits = 4>
+    class BrickMap
+    {
+    public:
+        static const size_t c_side   = size_t(1) << Bits;
+        static const size_t c_volume = c_side * c_side * c_side;
+
+        struct Brick
+        {
+            Brick() : count(0), occupancy(), items() {}
+
+            bool test(size_t index) const {return 0 != (occupancy[index / 64] & (uint64_t(1) << (index % 64)));}
+
+            size_t      count;
+            uint64_t    occupancy[(c_volume + 63) / 64];
+            T           items[c_volume];
+        };
+
+        BrickMap() : m_cached(0) {}
+
+        // item at (x, y, z), the brick of the item is copied if it's shared with snapshots
+        T* get_item_at(int32_t x, int32_t y, int32_t z)
+        {
+            const Key key = {x >> Bits, y >> Bits, z >> Bits};
+            const size_t slot = find_slot(key);
+            if (slot == m_slots.size())
+                return nullptr;
+            const size_t index = local_index(x, y, z);
+            return m_slots[slot].brick->test(index) ? &own(m_slots[slot]).items[index] : nullptr;
+        }
+
+        // read only lookup, it doesn't touch the cache, so it can be called concurrently
+        const T* find(int32_t x, int32_t y, int32_t z) const
+        {
+            return find_item(m_index, m_slots, x, y, z);
+        }
+
+        // writes value to (x, y, z), the brick is created if required
+        T& insert(int32_t x, int32_t y, int32_t z, const T& value)
+        {
+            const Key key = {x >> Bits, y >> Bits, z >> Bits};
+            size_t slot = find_slot(key);
+            if (slot == m_slots.size())
+            {
+                const Slot created = {key, std::make_shared<Brick>()};
+                m_index.insert(std::make_pair(key, slot));
+                m_slots.push_back(created);
+                m_cached = slot;
+            }
+            Brick& brick = own(m_slots[slot]);
+            const size_t index = local_index(x, y, z);
+            if (!brick.test(index))
+            {
+                brick.occupancy[index / 64] |= uint64_t(1) << (index % 64);
+                ++brick.count;
+            }
+            brick.items[index] = value;
+            return brick.items[index];
+        }
+
+        // removes item, the brick is released when its last item is removed
+        void remove(int32_t x, int32_t y, int32_t z)
+        {
+            const Key key = {x >> Bits, y >> Bits, z >> Bits};
+            const size_t slot = find_slot(key);
+            const size_t index = local_index(x, y, z);
+            if (slot == m_slots.size() || !m_slots[slot].brick->test(index))
+                return;
+            Brick& brick = own(m_slots[slot]);
+            brick.occupancy[index / 64] &= ~(uint64_t(1) << (index % 64));
+            brick.items[index] = T();
+            if (--brick.count)
+                return;
+
+            // the last slot takes place of the released one
+            m_index.erase(key);
+            if (slot + 1 != m_slots.size())
+            {
+                m_slots[slot] = m_slots.back();
+                m_index[m_slots[slot].key] = slot;
+            }
+            m_slots.pop_back();
+        }
+
+        // visits items as visitor(x, y, z, item), shared bricks are copied
+        template <class F>
+        void visit(F&& visitor)
+        {
+            for (auto& slot : m_slots)
+                visit_brick(slot.key, own(slot), visitor);
+        }
+
+        template <class F>
+        void visit(F&& visitor) const
+        {
+            for (const auto& slot : m_slots)
+                visit_brick(slot.key, static_cast<const Brick&>(*slot.brick), visitor);
+        }
+
+        // visits items inside of the box [x0, x1) x [y0, y1) x [z0, z1) in visit order,
+        // bricks outside of the box are skipped as a whole
+        template <class F>
+        void query(int32_t x0, int32_t y0, int32_t z0, int32_t x1, int32_t y1, int32_t z1, F&& visitor)
+        {
+            if (x0 >= x1 || y0 >= y1 || z0 >= z1)
+                return;
+            const Key low  = {x0 >> Bits, y0 >> Bits, z0 >> Bits};
+            const Key high = {(x1 - 1) >> Bits, (y1 - 1) >> Bits, (z1 - 1) >> Bits};
+            for (auto& slot : m_slots)
+            {
+                const Key& key = slot.key;
+                if (key.x < low.x || key.x > high.x || key.y < low.y || key.y > high.y || key.z < low.z || key.z > high.z)
+                    continue;
+                visit_brick(key, own(slot), [&](int32_t x, int32_t y, int32_t z, T& item)
+                {
+                    if (x0 <= x && x < x1 && y0 <= y && y < y1 && z0 <= z && z < z1)
+                        visitor(x, y, z, item);
+                });
+            }
+        }
+
+        // visits bricks concurrently, items of a brick are visited by a single thread in visit order
+        // visitor is shared by threads and must be thread safe
+        template <class F>
+        void parallel_for_each(F&& visitor)
+        {
+            own_all();
+            parallel_tasks(m_slots.size(), [&](size_t i)
+            {
+                visit_brick(m_slots[i].key, *m_slots[i].brick, visitor);
+            });
+        }
+
+        // parallel reduction: every brick accumulates its items to its own copy of identity
+        // with visitor(x, y, z, item, accumulator), then results are combined in visit order
+        template <class R, class F, class C>
+        R parallel_reduce(const R& identity, F&& visitor, C&& combine)
+        {
+            own_all();
+            return parallel_reduce_tasks(m_slots.size(), identity, [&](size_t i, R& accumulator)
+            {
+                visit_brick(m_slots[i].key, *m_slots[i].brick, [&](int32_t x, int32_t y, int32_t z, T& item)
+                {
+                    visitor(x, y, z, item, accumulator);
+                });
+            }, combine);
+        }
+
+        void clear()
+        {
+            m_slots.clear();
+            m_index.clear();
+            m_cached = 0;
+        }
+
+        bool empty() const {return m_slots.empty();}
+
+        size_t bricks_count() const {return m_slots.size();}
+
+        // number of items, O(bricks)
+        size_t size() const
+        {
+            size_t result = 0;
+            for (const auto& slot : m_slots)
+                result += slot.brick->count;
+            return result;
+        }
+
+        // bricks are leaves of a single level, fill is the share of occupied cells of bricks
+        // bytes include bricks shared with snapshots
+        TreeStats stats() const
+        {
+            TreeStats result;
+            result.nodes.push_back(m_slots.size());
+            result.leaves = m_slots.size();
+            result.bytes  = sizeof(*this) + m_slots.capacity() * sizeof(Slot) + m_slots.size() * sizeof(Brick) +
+                m_index.bucket_count() * sizeof(void*) + m_index.size() * (sizeof(Key) + 2 * sizeof(size_t));
+            result.fill   = m_slots.empty() ? 0 : double(size()) / (m_slots.size() * c_volume);
+            return result;
+        }
+
+    private:
+        struct Key
+        {
+            int32_t x;
+            int32_t y;
+            int32_t z;
+
+            bool operator==(const Key& other) const {return x == other.x && y == other.y && z == other.z;}
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                uint64_t h = static_cast<uint32_t>(key.x);
+                h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.y);
+                h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.z);
+                return static_cast<size_t>(h ^ (h >> 29));
+            }
+        };
+
+        struct Slot
+        {
+            Key                     key;
+            std::shared_ptr<Brick>  brick;
+        };
+
+        typedef std::unordered_map<Key, size_t, KeyHash> Index;
+
+    public:
+        // read only state of the map at the moment of snapshot() call
+        // the snapshot may be read and destroyed by any thread while the map is modified
+        class Snapshot
+        {
+        public:
+            Snapshot(Snapshot&& other) : m_index(std::move(other.m_index)), m_slots(std::move(other.m_slots)) {}
+
+            const T* find(int32_t x, int32_t y, int32_t z) const
+            {
+                return find_item(m_index, m_slots, x, y, z);
+            }
+
+            // visits items in the order of the map at the moment of snapshot() call
+            template <class F>
+            void visit(F&& visitor) const
+            {
+                for (const auto& slot : m_slots)
+                    visit_brick(slot.key, static_cast<const Brick&>(*slot.brick), visitor);
+            }
+
+        private:
+            friend class BrickMap;
+            Snapshot(const Index& index, const std::vector<Slot>& slots) : m_index(index), m_slots(slots) {}
+
+            Index               m_index;
+            std::vector<Slot>   m_slots;
+
+            Snapshot(const Snapshot&);
+            const Snapshot& operator=(const Snapshot&);
+        };
+
+        // O(bricks): copies the table, bricks are shared with the map
+        Snapshot snapshot()
+        {
+            return Snapshot(m_index, m_slots);
+        }
+
+    private:
+        static const size_t c_mask = c_side - 1;
+
+        static size_t local_index(int32_t x, int32_t y, int32_t z)
+        {
+            return (y & c_mask) | ((z & c_mask) << Bits) | ((x & c_mask) << (2 * Bits));
+        }
+
+        static const T* find_item(const Index& index, const std::vector<Slot>& slots, int32_t x, int32_t y, int32_t z)
+        {
+            const Key key = {x >> Bits, y >> Bits, z >> Bits};
+            auto it = index.find(key);
+            if (index.end() == it)
+                return nullptr;
+            const Brick& brick = *slots[it->second].brick;
+            const size_t local = local_index(x, y, z);
+            return brick.test(local) ? &brick.items[local] : nullptr;
+        }
+
+        // slot of the brick or m_slots.size(), the last found slot is checked first
+        size_t find_slot(const Key& key)
+        {
+            if (m_cached < m_slots.size() && m_slots[m_cached].key == key)
+                return m_cached;
+            auto it = m_index.find(key);
+            if (m_index.end() == it)
+                return m_slots.size();
+            m_cached = it->second;
+            return m_cached;
+        }
+
+        // copies the brick if it's shared with snapshots
+        static Brick& own(Slot& slot)
+        {
+            if (1 != slot.brick.use_count())
+                slot.brick = std::make_shared<Brick>(*slot.brick);
+            return *slot.brick;
+        }
+
+        void own_all()
+        {
+            for (auto& slot : m_slots)
+                own(slot);
+        }
+
+        // visits occupied cells of the brick, empty words of the mask are skipped
+        template <class B, class F>
+        static void visit_brick(const Key& key, B& brick, F&& visitor)
+        {
+            const int32_t x0 = key.x * static_cast<int32_t>(c_side);
+            const int32_t y0 = key.y * static_cast<int32_t>(c_side);
+            const int32_t z0 = key.z * static_cast<int32_t>(c_side);
+            for (size_t word = 0; word != sizeof(brick.occupancy) / sizeof(uint64_t); ++word)
+            {
+                const uint64_t bits = brick.occupancy[word];
+                for (size_t bit = 0; bit < 64 && (bits >> bit); ++bit)
+                {
+                    if (!((bits >> bit) & 1))
+                        continue;
+                    const size_t index = word * 64 + bit;
+                    visitor(x0 + static_cast<int32_t>(index >> (2 * Bits)),
+                            y0 + static_cast<int32_t>(index & c_mask),
+                            z0 + static_cast<int32_t>((index >> Bits) & c_mask),
+                            brick.items[index]);
+                }
+            }
+        }
+
+        Index               m_index;    // brick coordinates to slot
+        std::vector<Slot>   m_slots;    // bricks in visit order
+        size_t              m_cached;   // the slot found last
+
+        BrickMap(const BrickMap&);
+        const BrickMap& operator=(const BrickMap&);
+    };
+
+    template <class T, size_t Bits> const size_t BrickMap<T, Bits>::c_side;
+    template <class T, size_t Bits> const size_t BrickMap<T, Bits>::c_volume;
+    template <class T, size_t Bits> const size_t BrickMap<T, Bits>::c_mask;
+}
+// eof
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+namespace Utils
+{
+    // Disjoint sets of ids [0, size()): every id starts as a set of its own,
+    // unite merges two sets, find returns the root id of the set
+    // union by rank keeps trees logarithmic, find halves paths it walks,
+    // so any sequence of operations costs nearly O(1) per operation
+    class DisjointSets
+    {
+    public:
+        DisjointSets() {}
+
+        size_t size() const {return m_parent.size();}
+
+        // adds ids up to size - 1 as single sets, existing sets are not changed
+        void resize(size_t size)
+        {
+            for (size_t id = m_parent.size(); id < size; ++id)
+            {
+                m_parent.push_back(static_cast<uint32_t>(id));
+                m_rank.push_back(0);
+            }
+        }
+
+        // root of the set, every visited id is linked to its grandparent
+        uint32_t find(uint32_t id)
+        {
+            while (m_parent[id] != id)
+            {
+                m_parent[id] = m_parent[m_parent[id]];
+                id = m_parent[id];
+            }
+            return id;
+        }
+
+        // read only find, it can be called concurrently while sets are not modified
+        uint32_t find(uint32_t id) const
+        {
+            while (m_parent[id] != id)
+                id = m_parent[id];
+            return id;
+        }
+
+        // merges sets of a and b, returns the root of the merged set
+        uint32_t unite(uint32_t a, uint32_t b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return a;
+            if (m_rank[a] < m_rank[b])
+                std::swap(a, b);
+            m_parent[b] = a;
+            if (m_rank[a] == m_rank[b])
+                ++m_rank[a];
+            return a;
+        }
+
+        void clear()
+        {
+            m_parent.clear();
+            m_rank.clear();
+        }
+
+    private:
+        std::vector<uint32_t>   m_parent;   // roots are their own parents
+        std::vector<uint8_t>    m_rank;     // upper bound of the height of the tree of a root
+    };
+}
+// eof
@@ -0,0 +1,795 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include "Morton.h"
+#include "Parallel.h"
+#include "Stats.h"
+#include "Nearest.h"
+
+namespace Utils
+{
+    // Linear quad tree: there are no inner nodes, leaves are stored in flat arrays
+    // and addressed by the Morton code of their coordinates.
+    // Lookups go through an open addressing hash table, so there is no descent at all,
+    // for_each scans the leaves linearly in the same (Z) order as QuadTree visits them.
+    // Leaves are kept sorted lazily: out of order insertion or removal marks arrays
+    // unsorted and the next for_each sorts them once.
+    // The interface is the same as QuadTree has, so they are interchangeable.
+    // Coordinates are signed and not limited by the side of the tree: Morton codes are
+    // built from coordinates shifted by 2^31, so the order is the same as QuadTree uses.
+    // Keys, leaves and the hash table are stored inline in fixed size pages shared with
+    // snapshots: snapshot() is O(1), the first modification after it copies pointers to
+    // pages once, a page itself is copied on the first write access to it.
+    // Read only lookups (find) never copy anything.
+    // Bounding rect is extended on insertion, removal of a boundary leaf marks it stale
+    // and the next left/top/right/bottom recomputes it once.
+    // NOTE: insertion doesn't move leaves, but removal moves the last leaf to the gap,
+    // sorting (for_each and others) moves all of them and a page shared with a snapshot
+    // is copied on write access, so pointers returned by get_item_at and item are valid
+    // until the next removal, sorting or snapshot() call
+    template <class T>
+    class LinearQuadTree
+    {
+        struct Data;
+
+    public:
+        // side is not used, the linear tree is not limited
+        LinearQuadTree(size_t /*squareSide*/ = 0) : m_data(std::make_shared<Data>()), m_shared(false)
+        {
+            m_data->reset_table(c_minTableSize);
+        }
+
+        // item of bulk loading
+        struct Item
+        {
+            int32_t x;
+            int32_t y;
+            T       value;
+        };
+
+        // replaces content of the tree by items [first, last), items are Item or anything with x, y and value
+        // leaves are sorted once (sorted input is taken as is) and the hash table is built once
+        // the last of repeated items wins
+        template <class Iterator>
+        void assign(Iterator first, Iterator last)
+        {
+            std::vector<Iterator> items;
+            std::vector<uint64_t> keys;
+            for (Iterator it = first; it != last; ++it)
+            {
+                items.push_back(it);
+                keys.push_back(encode(it->x, it->y));
+            }
+            std::vector<uint32_t> order(items.size());
+            for (uint32_t i = 0; i < order.size(); ++i)
+                order[i] = i;
+            if (!std::is_sorted(keys.begin(), keys.end()))
+                std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {return keys[a] < keys[b];});
+
+            // nothing of the old content is kept, snapshots keep the old arrays
+            m_data = std::make_shared<Data>();
+            m_shared = false;
+            Data& d = *m_data;
+            d.keys.reserve(items.size());
+            d.values.reserve(items.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                if (i + 1 < order.size() && keys[order[i]] == keys[order[i + 1]])
+                    continue;
+                d.keys.push_back(keys[order[i]]);
+                d.values.push_back(items[order[i]]->value);
+                d.extend(items[order[i]]->x, items[order[i]]->y);
+            }
+
+            size_t tableSize = c_minTableSize;
+            while (tableSize < d.keys.size() * 2)
+                tableSize <<= 1;
+            d.rehash(tableSize);
+        }
+
+        void insert(int32_t x, int32_t y, T value)
+        {
+            item(x, y) = value;
+        }
+
+        // write access to the existing item, a miss doesn't copy shared pages
+        // use find for reading
+        T* get_item_at(int32_t x, int32_t y)
+        {
+            const uint64_t key   = encode(x, y);
+            const uint32_t index = m_data->table[m_data->lookup(key)];
+            if (c_empty == index)
+            {
+                return nullptr;
+            }
+            return &own().values.write(index);
+        }
+
+        // read only lookup, arrays are never copied, so it's safe to call it concurrently
+        const T* find(int32_t x, int32_t y) const
+        {
+            return m_data->find(encode(x, y));
+        }
+
+        T& item(int32_t x, int32_t y)
+        {
+            Data& d = own();
+            const uint64_t key  = encode(x, y);
+            const size_t   slot = d.lookup(key);
+            if (c_empty != d.table[slot])
+            {
+                return d.values.write(d.table[slot]);
+            }
+
+            if (!d.keys.empty() && d.keys.back() > key)
+            {
+                d.sorted = false;
+            }
+            d.table.write(slot) = static_cast<uint32_t>(d.keys.size());
+            d.keys.push_back(key);
+            d.values.push_back(T());
+            d.extend(x, y);
+
+            // keep load factor below 1/2, probe sequences stay short
+            if (d.keys.size() * 2 > d.table.size())
+            {
+                d.rehash(d.table.size() * 2);
+            }
+            return d.values.write(d.values.size() - 1);
+        }
+
+        void remove(int32_t x, int32_t y)
+        {
+            // removal of a missing item doesn't copy shared arrays
+            if (m_shared && !find(x, y))
+            {
+                return;
+            }
+            Data& d = own();
+            const size_t slot = d.lookup(encode(x, y));
+            const uint32_t index = d.table[slot];
+            if (c_empty == index)
+            {
+                return;
+            }
+            d.erase_slot(slot);
+            if (x == d.bounds[0] || y == d.bounds[1] || x == d.bounds[2] || y == d.bounds[3])
+            {
+                d.boundsValid = false;
+            }
+
+            // fill the gap with the last leaf
+            const uint32_t last = static_cast<uint32_t>(d.keys.size() - 1);
+            if (index != last)
+            {
+                d.table.write(d.lookup(d.keys[last])) = index;
+                d.keys.write(index)   = d.keys[last];
+                d.values.write(index) = d.values.take(last);
+                d.sorted = false;
+            }
+            d.keys.pop_back();
+            d.values.pop_back();
+        }
+
+        // bounding rect of items: [left, right) x [top, bottom)
+        // right and bottom are wider than coordinates, so the item at INT32_MAX is inside
+        // all bounds are 0 for the empty tree
+        int32_t left()
+        {
+            return m_data->keys.empty() ? 0 : bounds()[0];
+        }
+
+        int32_t top()
+        {
+            return m_data->keys.empty() ? 0 : bounds()[1];
+        }
+
+        int64_t right()
+        {
+            return m_data->keys.empty() ? 0 : int64_t(bounds()[2]) + 1;
+        }
+
+        int64_t bottom()
+        {
+            return m_data->keys.empty() ? 0 : int64_t(bounds()[3]) + 1;
+        }
+
+        void for_each(std::function<void(int32_t, int32_t, T&)> visitor)
+        {
+            visit(visitor);
+        }
+
+        // same as for_each, but visitor is not wrapped to std::function and can be inlined
+        template <class F>
+        void visit(F&& visitor)
+        {
+            Data& d = own();
+            d.sort();
+            d.visit_range(0, d.keys.size(), visitor);
+        }
+
+        // visits items in parallel: leaves are split into 4^splitDepth continuous chunks
+        // (the same number of tasks QuadTree makes), chunks are visited concurrently
+        // visitor is shared by threads and must be thread safe
+        template <class F>
+        void parallel_for_each(F&& visitor, size_t splitDepth = c_splitDepth)
+        {
+            Data& d = own();
+            d.sort();
+            // pages are copied before tasks start, chunks may share a page
+            d.values.own_all();
+            const size_t chunks = d.chunks_count(splitDepth);
+            parallel_tasks(chunks, [&](size_t chunk)
+            {
+                d.visit_range(d.chunk_begin(chunk, chunks), d.chunk_begin(chunk + 1, chunks), visitor);
+            });
+        }
+
+        // parallel reduction, see QuadTree::parallel_reduce
+        template <class R, class F, class C>
+        R parallel_reduce(const R& identity, F&& visitor, C&& combine, size_t splitDepth = c_splitDepth)
+        {
+            Data& d = own();
+            d.sort();
+            d.values.own_all();
+            const size_t chunks = d.chunks_count(splitDepth);
+            return parallel_reduce_tasks(chunks, identity, [&](size_t chunk, R& accumulator)
+            {
+                d.visit_range(d.chunk_begin(chunk, chunks), d.chunk_begin(chunk + 1, chunks), [&](int32_t x, int32_t y, T& value) {
+                    visitor(x, y, value, accumulator);
+                });
+            }, combine);
+        }
+
+        // visits items inside of the rect [x0, x1) x [y0, y1) in for_each order
+        // only leaves between Morton codes of the rect corners are checked,
+        // runs of leaves outside of the rect are skipped with binary search
+        template <class F>
+        void query(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& visitor)
+        {
+            if (x0 >= x1 || y0 >= y1 || m_data->keys.empty())
+                return;
+            Data& d = own();
+            d.sort();
+
+            const uint64_t minCode = encode(x0, y0);
+            const uint64_t maxCode = encode(x1 - 1, y1 - 1);
+            size_t i = d.lower_bound(0, d.keys.size(), minCode);
+            const size_t end = d.lower_bound(i, d.keys.size(), maxCode + 1);
+            while (i != end)
+            {
+                const int32_t x = decode_x(d.keys[i]);
+                const int32_t y = decode_y(d.keys[i]);
+                if (x0 <= x && x < x1 && y0 <= y && y < y1)
+                {
+                    visitor(x, y, d.values.write(i));
+                    ++i;
+                }
+                else
+                {
+                    i = d.lower_bound(i, end, Morton::next_in_rect(d.keys[i], minCode, maxCode));
+                }
+            }
+        }
+
+        // nearest items, see QuadTree::k_nearest
+        // cells of the implicit quad tree are runs of sorted leaves with the same code prefix,
+        // a run is split to quadrants with binary search, empty quadrants are not queued
+        template <class F>
+        size_t k_nearest(int32_t ix, int32_t iy, size_t k, F&& visitor)
+        {
+            if (!k || m_data->keys.empty())
+                return 0;
+            Data& d = own();
+            d.sort();
+
+            // distances are measured in the space of Morton codes, coordinates are shifted there
+            const int64_t px = static_cast<uint32_t>(ix) ^ 0x80000000;
+            const int64_t py = static_cast<uint32_t>(iy) ^ 0x80000000;
+            typename Nearest::Queue<NearestCell>::type queue;
+            const NearestCell root = {0, d.keys.size(), 0, 32};
+            queue.push(nearest_candidate(d, root, px, py));
+            size_t found = 0;
+            while (!queue.empty() && found < k)
+            {
+                const NearestCell cell = queue.top().cell;
+                queue.pop();
+                if (cell.last - cell.first == 1)
+                {
+                    visitor(decode_x(d.keys[cell.first]), decode_y(d.keys[cell.first]), d.values.write(cell.first));
+                    ++found;
+                    continue;
+                }
+                // runs of quadrants: the first code of the quadrant i is (prefix * 4 + i) << 2 * (level - 1)
+                const unsigned level = cell.level - 1;
+                size_t bounds[5] = {cell.first, 0, 0, 0, cell.last};
+                for (size_t i = 1; i < 4; ++i)
+                    bounds[i] = d.lower_bound(bounds[i - 1], cell.last, (cell.prefix * 4 + i) << (2 * level));
+                for (size_t i = 0; i < 4; ++i)
+                {
+                    if (bounds[i] != bounds[i + 1])
+                    {
+                        const NearestCell quadrant = {bounds[i], bounds[i + 1], cell.prefix * 4 + i, level};
+                        queue.push(nearest_candidate(d, quadrant, px, py));
+                    }
+                }
+            }
+            return found;
+        }
+
+        // the item nearest to (x, y) as visitor(x, y, item), false if the tree is empty
+        template <class F>
+        bool nearest(int32_t ix, int32_t iy, F&& visitor)
+        {
+            return 0 != k_nearest(ix, iy, 1, visitor);
+        }
+
+        // number of items inside of the rect [x0, x1) x [y0, y1)
+        size_t count(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+        {
+            size_t result = 0;
+            query(x0, y0, x1, y1, [&](int32_t, int32_t, T&) {++result;});
+            return result;
+        }
+
+        // forward iterator over leaves in Z order
+        // any insertion or removal invalidates it
+        class iterator
+        {
+        public:
+            typedef std::forward_iterator_tag   iterator_category;
+            typedef T                           value_type;
+            typedef ptrdiff_t                   difference_type;
+            typedef T*                          pointer;
+            typedef T&                          reference;
+
+            iterator() : m_data(nullptr), m_index(0) {}
+
+            T& operator*() const {return m_data->values.write(m_index);}
+            T* operator->() const {return &m_data->values.write(m_index);}
+
+            int32_t x() const {return decode_x(m_data->keys[m_index]);}
+            int32_t y() const {return decode_y(m_data->keys[m_index]);}
+
+            iterator& operator++()
+            {
+                ++m_index;
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator tmp(*this);
+                ++m_index;
+                return tmp;
+            }
+
+            bool operator==(const iterator& other) const {return m_index == other.m_index;}
+            bool operator!=(const iterator& other) const {return m_index != other.m_index;}
+
+        private:
+            friend class LinearQuadTree;
+            iterator(Data* data, size_t index) : m_data(data), m_index(index) {}
+
+            Data*   m_data;
+            size_t  m_index;
+        };
+
+        // restores Z order of leaves if required
+        iterator begin()
+        {
+            Data& d = own();
+            d.sort();
+            return iterator(&d, 0);
+        }
+
+        iterator end() {return iterator(m_data.get(), m_data->keys.size());}
+
+        // read only state of the tree at the moment of snapshot() call
+        // the snapshot may be read and destroyed by any thread while the tree is modified
+        class Snapshot
+        {
+        public:
+            const T* find(int32_t x, int32_t y) const
+            {
+                return m_data->find(encode(x, y));
+            }
+
+            // visits items in for_each order, leaves of the unsorted tree are ordered on the fly
+            template <class F>
+            void visit(F&& visitor) const
+            {
+                const Data& d = *m_data;
+                if (d.sorted)
+                {
+                    for (size_t i = 0; i < d.keys.size(); ++i)
+                        visitor(decode_x(d.keys[i]), decode_y(d.keys[i]), d.values[i]);
+                    return;
+                }
+                for (auto index : d.order())
+                    visitor(decode_x(d.keys[index]), decode_y(d.keys[index]), d.values[index]);
+            }
+
+            bool empty() const {return m_data->keys.empty();}
+            size_t size() const {return m_data->keys.size();}
+
+        private:
+            friend class LinearQuadTree;
+            Snapshot(const std::shared_ptr<const Data>& data) : m_data(data) {}
+
+            std::shared_ptr<const Data> m_data;
+        };
+
+        // O(1): pages are shared until the next modification of the tree
+        Snapshot snapshot()
+        {
+            m_shared = true;
+            return Snapshot(m_data);
+        }
+
+        void clear()
+        {
+            m_data = std::make_shared<Data>();
+            m_shared = false;
+            m_data->reset_table(c_minTableSize);
+        }
+
+        size_t size() const {return m_data->keys.size();}
+
+        // there are leaves only, fill is the load factor of the hash table
+        // pages shared with snapshots are counted as well
+        TreeStats stats() const
+        {
+            const Data& d = *m_data;
+            TreeStats result;
+            result.nodes.assign(1, d.keys.size());
+            result.leaves = d.keys.size();
+            result.bytes  = sizeof(*this) + sizeof(Data) + d.keys.bytes() + d.values.bytes() + d.table.bytes();
+            result.fill   = static_cast<double>(d.keys.size()) / d.table.size();
+            return result;
+        }
+
+    private:
+        static const uint32_t c_empty        = UINT32_MAX;
+        static const size_t   c_minTableSize = 64;
+        static const size_t   c_splitDepth   = 3;
+        static const size_t   c_pageShift    = 8;
+        static const size_t   c_pageSize     = size_t(1) << c_pageShift;
+        static const size_t   c_pageMask     = c_pageSize - 1;
+
+        // array of fixed size pages, a copy of the array shares pages with the original
+        // a shared page is copied on the first write access to it
+        // only the tree copies pointers to pages, so their counts may only drop meanwhile
+        template <class U>
+        class Paged
+        {
+        public:
+            Paged() : m_size(0) {}
+
+            size_t size() const {return m_size;}
+            bool empty() const {return 0 == m_size;}
+            const U& back() const {return (*this)[m_size - 1];}
+
+            const U& operator[](size_t i) const
+            {
+                return m_pages[i >> c_pageShift]->items[i & c_pageMask];
+            }
+
+            U& write(size_t i)
+            {
+                return page(i >> c_pageShift)[i & c_pageMask];
+            }
+
+            // writable items of the page
+            U* page(size_t index)
+            {
+                std::shared_ptr<Page>& p = m_pages[index];
+                if (p.use_count() > 1)
+                    p = std::make_shared<Page>(*p);
+                return p->items;
+            }
+
+            void own_all()
+            {
+                for (size_t i = 0; i < m_pages.size(); ++i)
+                    page(i);
+            }
+
+            // moves the item out of the own page, copies it out of the shared one
+            U take(size_t i)
+            {
+                const std::shared_ptr<Page>& p = m_pages[i >> c_pageShift];
+                if (p.use_count() > 1)
+                    return p->items[i & c_pageMask];
+                return std::move(p->items[i & c_pageMask]);
+            }
+
+            void push_back(U value)
+            {
+                if (0 == (m_size & c_pageMask))
+                    m_pages.push_back(std::make_shared<Page>());
+                write(m_size) = std::move(value);
+                ++m_size;
+            }
+
+            // the slot is reset, removed items don't hold memory
+            void pop_back()
+            {
+                if (0 == (--m_size & c_pageMask))
+                    m_pages.pop_back();
+                else
+                    write(m_size) = U();
+            }
+
+            void assign(size_t size, const U& value)
+            {
+                m_pages.clear();
+                for (size_t i = 0; i < size; i += c_pageSize)
+                {
+                    m_pages.push_back(std::make_shared<Page>());
+                    std::fill(m_pages.back()->items, m_pages.back()->items + c_pageSize, value);
+                }
+                m_size = size;
+            }
+
+            void reserve(size_t size)
+            {
+                m_pages.reserve((size + c_pageMask) >> c_pageShift);
+            }
+
+            size_t bytes() const
+            {
+                return m_pages.capacity() * sizeof(std::shared_ptr<Page>) + m_pages.size() * sizeof(Page);
+            }
+
+        private:
+            struct Page
+            {
+                U   items[c_pageSize];
+            };
+
+            std::vector<std::shared_ptr<Page>>  m_pages;
+            size_t                              m_size;
+        };
+
+        // leaves and their hash table
+        struct Data
+        {
+            Data() : sorted(true), boundsValid(true), shift(64)
+            {
+                bounds[0] = bounds[1] = INT32_MAX;
+                bounds[2] = bounds[3] = INT32_MIN;
+            }
+
+            void extend(int32_t x, int32_t y)
+            {
+                bounds[0] = std::min(bounds[0], x);
+                bounds[1] = std::min(bounds[1], y);
+                bounds[2] = std::max(bounds[2], x);
+                bounds[3] = std::max(bounds[3], y);
+            }
+
+            void update_bounds()
+            {
+                bounds[0] = bounds[1] = INT32_MAX;
+                bounds[2] = bounds[3] = INT32_MIN;
+                for (size_t i = 0; i < keys.size(); ++i)
+                    extend(decode_x(keys[i]), decode_y(keys[i]));
+                boundsValid = true;
+            }
+
+            size_t chunks_count(size_t splitDepth) const
+            {
+                return std::min(keys.size(), size_t(1) << (2 * splitDepth));
+            }
+
+            size_t chunk_begin(size_t chunk, size_t chunks) const
+            {
+                return keys.size() * chunk / chunks;
+            }
+
+            // visits leaves [first, last), a page is checked for sharing once
+            template <class F>
+            void visit_range(size_t first, size_t last, F&& visitor)
+            {
+                while (first < last)
+                {
+                    T* page = values.page(first >> c_pageShift);
+                    const size_t end = std::min(last, (first | c_pageMask) + 1);
+                    for (; first < end; ++first)
+                        visitor(decode_x(keys[first]), decode_y(keys[first]), page[first & c_pageMask]);
+                }
+            }
+
+            // the first sorted key in [first, last) that is not less than key
+            size_t lower_bound(size_t first, size_t last, uint64_t key) const
+            {
+                while (first < last)
+                {
+                    const size_t middle = first + (last - first) / 2;
+                    if (keys[middle] < key)
+                        first = middle + 1;
+                    else
+                        last = middle;
+                }
+                return first;
+            }
+
+            size_t hash(uint64_t key) const
+            {
+                // fibonacci hashing, top bits of the product are well mixed
+                return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> shift);
+            }
+
+            // returns slot of the key or empty slot where the key should be placed
+            size_t lookup(uint64_t key) const
+            {
+                const size_t mask = table.size() - 1;
+                size_t slot = hash(key);
+                while (c_empty != table[slot] && keys[table[slot]] != key)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                return slot;
+            }
+
+            const T* find(uint64_t key) const
+            {
+                const uint32_t index = table[lookup(key)];
+                return (c_empty == index) ? nullptr : &values[index];
+            }
+
+            // backward shift deletion: moves following entries of the probe sequence to the hole
+            void erase_slot(size_t hole)
+            {
+                const size_t mask = table.size() - 1;
+                size_t next = (hole + 1) & mask;
+                while (c_empty != table[next])
+                {
+                    const size_t home = hash(keys[table[next]]);
+                    if (((next - home) & mask) >= ((next - hole) & mask))
+                    {
+                        table.write(hole) = table[next];
+                        hole = next;
+                    }
+                    next = (next + 1) & mask;
+                }
+                table.write(hole) = c_empty;
+            }
+
+            void reset_table(size_t size)
+            {
+                table.assign(size, c_empty);
+                shift = 64;
+                while (size >>= 1) --shift;
+            }
+
+            void rehash(size_t size)
+            {
+                reset_table(size);
+                for (uint32_t i = 0; i < keys.size(); ++i)
+                {
+                    table.write(lookup(keys[i])) = i;
+                }
+            }
+
+            // indices of leaves in Z order
+            std::vector<uint32_t> order() const
+            {
+                std::vector<uint32_t> result(keys.size());
+                for (uint32_t i = 0; i < result.size(); ++i)
+                    result[i] = i;
+                std::sort(result.begin(), result.end(), [&](uint32_t a, uint32_t b) {return keys[a] < keys[b];});
+                return result;
+            }
+
+            // restores Z order of leaves
+            void sort()
+            {
+                if (sorted)
+                    return;
+
+                // new pages are built, so pages of snapshots are never touched
+                Paged<uint64_t> sortedKeys;
+                Paged<T>        sortedValues;
+                sortedKeys.reserve(keys.size());
+                sortedValues.reserve(values.size());
+                for (auto index : order())
+                {
+                    sortedKeys.push_back(keys[index]);
+                    sortedValues.push_back(values.take(index));
+                }
+                std::swap(keys, sortedKeys);
+                std::swap(values, sortedValues);
+
+                rehash(table.size());
+                sorted = true;
+            }
+
+            bool                    sorted;
+            bool                    boundsValid;
+            int32_t                 bounds[4];  // inclusive min x, min y, max x, max y of leaves
+            unsigned int            shift;
+            Paged<uint64_t>         keys;     // Morton codes of leaves
+            Paged<T>                values;   // leaves in the same order as keys
+            Paged<uint32_t>         table;    // hash table: index of the leaf or c_empty
+        };
+
+        // run of leaves [first, last) inside of the square with side 2^level, codes of its leaves start from prefix
+        struct NearestCell
+        {
+            size_t      first;
+            size_t      last;
+            uint64_t    prefix;
+            unsigned    level;
+        };
+
+        // a single leaf is measured exactly, bigger runs by their square
+        static Nearest::Candidate<NearestCell> nearest_candidate(const Data& d, const NearestCell& cell, int64_t px, int64_t py)
+        {
+            const uint64_t code = (cell.last - cell.first == 1) ? d.keys[cell.first] : ((cell.level < 32) ? cell.prefix << (2 * cell.level) : 0);
+            const int64_t  side = (cell.last - cell.first == 1) ? 1 : (int64_t(1) << cell.level);
+            const int64_t  x = Morton::decode_x(code);
+            const int64_t  y = Morton::decode_y(code);
+            const Nearest::Candidate<NearestCell> result = {Nearest::distance(px, py, x, y, x + side - 1, y + side - 1), code, cell};
+            return result;
+        }
+
+        static uint64_t encode(int32_t x, int32_t y)
+        {
+            return Morton::encode_signed(x, y);
+        }
+
+        static int32_t decode_x(uint64_t key)
+        {
+            return Morton::decode_signed_x(key);
+        }
+
+        static int32_t decode_y(uint64_t key)
+        {
+            return Morton::decode_signed_y(key);
+        }
+
+        // bounds are a cache, they are updated in place even if arrays are shared:
+        // snapshots never read them
+        const int32_t* bounds()
+        {
+            if (!m_data->boundsValid)
+                m_data->update_bounds();
+            return m_data->bounds;
+        }
+
+        // copy on write: pointers to pages shared with snapshots are copied before
+        // modification, pages are copied on write access to them
+        Data& own()
+        {
+            if (m_shared)
+            {
+                if (m_data.use_count() > 1)
+                    m_data = std::make_shared<Data>(*m_data);
+                m_shared = false;
+            }
+            return *m_data;
+        }
+
+        std::shared_ptr<Data>   m_data;
+        bool                    m_shared;   // pages may be shared with snapshots
+
+        LinearQuadTree(const LinearQuadTree&);
+        const LinearQuadTree& operator=(const LinearQuadTree);
+    };
+
+    template <class T> const uint32_t LinearQuadTree<T>::c_empty;
+    template <class T> const size_t   LinearQuadTree<T>::c_minTableSize;
+    template <class T> const size_t   LinearQuadTree<T>::c_splitDepth;
+    template <class T> const size_t   LinearQuadTree<T>::c_pageShift;
+    template <class T> const size_t   LinearQuadTree<T>::c_pageSize;
+    template <class T> const size_t   LinearQuadTree<T>::c_pageMask;
+
+}
+// eof
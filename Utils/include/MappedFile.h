@@ -0,0 +1,111 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace Utils
+{
+    // Read only file mapped to memory: pages are loaded by the system on the first access,
+    // so structures stored in the file can be used in place without reading it
+    // the data is page aligned and valid until the file is closed
+    class MappedFile
+    {
+    public:
+        MappedFile() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+            , m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+        {}
+
+        ~MappedFile()
+        {
+            close();
+        }
+
+        // false if the file can't be opened or is empty
+        bool open(const std::string& path)
+        {
+            close();
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER size;
+            if (INVALID_HANDLE_VALUE == m_file || !GetFileSizeEx(m_file, &size) || !size.QuadPart)
+            {
+                close();
+                return false;
+            }
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            m_data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (!m_data)
+            {
+                close();
+                return false;
+            }
+            m_size = static_cast<size_t>(size.QuadPart);
+#else
+            const int file = ::open(path.c_str(), O_RDONLY);
+            if (file < 0)
+                return false;
+            struct stat info;
+            if (fstat(file, &info) || !info.st_size)
+            {
+                ::close(file);
+                return false;
+            }
+            // the mapping keeps the file alive
+            void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            ::close(file);
+            if (MAP_FAILED == data)
+                return false;
+            m_data = data;
+            m_size = static_cast<size_t>(info.st_size);
+#endif
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (m_data)
+                UnmapViewOfFile(m_data);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            if (INVALID_HANDLE_VALUE != m_file)
+                CloseHandle(m_file);
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_data)
+                munmap(m_data, m_size);
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        const void* data() const {return m_data;}
+        size_t size() const {return m_size;}
+
+    private:
+        void*   m_data;
+        size_t  m_size;
+#ifdef _WIN32
+        HANDLE  m_file;
+        HANDLE  m_mapping;
+#endif
+
+        MappedFile(const MappedFile&);
+        const MappedFile& operator=(const MappedFile&);
+    };
+}
+// eof
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+    #include <immintrin.h>
+    #define UTILS_MORTON_BMI2
+#endif
+
+namespace Utils
+{
+    // Morton (Z-order) codes for 2D coordinates: x goes to even bits, y to odd bits
+    // so sorting by code gives the same order as QuadTree traversal
+    // | 0 | 1 |
+    // | 2 | 3 |
+    namespace Morton
+    {
+        const uint64_t c_evenBits = 0x5555555555555555ULL;
+        const uint64_t c_oddBits  = 0xAAAAAAAAAAAAAAAAULL;
+
+        // spread lower 32 bits of value to even bits of the result
+        inline uint64_t spread(uint64_t v)
+        {
+#ifdef UTILS_MORTON_BMI2
+            return _pdep_u64(v, c_evenBits);
+#else
+            v &= 0x00000000FFFFFFFFULL;
+            v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+            v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+            v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+            v = (v | (v << 2))  & 0x3333333333333333ULL;
+            v = (v | (v << 1))  & c_evenBits;
+            return v;
+#endif
+        }
+
+        // inverse of spread: collects even bits of value
+        inline uint32_t compact(uint64_t v)
+        {
+#ifdef UTILS_MORTON_BMI2
+            return static_cast<uint32_t>(_pext_u64(v, c_evenBits));
+#else
+            v &= c_evenBits;
+            v = (v | (v >> 1))  & 0x3333333333333333ULL;
+            v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+            v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+            v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+            v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+            return static_cast<uint32_t>(v);
+#endif
+        }
+
+        inline uint64_t encode(uint32_t x, uint32_t y)
+        {
+            return spread(x) | (spread(y) << 1);
+        }
+
+        inline uint32_t decode_x(uint64_t code)
+        {
+            return compact(code);
+        }
+
+        inline uint32_t decode_y(uint64_t code)
+        {
+            return compact(code >> 1);
+        }
+
+        // codes of signed coordinates: coordinates are shifted by 2^31,
+        // so the order is the same as QuadTree centered on the origin has
+        inline uint64_t encode_signed(int32_t x, int32_t y)
+        {
+            return encode(static_cast<uint32_t>(x) ^ 0x80000000, static_cast<uint32_t>(y) ^ 0x80000000);
+        }
+
+        inline int32_t decode_signed_x(uint64_t code)
+        {
+            return static_cast<int32_t>(decode_x(code) ^ 0x80000000);
+        }
+
+        inline int32_t decode_signed_y(uint64_t code)
+        {
+            return static_cast<int32_t>(decode_y(code) ^ 0x80000000);
+        }
+
+        // BIGMIN of Tropf and Herzog: the smallest code greater than `code` that lies inside
+        // the rectangle with corner codes minCode and maxCode, `code` must be outside of it
+        // and between corners. Used to skip codes outside of the rectangle in range queries
+        inline uint64_t next_in_rect(uint64_t code, uint64_t minCode, uint64_t maxCode)
+        {
+            uint64_t result = maxCode;
+            for (int bit = 63; bit >= 0; --bit)
+            {
+                const uint64_t mask  = uint64_t(1) << bit;
+                // lower bits of the same coordinate as the current bit
+                const uint64_t lower = (mask - 1) & ((bit & 1) ? c_oddBits : c_evenBits);
+                const bool c  = !!(code & mask);
+                const bool lo = !!(minCode & mask);
+                const bool hi = !!(maxCode & mask);
+
+                if (!c && !lo && hi)
+                {
+                    result  = (minCode | mask) & ~lower;    // 1000...
+                    maxCode = (maxCode & ~mask) | lower;    // 0111...
+                }
+                else if (!c && lo && hi)
+                {
+                    return minCode;
+                }
+                else if (c && !lo && !hi)
+                {
+                    return result;
+                }
+                else if (c && !lo && hi)
+                {
+                    minCode = (minCode | mask) & ~lower;
+                }
+            }
+            return result;
+        }
+    }
+}
+// eof
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <functional>
+#include <cstdint>
+
+namespace Utils
+{
+    // helpers of best-first nearest item search: QuadTree::k_nearest, LinearQuadTree::k_nearest
+    namespace Nearest
+    {
+        // squared euclidean distance from the point to the rect [x0, x1] x [y0, y1]
+        // distances beyond 2^32 cells saturate to UINT64_MAX
+        inline uint64_t distance(int64_t x, int64_t y, int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+        {
+            const uint64_t dx = (x < x0) ? x0 - x : ((x > x1) ? x - x1 : 0);
+            const uint64_t dy = (y < y0) ? y0 - y : ((y > y1) ? y - y1 : 0);
+            const uint64_t dx2 = dx * dx;
+            const uint64_t dy2 = dy * dy;
+            return (dx2 > UINT64_MAX - dy2) ? UINT64_MAX : dx2 + dy2;
+        }
+
+        // cell of the search: closer cells go first, cells at the same distance go in Z order
+        // code of a cell is the Morton code of its first corner, so no item of the cell
+        // precedes the cell in Z order and ties are resolved in for_each order
+        template <class Cell>
+        struct Candidate
+        {
+            uint64_t    distance;
+            uint64_t    code;
+            Cell        cell;
+
+            bool operator>(const Candidate& other) const
+            {
+                return distance != other.distance ? distance > other.distance : code > other.code;
+            }
+        };
+
+        template <class Cell>
+        struct Queue
+        {
+            typedef std::priority_queue< Candidate<Cell>, std::vector< Candidate<Cell> >, std::greater< Candidate<Cell> > > type;
+        };
+    }
+}
+// eof
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
+namespace Utils
+{
+    // runs task(i) for every i in [0, count) on up to maxThreads threads (hardware_concurrency if 0)
+    // the calling thread works as well, idle threads take the next task in order
+    // the first exception thrown by tasks is rethrown after all threads are finished
+    template <class Task>
+    void parallel_tasks(size_t count, Task&& task, size_t maxThreads = 0)
+    {
+        if (!maxThreads)
+            maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t threads = std::min(count, maxThreads);
+        if (threads <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                task(i);
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        std::exception_ptr  error;
+        std::mutex          errorLock;
+        auto worker = [&]()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    task(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorLock);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t i = 1; i < threads; ++i)
+            pool.push_back(std::thread(worker));
+        worker();
+        for (auto& thread : pool)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // runs task(i, accumulator) for every i in [0, count) in parallel, every task has its own
+    // copy of identity, then results are combined with combine(result, accumulator) in tasks order
+    template <class R, class Task, class Combine>
+    R parallel_reduce_tasks(size_t count, const R& identity, Task&& task, Combine&& combine, size_t maxThreads = 0)
+    {
+        // wrapped, so std::vector<bool> doesn't pack results of different tasks to the same word
+        struct Result
+        {
+            R value;
+        };
+        const Result init = {identity};
+        std::vector<Result> results(count, init);
+        parallel_tasks(count, [&](size_t i) {task(i, results[i].value);}, maxThreads);
+
+        R result(identity);
+        for (auto& accumulator : results)
+            combine(result, accumulator.value);
+        return result;
+    }
+}
+// eof
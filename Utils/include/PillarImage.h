@@ -0,0 +1,265 @@
+#pragma once
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include "Morton.h"
+#include "RangeList.h"
+
+namespace Utils
+{
+    // Pointer free image of a 2D map of range lists: QuadTree< RangeList<V> >,
+    // LinearQuadTree< RangeList<V> > or their snapshots.
+    // The image is a single block of memory, so it can be written to a file, mapped back
+    // with MappedFile and queried in place, or inflated into a map with a single bulk assign.
+    // Layout (native byte order, every section is 8 bytes aligned):
+    //    Header
+    //    PillarRecord[pillars + 1]   pillars in Z order (Morton code of signed coordinates), the last one is a sentinel
+    //    RangeRecord[ranges + 1]     ranges of pillars one by one, the last one is a sentinel
+    //    T[values]                   items of ranges one by one
+    // T is copied as bytes, items with pointers are converted to T on write and back on inflate
+    // NOTE: only the header and the size of the image are checked on attach
+    template <class T>
+    class PillarImage
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "items of the image are copied as bytes");
+    public:
+        static const uint32_t c_version = 1;
+
+        PillarImage() : m_header(nullptr), m_pillars(nullptr), m_ranges(nullptr), m_values(nullptr) {}
+
+        // writes image of the map, map visits pillars in QuadTree order,
+        // convert(item) makes T from items of pillars
+        template <class Map, class Convert>
+        static void write(std::ostream& out, Map& map, Convert&& convert)
+        {
+            Writer<Convert> writer(convert);
+            map.visit(writer);
+
+            const PillarRecord lastPillar = {UINT64_MAX, writer.ranges.size()};
+            const RangeRecord  lastRange  = {0, writer.values.size()};
+            const Header header = {{'P', 'I', 'L', 'R'}, c_version, sizeof(T), 0, writer.pillars.size(), writer.ranges.size(), writer.values.size()};
+            writer.pillars.push_back(lastPillar);
+            writer.ranges.push_back(lastRange);
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(writer.pillars.data()), writer.pillars.size() * sizeof(PillarRecord));
+            out.write(reinterpret_cast<const char*>(writer.ranges.data()), writer.ranges.size() * sizeof(RangeRecord));
+            out.write(reinterpret_cast<const char*>(writer.values.data()), writer.values.size() * sizeof(T));
+        }
+
+        template <class Map>
+        static void write(std::ostream& out, Map& map)
+        {
+            write(out, map, [](const T& item) {return item;});
+        }
+
+        // attaches image in memory, data must be 8 bytes aligned and alive while the image is used
+        // false if data is not an image of T of the current version
+        bool attach(const void* data, size_t size)
+        {
+            detach();
+            if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % sizeof(uint64_t))
+                return false;
+            const Header* header = static_cast<const Header*>(data);
+            if (memcmp(header->magic, "PILR", 4) || c_version != header->version || sizeof(T) != header->valueSize)
+                return false;
+
+            // counts are limited by the size, so the sum can't overflow
+            const uint64_t available = size - sizeof(Header);
+            if (header->pillars >= available / sizeof(PillarRecord) || header->ranges >= available / sizeof(RangeRecord) ||
+                header->values > available / sizeof(T))
+                return false;
+            const uint64_t expected = (header->pillars + 1) * sizeof(PillarRecord) + (header->ranges + 1) * sizeof(RangeRecord) + header->values * sizeof(T);
+            if (expected != available)
+                return false;
+
+            const char* begin = static_cast<const char*>(data) + sizeof(Header);
+            const PillarRecord* pillars = reinterpret_cast<const PillarRecord*>(begin);
+            const RangeRecord*  ranges  = reinterpret_cast<const RangeRecord*>(pillars + header->pillars + 1);
+            if (pillars[header->pillars].firstRange != header->ranges || ranges[header->ranges].firstValue != header->values)
+                return false;
+
+            m_header  = header;
+            m_pillars = pillars;
+            m_ranges  = ranges;
+            m_values  = reinterpret_cast<const T*>(ranges + header->ranges + 1);
+            return true;
+        }
+
+        void detach()
+        {
+            m_header  = nullptr;
+            m_pillars = nullptr;
+            m_ranges  = nullptr;
+            m_values  = nullptr;
+        }
+
+        bool attached() const {return nullptr != m_header;}
+
+        size_t pillars() const {return m_header ? static_cast<size_t>(m_header->pillars) : 0;}
+        size_t values() const {return m_header ? static_cast<size_t>(m_header->values) : 0;}
+
+        // item at index of pillar (x, y), binary search by the pillar code
+        const T* find(int32_t x, int32_t y, size_t index) const
+        {
+            const PillarRecord* end = m_pillars + pillars();
+            const PillarRecord* pillar = std::lower_bound(m_pillars, end, Morton::encode_signed(x, y), PillarRecord::less);
+            if (pillar == end || pillar->key != Morton::encode_signed(x, y))
+                return nullptr;
+            for (uint64_t r = pillar[0].firstRange; r < pillar[1].firstRange; ++r)
+            {
+                const RangeRecord& range = m_ranges[r];
+                if (range.start <= index && index - range.start < m_ranges[r + 1].firstValue - range.firstValue)
+                    return &m_values[range.firstValue + (index - range.start)];
+            }
+            return nullptr;
+        }
+
+        // visits items as visitor(x, y, index, item) in QuadTree order
+        template <class F>
+        void visit(F&& visitor) const
+        {
+            visit_pillars(m_pillars, m_pillars + pillars(), visitor);
+        }
+
+        // visits items of pillars inside of the rect [x0, x1) x [y0, y1), see LinearQuadTree::query
+        template <class F>
+        void query(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& visitor) const
+        {
+            if (x0 >= x1 || y0 >= y1 || !pillars())
+                return;
+
+            const uint64_t minCode = Morton::encode_signed(x0, y0);
+            const uint64_t maxCode = Morton::encode_signed(x1 - 1, y1 - 1);
+            const PillarRecord* it  = std::lower_bound(m_pillars, m_pillars + pillars(), minCode, PillarRecord::less);
+            const PillarRecord* end = std::upper_bound(it, m_pillars + pillars(), maxCode, PillarRecord::greater);
+            while (it != end)
+            {
+                const int32_t x = Morton::decode_signed_x(it->key);
+                const int32_t y = Morton::decode_signed_y(it->key);
+                if (x0 <= x && x < x1 && y0 <= y && y < y1)
+                {
+                    visit_pillars(it, it + 1, visitor);
+                    ++it;
+                }
+                else
+                {
+                    it = std::lower_bound(it, end, Morton::next_in_rect(it->key, minCode, maxCode), PillarRecord::less);
+                }
+            }
+        }
+
+        // replaces content of the map by the image with a single bulk assign,
+        // convert(item) makes items of map pillars from T
+        template <class Map, class Convert>
+        void inflate(Map& map, Convert&& convert) const
+        {
+            typedef typename Map::Item Item;
+            typedef typename std::decay<decltype(convert(*m_values))>::type Value;
+
+            std::vector<Item> items(pillars());
+            std::vector<Value> buffer;
+            for (size_t p = 0; p < items.size(); ++p)
+            {
+                const PillarRecord& pillar = m_pillars[p];
+                items[p].x = Morton::decode_signed_x(pillar.key);
+                items[p].y = Morton::decode_signed_y(pillar.key);
+                for (uint64_t r = pillar.firstRange; r < m_pillars[p + 1].firstRange; ++r)
+                {
+                    buffer.clear();
+                    for (uint64_t v = m_ranges[r].firstValue; v < m_ranges[r + 1].firstValue; ++v)
+                        buffer.push_back(convert(m_values[v]));
+                    items[p].value.push_range(static_cast<size_t>(m_ranges[r].start), buffer.begin(), buffer.end());
+                }
+            }
+            map.assign(items.begin(), items.end());
+        }
+
+        template <class Map>
+        void inflate(Map& map) const
+        {
+            inflate(map, [](const T& item) {return item;});
+        }
+
+    private:
+        struct Header
+        {
+            char     magic[4];
+            uint32_t version;
+            uint32_t valueSize;     // sizeof(T), images of other items are rejected
+            uint32_t reserved;
+            uint64_t pillars;
+            uint64_t ranges;
+            uint64_t values;
+        };
+
+        struct PillarRecord
+        {
+            uint64_t key;           // Morton code of signed coordinates
+            uint64_t firstRange;    // ranges of the pillar are [firstRange, next pillar firstRange)
+
+            static bool less(const PillarRecord& pillar, uint64_t key) {return pillar.key < key;}
+            static bool greater(uint64_t key, const PillarRecord& pillar) {return key < pillar.key;}
+        };
+
+        struct RangeRecord
+        {
+            uint64_t start;         // index of the first item in the pillar
+            uint64_t firstValue;    // items of the range are [firstValue, next range firstValue)
+        };
+
+        // collects records of pillars visited by the map
+        template <class Convert>
+        struct Writer
+        {
+            Writer(Convert& convert) : convert(convert) {}
+
+            template <class Pillar>
+            void operator()(int32_t x, int32_t y, const Pillar& pillar)
+            {
+                const PillarRecord record = {Morton::encode_signed(x, y), ranges.size()};
+                pillars.push_back(record);
+                pillar.visit_ranges([&](size_t start, const typename Pillar::value_type* items, size_t count)
+                {
+                    const RangeRecord range = {start, values.size()};
+                    ranges.push_back(range);
+                    for (size_t i = 0; i < count; ++i)
+                        values.push_back(convert(items[i]));
+                });
+            }
+
+            Convert&                    convert;
+            std::vector<PillarRecord>   pillars;
+            std::vector<RangeRecord>    ranges;
+            std::vector<T>              values;
+        };
+
+        template <class F>
+        void visit_pillars(const PillarRecord* first, const PillarRecord* last, F& visitor) const
+        {
+            for (const PillarRecord* pillar = first; pillar != last; ++pillar)
+            {
+                const int32_t x = Morton::decode_signed_x(pillar->key);
+                const int32_t y = Morton::decode_signed_y(pillar->key);
+                for (uint64_t r = pillar[0].firstRange; r < pillar[1].firstRange; ++r)
+                {
+                    for (uint64_t v = m_ranges[r].firstValue; v < m_ranges[r + 1].firstValue; ++v)
+                        visitor(x, y, static_cast<size_t>(m_ranges[r].start + (v - m_ranges[r].firstValue)), m_values[v]);
+                }
+            }
+        }
+
+        const Header*       m_header;
+        const PillarRecord* m_pillars;
+        const RangeRecord*  m_ranges;
+        const T*            m_values;
+    };
+
+    template <class T> const uint32_t PillarImage<T>::c_version;
+
+}
+// eof
@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace Utils
+{
+    // Fixed size object pool. Objects are allocated from blocks of c_blockSize
+    // items, released objects are put to the free list and reused by the next
+    // allocation, so memory goes back to the system only when the pool dies.
+    // The pool doesn't track alive objects: owner has to release everything
+    // it allocated before the pool is destroyed.
+    template <class T>
+    class Pool
+    {
+    public:
+        static const size_t c_blockSize = 256;
+
+        Pool() : m_free(nullptr), m_used(0), m_capacity(0) {}
+        ~Pool() {}
+
+        T* allocate()
+        {
+            if (!m_free)
+            {
+                grow();
+            }
+            Slot* slot = m_free;
+            m_free = slot->next;
+            ++m_used;
+            return new (&slot->storage) T();
+        }
+
+        void release(T* object)
+        {
+            object->~T();
+            Slot* slot = reinterpret_cast<Slot*>(object);
+            slot->next = m_free;
+            m_free = slot;
+            --m_used;
+        }
+
+        // preallocate storage for at least count objects with a single block
+        void reserve(size_t count)
+        {
+            if (m_capacity < count)
+            {
+                grow(count - m_capacity);
+            }
+        }
+
+        size_t used() const     {return m_used;}
+        size_t capacity() const {return m_capacity;}
+
+    private:
+        union Slot
+        {
+            Slot* next;
+            typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+        };
+
+        void grow(size_t size = c_blockSize)
+        {
+            std::unique_ptr<Slot[]> block(new Slot[size]);
+            // keep slots in address order, so sequential allocations are adjacent in memory
+            for (size_t i = size; i-- > 0;)
+            {
+                block[i].next = m_free;
+                m_free = &block[i];
+            }
+            m_blocks.push_back(std::move(block));
+            m_capacity += size;
+        }
+
+        std::vector< std::unique_ptr<Slot[]> > m_blocks;
+        Slot*  m_free;
+        size_t m_used;
+        size_t m_capacity;
+
+        Pool(const Pool&);
+        const Pool& operator=(const Pool&);
+    };
+
+    // Pool of raw memory slots of the size set at run time, so objects followed by inline
+    // arrays of different capacities (see WideQuadTree) have a pool per capacity.
+    // Slots are aligned for any fundamental type, the owner constructs and destroys
+    // objects in them and releases every slot before the pool is destroyed, see Pool.
+    class SlotPool
+    {
+    public:
+        static const size_t c_blockBytes = 16384;
+
+        SlotPool() : m_units(1), m_free(nullptr), m_used(0), m_capacity(0) {}
+        ~SlotPool() {}
+
+        // the size is set before the first allocation
+        void set_slot_size(size_t size)
+        {
+            m_units = size > sizeof(Unit) ? (size + sizeof(Unit) - 1) / sizeof(Unit) : 1;
+        }
+
+        void* allocate()
+        {
+            if (!m_free)
+            {
+                grow();
+            }
+            Unit* slot = m_free;
+            m_free = slot->next;
+            ++m_used;
+            return slot;
+        }
+
+        void release(void* slot)
+        {
+            Unit* unit = static_cast<Unit*>(slot);
+            unit->next = m_free;
+            m_free = unit;
+            --m_used;
+        }
+
+        size_t used() const         {return m_used;}
+        size_t capacity() const     {return m_capacity;}
+        size_t slot_size() const    {return m_units * sizeof(Unit);}
+
+    private:
+        union Unit
+        {
+            Unit*       next;
+            long double alignment;
+            long long   integer;
+        };
+
+        void grow()
+        {
+            const size_t slots = c_blockBytes > slot_size() ? c_blockBytes / slot_size() : 1;
+            std::unique_ptr<Unit[]> block(new Unit[slots * m_units]);
+            // keep slots in address order, so sequential allocations are adjacent in memory
+            for (size_t i = slots; i-- > 0;)
+            {
+                Unit* slot = &block[i * m_units];
+                slot->next = m_free;
+                m_free = slot;
+            }
+            m_blocks.push_back(std::move(block));
+            m_capacity += slots;
+        }
+
+        std::vector< std::unique_ptr<Unit[]> > m_blocks;
+        size_t m_units;     // slot size in units
+        Unit*  m_free;
+        size_t m_used;
+        size_t m_capacity;
+
+        SlotPool(const SlotPool&);
+        const SlotPool& operator=(const SlotPool&);
+    };
+}
+// eof
\ No newline at end of file
@@ -2,17 +2,33 @@
 #include <list>
 #include <memory>
 #include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "Pool.h"
+#include "Morton.h"
+#include "Parallel.h"
+#include "Stats.h"
+#include "Nearest.h"
 
 namespace Utils
 {
 // MACRO!?! ugly, yes, but it help me to save about 5% of performance other than
 // encapsulating the code to the function
+// x and y are local (unsigned) coordinates of the item
+// on_node is called for every inner node, x and y are relative to the node there
+// child is the next node: own(child) copies nodes shared with snapshots on the way down
 
-#define _item_at(on_not_found, finalize)                            \
+#define _item_at(on_not_found, finalize, on_node, child)            \
     Node* node      = & m_root;                                     \
-    size_t width    = m_squareSide;                                 \
+    uint64_t width  = m_squareSide;                                 \
     while (width > 1)                                               \
     {                                                               \
+        on_node;                                                    \
         width >>= 1;                                                \
         size_t index = (!!(x & width)) + ((!!(y & width)) << 1);    \
         x &= ~width;                                                \
@@ -21,46 +37,191 @@ namespace Utils
         {                                                           \
             on_not_found;                                           \
         }                                                           \
-        node = node->quadNodes[index].get();                        \
+        node = child;                                               \
     }                                                               \
     finalize;
 
     // This quad tree is highly limited by it's usage
     // it works with square areas, the side is pow2
+    // the area is centered on the origin: [-side/2, side/2) and grows
+    // (or shrinks) on demand, so depth of the tree depends on the occupied extent only
+    // nodes are allocated from the internal pool, removed nodes are returned
+    // to the pool and reused by next insertions
+    // every inner node keeps bounds of its items, so extents of the tree are O(1)
+    // snapshot() is O(1) as well: nodes are reference counted and shared by the tree
+    // and its snapshots, any write copies shared nodes on the path to the item only,
+    // so the memory of a snapshot is proportional to the changes made after it was taken
     template <class T>
     class QuadTree
     {
     public:
-        QuadTree(size_t squareSide) : m_squareSide(squareSide) , m_treeDepth(1)
+        // squareSide is the initial (and the minimal) side of the tree
+        QuadTree(size_t squareSide = 2)
+            : m_treeDepth(1)
+            , m_squareSide(2)
+            , m_storage(std::make_shared<Storage>())
+            , m_pool(m_storage->pool)
+            , m_snapshots(0)
         {
-            size_t depth = squareSide;
-            while (depth>>= 1) ++m_treeDepth;
+            while (m_squareSide < squareSide)
+            {
+                m_squareSide <<= 1;
+                ++m_treeDepth;
+            }
+            m_minSide = m_squareSide;
+        }
+
+        ~QuadTree()
+        {
+            // nodes shared with alive snapshots are released by the last of them
+            std::lock_guard<std::mutex> lock(m_storage->lock);
+            m_storage->owned = false;
+            for (auto root : m_storage->retired)
+                unref(root, m_pool);
+            m_storage->retired.clear();
+            release_nodes();
+        }
+
+        // item of bulk loading
+        struct Item
+        {
+            int32_t x;
+            int32_t y;
+            T       value;
+        };
+
+        // replaces content of the tree by items [first, last), items are Item or anything with x, y and value
+        // the tree is built bottom-up in a single pass with the node storage reserved for all nodes,
+        // items sorted in for_each (Morton) order are loaded in linear time, other orders are sorted first
+        // the last of repeated items wins
+        template <class Iterator>
+        void assign(Iterator first, Iterator last)
+        {
+            clear();
+            if (first == last)
+                return;
+
+            // fit the area to items
+            int32_t left = INT32_MAX, top = INT32_MAX, right = INT32_MIN, bottom = INT32_MIN;
+            std::vector<Iterator> items;
+            for (Iterator it = first; it != last; ++it)
+            {
+                items.push_back(it);
+                left   = std::min<int32_t>(left, it->x);
+                top    = std::min<int32_t>(top, it->y);
+                right  = std::max<int32_t>(right, it->x);
+                bottom = std::max<int32_t>(bottom, it->y);
+            }
+            uint64_t x, y;
+            while (!to_local(left, top, x, y) || !to_local(right, bottom, x, y))
+            {
+                m_squareSide <<= 1;
+                ++m_treeDepth;
+            }
+
+            std::vector<uint64_t> keys(items.size());
+            for (size_t i = 0; i < items.size(); ++i)
+            {
+                to_local(items[i]->x, items[i]->y, x, y);
+                keys[i] = Morton::encode(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+            }
+            std::vector<size_t> order(items.size());
+            for (size_t i = 0; i < order.size(); ++i)
+                order[i] = i;
+            if (!std::is_sorted(keys.begin(), keys.end()))
+                std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {return keys[a] < keys[b];});
+
+            // every item adds nodes below the level its path diverges from the previous one
+            const size_t depth = m_treeDepth;
+            size_t nodes = depth;
+            for (size_t i = 1; i < order.size(); ++i)
+                nodes += depth - diverge_level(keys[order[i - 1]], keys[order[i]]);
+            m_pool.reserve(m_pool.used() + nodes);
+
+            Node* path[c_maxDepth + 1];
+            path[0] = &m_root;
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                const uint64_t key = keys[order[i]];
+                size_t level = 0;
+                if (i)
+                {
+                    level = diverge_level(keys[order[i - 1]], key);
+                    // nodes of the previous path below the divergence are complete
+                    for (size_t l = depth; --l > level;)
+                        update_bounds(path[l], m_squareSide >> l);
+                }
+                for (; level < depth; ++level)
+                {
+                    const size_t index = (key >> (2 * (depth - 1 - level))) & 3;
+                    path[level + 1] = m_pool.allocate();
+                    path[level]->quadNodes[index] = path[level + 1];
+                }
+                path[depth]->value = items[order[i]]->value;
+            }
+            for (size_t l = depth; l-- > 0;)
+                update_bounds(path[l], m_squareSide >> l);
+        }
+
+        void insert(int32_t ix, int32_t iy, T value)
+        {
+            release_retired();
+            uint64_t x, y;
+            grow_to(ix, iy, x, y);
+            _item_at(node->quadNodes[index] = m_pool.allocate(), node->value = value, node->extend(x, y), own(node->quadNodes[index]));
         }
 
-        void insert(size_t x, size_t y, T value)
+        T* get_item_at(int32_t ix, int32_t iy)
         {
-            _item_at(node->quadNodes[index].reset(new Node()), node->value = value);
+            uint64_t x, y;
+            if (!to_local(ix, iy, x, y))
+                return nullptr;
+            // nothing to copy without snapshots
+            if (!m_snapshots)
+            {
+                _item_at(return nullptr, return &node->value, , node->quadNodes[index]);
+            }
+            // a miss doesn't copy nodes shared with snapshots
+            if (!lookup(&m_root, m_squareSide, ix, iy))
+                return nullptr;
+            _item_at(return nullptr, return &node->value, , own(node->quadNodes[index]));
         }
 
-        T* get_item_at(size_t x, size_t y)
+        // read only lookup, nodes are never copied, so it's safe to call it concurrently
+        const T* find(int32_t ix, int32_t iy) const
         {
-            _item_at(return nullptr, return &node->value);
+            return lookup(&m_root, m_squareSide, ix, iy);
         }
 
-        T& item(size_t x, size_t y)
+        T& item(int32_t ix, int32_t iy)
         {
-            _item_at(node->quadNodes[index].reset(new Node()), return node->value);
+            release_retired();
+            uint64_t x, y;
+            grow_to(ix, iy, x, y);
+            _item_at(node->quadNodes[index] = m_pool.allocate(), return node->value, node->extend(x, y), own(node->quadNodes[index]));
         }
 
-        void remove(size_t x, size_t y)
+        void remove(int32_t ix, int32_t iy)
         {
+            release_retired();
+            uint64_t x, y;
+            if (!to_local(ix, iy, x, y))
+                return;
+
             Node* node      = & m_root;
-            size_t width    = m_squareSide;
+            uint64_t width  = m_squareSide;
             Node* lastFull  = & m_root;
+            size_t lastFullLevel  = 0;
             size_t targetIndex    = (!!(x & (m_squareSide >> 1))) + ((!!(y & (m_squareSide >> 1))) << 1);
+            Node* path[c_maxDepth];
+            uint64_t pathX[c_maxDepth], pathY[c_maxDepth]; // the item relative to path nodes
+            size_t level = 0;
 
             while (width > 1)
             {
+                path[level]  = node;
+                pathX[level] = x;
+                pathY[level] = y;
                 width >>= 1;
 
                 // !!(A) convert any non-null number to 1
@@ -76,135 +237,784 @@ namespace Utils
                 if (((!!node->quadNodes[0]) + (!!node->quadNodes[1]) + (!!node->quadNodes[2]) + (!!node->quadNodes[3])) > 1)
                 {
                     lastFull = node;
+                    lastFullLevel = level;
                     targetIndex = index;
                 }
-                node = node->quadNodes[index].get();
-                
+                node = own(node->quadNodes[index]);
+                ++level;
+            }
+            unref(lastFull->quadNodes[targetIndex], m_pool);
+            lastFull->quadNodes[targetIndex] = nullptr;
+
+            // nodes below lastFull are released, bounds of the rest of the path are shrunk
+            // bounds can't change if the item wasn't on the border of the node, neither of its parents
+            for (level = lastFullLevel + 1; level-- > 0 && path[level]->on_border(pathX[level], pathY[level]);)
+            {
+                update_bounds(path[level], m_squareSide >> level);
             }
-            lastFull->quadNodes[targetIndex].reset();
+            shrink();
+        }
+
+        // bounding rect of items: [left, right) x [top, bottom)
+        // right and bottom are wider than coordinates, so the item at INT32_MAX is inside
+        // all bounds are 0 for the empty tree
+        int32_t left() const
+        {
+            return empty() ? 0 : to_global(m_root.bounds[0]);
+        }
+
+        int32_t top() const
+        {
+            return empty() ? 0 : to_global(m_root.bounds[1]);
+        }
+
+        int64_t right() const
+        {
+            return empty() ? 0 : int64_t(to_global(m_root.bounds[2])) + 1;
+        }
+
+        int64_t bottom() const
+        {
+            return empty() ? 0 : int64_t(to_global(m_root.bounds[3])) + 1;
+        }
+
+        void for_each(std::function<void(int32_t, int32_t, T&)> visitor)
+        {
+            visit(visitor);
         }
 
-        size_t left()
+        // same as for_each, but visitor is not wrapped to std::function and can be inlined
+        template <class F>
+        void visit(F&& visitor)
         {
-            const size_t idxOrder[]   = {0, 2, 1, 3};
-            size_t current = m_squareSide;
-            return scan_nodes_lt(idxOrder, idxOrder + 2, &m_root, 0, m_squareSide, current);
+            _visit(&m_root, 0, 0, m_squareSide, visitor);
         }
 
-        size_t top()
+        // visits items inside of the rect [x0, x1) x [y0, y1) in for_each order
+        // subtrees outside of the rect are skipped, subtrees inside of it are visited without checks
+        template <class F>
+        void query(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& visitor)
         {
-            const size_t primaryCheck[]   = {0, 1};
-            const size_t secondaryCheck[] = {2, 3};
-            size_t current = m_squareSide;
-            return scan_nodes_lt(primaryCheck, secondaryCheck, &m_root, 0, m_squareSide, current);
+            uint64_t rect[4];
+            if (to_local_rect(x0, y0, x1, y1, rect))
+                _query(&m_root, 0, 0, m_squareSide, rect, visitor);
         }
 
-        size_t right()
+        // number of items inside of the rect [x0, x1) x [y0, y1)
+        size_t count(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
         {
-            const size_t primaryCheck[]   = {1, 3};
-            const size_t secondaryCheck[] = {0, 2};
-            size_t current = 0;
-            return scan_nodes_rb(primaryCheck, secondaryCheck, &m_root, m_squareSide, m_squareSide, current);
+            size_t result = 0;
+            query(x0, y0, x1, y1, [&](int32_t, int32_t, T&) {++result;});
+            return result;
         }
 
-        size_t bottom()
+        // visits up to k items nearest to (x, y) as visitor(x, y, item) in order of the distance,
+        // items at the same distance are visited in for_each order, returns number of visited items
+        // best-first search: subtrees are taken from the priority queue by the distance to their bounds,
+        // so empty quadrants and subtrees farther than the k-th item are never opened
+        template <class F>
+        size_t k_nearest(int32_t ix, int32_t iy, size_t k, F&& visitor)
         {
-            const size_t primaryCheck[]   = {2, 3};
-            const size_t secondaryCheck[] = {0, 1};
-            size_t current = 0;
-            return scan_nodes_rb(primaryCheck, secondaryCheck, &m_root, m_squareSide, m_squareSide, current);
+            if (!k || empty())
+                return 0;
+
+            const int64_t half = m_squareSide >> 1;
+            const int64_t px = int64_t(ix) + half;
+            const int64_t py = int64_t(iy) + half;
+            typename Nearest::Queue<NearestCell>::type queue;
+            queue.push(nearest_candidate(&m_root, 0, 0, m_squareSide, px, py));
+            size_t found = 0;
+            while (!queue.empty() && found < k)
+            {
+                const NearestCell cell = queue.top().cell;
+                queue.pop();
+                if (cell.w == 1)
+                {
+                    // nothing to copy without snapshots, otherwise the path to the item is copied
+                    const int32_t x = to_global(cell.x), y = to_global(cell.y);
+                    visitor(x, y, m_snapshots ? *get_item_at(x, y) : const_cast<Node*>(cell.node)->value);
+                    ++found;
+                    continue;
+                }
+                const uint64_t w = cell.w >> 1;
+                for (size_t i = 0; i < 4; ++i)
+                {
+                    if (cell.node->quadNodes[i])
+                        queue.push(nearest_candidate(cell.node->quadNodes[i], (i & 1) ? cell.x + w : cell.x, (i & 2) ? cell.y + w : cell.y, w, px, py));
+                }
+            }
+            return found;
         }
 
-        void for_each(std::function<void(size_t, size_t, T&)> visitor)
+        // the item nearest to (x, y) as visitor(x, y, item), false if the tree is empty
+        template <class F>
+        bool nearest(int32_t ix, int32_t iy, F&& visitor)
         {
-            _foreach(&m_root, 0, 0, m_squareSide, visitor);
+            return 0 != k_nearest(ix, iy, 1, visitor);
+        }
+
+        // visits items in parallel: the tree is split into subtrees at splitDepth
+        // and subtrees are visited concurrently, items of a subtree are visited in for_each order
+        // visitor is shared by threads and must be thread safe
+        template <class F>
+        void parallel_for_each(F&& visitor, size_t splitDepth = c_splitDepth)
+        {
+            std::vector<Task> tasks;
+            collect_tasks(&m_root, 0, 0, m_squareSide, splitDepth, tasks);
+            parallel_tasks(tasks.size(), [&](size_t i)
+            {
+                _visit(tasks[i].node, tasks[i].x, tasks[i].y, tasks[i].w, visitor);
+            });
+        }
+
+        // parallel reduction: every subtree accumulates items to its own copy of identity
+        // with visitor(x, y, item, accumulator), then results of subtrees are combined
+        // in for_each order with combine(result, accumulator), so the result is deterministic
+        template <class R, class F, class C>
+        R parallel_reduce(const R& identity, F&& visitor, C&& combine, size_t splitDepth = c_splitDepth)
+        {
+            std::vector<Task> tasks;
+            collect_tasks(&m_root, 0, 0, m_squareSide, splitDepth, tasks);
+            return parallel_reduce_tasks(tasks.size(), identity, [&](size_t i, R& accumulator)
+            {
+                auto v = [&](int32_t x, int32_t y, T& item) {visitor(x, y, item, accumulator);};
+                _visit(tasks[i].node, tasks[i].x, tasks[i].y, tasks[i].w, v);
+            }, combine);
         }
 
         void clear()
         {
-            for (size_t i =0; i < 4; ++i)
+            release_retired();
+            release_nodes();
+        }
+
+        bool empty() const
+        {
+            return !(m_root.quadNodes[0] || m_root.quadNodes[1] || m_root.quadNodes[2] || m_root.quadNodes[3]);
+        }
+
+        // current side of the tree area
+        uint64_t side() const {return m_squareSide;}
+
+        // nodes per level of the tree, nodes shared with snapshots are counted as well
+        // bytes include the whole node pool, free nodes too
+        TreeStats stats() const
+        {
+            TreeStats result;
+            result.nodes.assign(m_treeDepth + 1, 0);
+            count_nodes(&m_root, 0, result.nodes);
+            result.leaves = result.nodes.back();
+            result.bytes  = sizeof(*this) + sizeof(Storage) + m_pool.capacity() * sizeof(Node);
+
+            // every node except the root is a child of an inner node
+            size_t inner = 0, children = 0;
+            for (size_t level = 0; level < m_treeDepth; ++level)
             {
-                m_root.quadNodes[i].reset();
+                inner    += result.nodes[level];
+                children += result.nodes[level + 1];
             }
+            result.fill = children / (4.0 * inner);
+            return result;
         }
+
     private:
 
         struct Node
         {
             // | 0 | 1 |
             // | 2 | 3 |
-            std::unique_ptr<Node> quadNodes[4];
+            Node* quadNodes[4];
+            // number of trees and snapshots sharing the node, only the tree modifies it
+            uint32_t refs;
             T value;
+            // inner nodes only: min x, min y, max x, max y of items relative to the node
+            uint32_t bounds[4];
+
+            Node() : refs(1)
+            {
+                quadNodes[0] = quadNodes[1] = quadNodes[2] = quadNodes[3] = nullptr;
+                reset_bounds();
+            }
+
+            void reset_bounds()
+            {
+                bounds[0] = bounds[1] = UINT32_MAX;
+                bounds[2] = bounds[3] = 0;
+            }
+
+            bool on_border(uint64_t x, uint64_t y) const
+            {
+                return x == bounds[0] || y == bounds[1] || x == bounds[2] || y == bounds[3];
+            }
+
+            void extend(uint64_t x, uint64_t y)
+            {
+                bounds[0] = std::min(bounds[0], static_cast<uint32_t>(x));
+                bounds[1] = std::min(bounds[1], static_cast<uint32_t>(y));
+                bounds[2] = std::max(bounds[2], static_cast<uint32_t>(x));
+                bounds[3] = std::max(bounds[3], static_cast<uint32_t>(y));
+            }
+        };
+
+        // side of the tree doesn't exceed 2^32, so the path from the root to an item is limited
+        static const size_t c_maxDepth = 33;
+
+        // up to 64 subtrees for parallel traversal
+        static const size_t c_splitDepth = 3;
+
+        // node storage shared by the tree and its snapshots
+        struct Storage
+        {
+            Storage() : hasRetired(false), owned(true) {}
+
+            Pool<Node>          pool;
+            std::mutex          lock;
+            std::vector<Node*>  retired;    // roots of released snapshots, the tree unrefs them on the next write
+            std::atomic<bool>   hasRetired;
+            bool                owned;      // false when the tree is destroyed, snapshots release nodes themselves
+        };
+
+        // subtree of the nearest search
+        struct NearestCell
+        {
+            const Node* node;
+            uint64_t    x;
+            uint64_t    y;
+            uint64_t    w;
+        };
+
+        // subtree visited by a single thread
+        struct Task
+        {
+            Node*    node;
+            uint64_t x;
+            uint64_t y;
+            uint64_t w;
+        };
+
+    public:
+        // forward iterator, visits items in the same order as for_each does
+        // the iterator keeps the path from the root to the current item,
+        // any insertion or removal invalidates it
+        class iterator
+        {
+        public:
+            typedef std::forward_iterator_tag   iterator_category;
+            typedef T                           value_type;
+            typedef ptrdiff_t                   difference_type;
+            typedef T*                          pointer;
+            typedef T&                          reference;
+
+            iterator() : m_tree(nullptr), m_x(0), m_y(0) {m_path[0] = nullptr;}
+
+            T& operator*() const {return leaf()->value;}
+            T* operator->() const {return &leaf()->value;}
+
+            int32_t x() const {return m_tree->to_global(m_x);}
+            int32_t y() const {return m_tree->to_global(m_y);}
+
+            iterator& operator++()
+            {
+                next();
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator tmp(*this);
+                next();
+                return tmp;
+            }
+
+            bool operator==(const iterator& other) const {return leaf() == other.leaf();}
+            bool operator!=(const iterator& other) const {return leaf() != other.leaf();}
+
+        private:
+            friend class QuadTree;
+
+            iterator(QuadTree* tree) : m_tree(tree), m_x(0), m_y(0)
+            {
+                m_path[0] = &tree->m_root;
+                m_path[m_tree->m_treeDepth] = nullptr;
+                if (!tree->empty())
+                    descend(0);
+            }
+
+            Node* leaf() const {return m_tree ? m_path[m_tree->m_treeDepth] : nullptr;}
+
+            // selects child of path[level] and sets its bit to the local coordinates
+            void select(size_t level, size_t index)
+            {
+                const uint64_t width = m_tree->m_squareSide >> (level + 1);
+                m_index[level] = static_cast<uint8_t>(index);
+                m_path[level + 1] = m_tree->own(m_path[level]->quadNodes[index]);
+                m_x = (m_x & ~width) | ((index & 1) ? width : 0);
+                m_y = (m_y & ~width) | ((index & 2) ? width : 0);
+            }
+
+            // goes to the first item of path[level] subtree, every non root node has items
+            void descend(size_t level)
+            {
+                for (; level < m_tree->m_treeDepth; ++level)
+                {
+                    size_t index = 0;
+                    while (!m_path[level]->quadNodes[index]) ++index;
+                    select(level, index);
+                }
+            }
+
+            void next()
+            {
+                for (size_t level = m_tree->m_treeDepth; level-- > 0;)
+                {
+                    const Node* node = m_path[level];
+                    for (size_t index = m_index[level] + 1; index < 4; ++index)
+                    {
+                        if (node->quadNodes[index])
+                        {
+                            select(level, index);
+                            descend(level + 1);
+                            return;
+                        }
+                    }
+                }
+                m_path[m_tree->m_treeDepth] = nullptr;
+            }
+
+            QuadTree*       m_tree;
+            Node*           m_path[c_maxDepth + 1];
+            uint8_t         m_index[c_maxDepth];
+            uint64_t        m_x;
+            uint64_t        m_y;
+        };
+
+        iterator begin() {return iterator(this);}
+        iterator end() {return iterator();}
+
+        // read only state of the tree at the moment of snapshot() call
+        // the snapshot may be read and destroyed by any thread while the tree is modified,
+        // but a single snapshot is not synchronized: it's read by one thread at a time
+        class Snapshot
+        {
+        public:
+            Snapshot(Snapshot&& other)
+                : m_storage(std::move(other.m_storage))
+                , m_root(other.m_root)
+                , m_squareSide(other.m_squareSide)
+            {
+                other.m_root = nullptr;
+            }
+
+            Snapshot& operator=(Snapshot&& other)
+            {
+                if (this != &other)
+                {
+                    release();
+                    m_storage       = std::move(other.m_storage);
+                    m_root          = other.m_root;
+                    m_squareSide    = other.m_squareSide;
+                    other.m_root    = nullptr;
+                }
+                return *this;
+            }
+
+            ~Snapshot()
+            {
+                release();
+            }
+
+            const T* find(int32_t x, int32_t y) const
+            {
+                return lookup(m_root, m_squareSide, x, y);
+            }
+
+            // visits items in for_each order
+            template <class F>
+            void visit(F&& visitor) const
+            {
+                _read(m_root, 0, 0, m_squareSide, m_squareSide, visitor);
+            }
+
+            // bounding rect of items, see QuadTree::left()
+            int32_t left() const    {return empty() ? 0 : to_global(m_root->bounds[0], m_squareSide);}
+            int32_t top() const     {return empty() ? 0 : to_global(m_root->bounds[1], m_squareSide);}
+            int64_t right() const   {return empty() ? 0 : int64_t(to_global(m_root->bounds[2], m_squareSide)) + 1;}
+            int64_t bottom() const  {return empty() ? 0 : int64_t(to_global(m_root->bounds[3], m_squareSide)) + 1;}
+
+            bool empty() const
+            {
+                return !(m_root->quadNodes[0] || m_root->quadNodes[1] || m_root->quadNodes[2] || m_root->quadNodes[3]);
+            }
+
+        private:
+            friend class QuadTree;
+
+            Snapshot(const std::shared_ptr<Storage>& storage, Node* root, uint64_t squareSide)
+                : m_storage(storage), m_root(root), m_squareSide(squareSide) {}
+
+            // the tree unrefs nodes of the snapshot on its next write, nobody else modifies nodes
+            void release()
+            {
+                if (!m_root)
+                    return;
+                std::lock_guard<std::mutex> lock(m_storage->lock);
+                if (m_storage->owned)
+                {
+                    m_storage->retired.push_back(m_root);
+                    m_storage->hasRetired = true;
+                }
+                else
+                    unref(m_root, m_storage->pool);
+                m_root = nullptr;
+            }
+
+            std::shared_ptr<Storage>    m_storage;
+            Node*                       m_root;     // copy of the tree root
+            uint64_t                    m_squareSide;
+
+            Snapshot(const Snapshot&);
+            const Snapshot& operator=(const Snapshot&);
         };
 
-        size_t m_treeDepth;
-        size_t m_squareSide;
-        Node   m_root;
+        // O(1): copies the root only, the rest of nodes are shared with the tree
+        Snapshot snapshot()
+        {
+            release_retired();
+            Node* root = m_pool.allocate();
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if ((root->quadNodes[i] = m_root.quadNodes[i]) != nullptr)
+                    ++root->quadNodes[i]->refs;
+                root->bounds[i] = m_root.bounds[i];
+            }
+            ++m_snapshots;
+            return Snapshot(m_storage, root, m_squareSide);
+        }
+
+    private:
+
+        size_t                      m_treeDepth;
+        uint64_t                    m_squareSide;
+        uint64_t                    m_minSide;
+        Node                        m_root;         // the root is never shared, snapshots copy it
+        std::shared_ptr<Storage>    m_storage;
+        Pool<Node>&                 m_pool;
+        size_t                      m_snapshots;    // not released yet, nodes aren't shared if there are none
 
         QuadTree(const QuadTree&);
         const QuadTree& operator=(const QuadTree);
-        size_t scan_nodes_lt(const size_t* pi, const size_t* si, const Node* n, size_t lt, size_t w, size_t &current)
+
+        // converts coordinates to the local space of the tree [0, side)
+        static bool to_local(int32_t ix, int32_t iy, uint64_t side, uint64_t& x, uint64_t& y)
         {
-            w >>= 1;
-            size_t retval = lt;
-            if (w)
+            const int64_t half = side >> 1;
+            if (ix < -half || ix >= half || iy < -half || iy >= half)
+                return false;
+            x = static_cast<uint64_t>(ix + half);
+            y = static_cast<uint64_t>(iy + half);
+            return true;
+        }
+
+        bool to_local(int32_t ix, int32_t iy, uint64_t& x, uint64_t& y) const
+        {
+            return to_local(ix, iy, m_squareSide, x, y);
+        }
+
+        // clamps the rect to the tree area: {x0, y0, x1, y1} in local space, false if nothing is left
+        bool to_local_rect(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint64_t* rect) const
+        {
+            const int64_t half = m_squareSide >> 1;
+            const int64_t left   = std::max<int64_t>(x0, -half) + half;
+            const int64_t top    = std::max<int64_t>(y0, -half) + half;
+            const int64_t right  = std::min<int64_t>(x1, half) + half;
+            const int64_t bottom = std::min<int64_t>(y1, half) + half;
+            if (left >= right || top >= bottom)
+                return false;
+            rect[0] = left; rect[1] = top; rect[2] = right; rect[3] = bottom;
+            return true;
+        }
+
+        static int32_t to_global(uint64_t local, uint64_t side)
+        {
+            return static_cast<int32_t>(static_cast<int64_t>(local) - static_cast<int64_t>(side >> 1));
+        }
+
+        int32_t to_global(uint64_t local) const
+        {
+            return to_global(local, m_squareSide);
+        }
+
+        // doubles the area until item fits to it
+        // every child of the root becomes the inner grandchild of the new root:
+        // | 0 | 1 |    | .   . | .   . |
+        // | 2 | 3 | -> | .   0 | 1   . |
+        //              | .   2 | 3   . |
+        //              | .   . | .   . |
+        void grow_to(int32_t ix, int32_t iy, uint64_t& x, uint64_t& y)
+        {
+            while (!to_local(ix, iy, x, y))
             {
-                if ((n->quadNodes[ pi[0] ] || n->quadNodes[ pi[1] ]) && lt <= current)
+                for (size_t i = 0; i < 4; ++i)
                 {
-                    if (n->quadNodes[ pi[0] ]) retval = scan_nodes_lt(pi, si, n->quadNodes[ pi[0] ].get(), lt, w, current);
-                    if (n->quadNodes[ pi[1] ]) retval = scan_nodes_lt(pi, si, n->quadNodes[ pi[1] ].get(), lt, w, current);
+                    if (m_root.quadNodes[i])
+                    {
+                        Node* node = m_pool.allocate();
+                        node->quadNodes[3 - i] = m_root.quadNodes[i];
+                        m_root.quadNodes[i] = node;
+                        update_bounds(node, m_squareSide);
+                    }
                 }
-                else if ((n->quadNodes[ si[0] ] || n->quadNodes[ si[1] ]) && (lt + w) <= current)
+                m_squareSide <<= 1;
+                ++m_treeDepth;
+                update_bounds(&m_root, m_squareSide);
+            }
+        }
+
+        // inverse of grow_to: halves the area while all items are in its central part
+        void shrink()
+        {
+            while (m_squareSide > m_minSide)
+            {
+                for (size_t i = 0; i < 4; ++i)
+                {
+                    const Node* node = m_root.quadNodes[i];
+                    if (node && ((node->quadNodes[0] && i != 3) || (node->quadNodes[1] && i != 2) ||
+                                 (node->quadNodes[2] && i != 1) || (node->quadNodes[3] && i != 0)))
+                        return;
+                }
+                for (size_t i = 0; i < 4; ++i)
                 {
-                    lt += w;
-                    if (n->quadNodes[ si[0] ]) retval = scan_nodes_lt(pi, si, n->quadNodes[ si[0] ].get(), lt, w, current);
-                    if (n->quadNodes[ si[1] ]) retval = scan_nodes_lt(pi, si, n->quadNodes[ si[1] ].get(), lt, w, current);
+                    if (Node* node = m_root.quadNodes[i])
+                    {
+                        // the node may be shared with snapshots, so the grandchild is referenced before it goes
+                        Node* inner = node->quadNodes[3 - i];
+                        ++inner->refs;
+                        unref(node, m_pool);
+                        m_root.quadNodes[i] = inner;
+                    }
                 }
+                m_squareSide >>= 1;
+                --m_treeDepth;
+                update_bounds(&m_root, m_squareSide);
             }
-            current = (retval < current) ? retval : current;
-            return current;
         }
 
-        size_t scan_nodes_rb(const size_t* pi, const size_t* si, const Node* n, size_t rb, size_t w, size_t &current)
+        // the first level where paths of two Morton codes go to different children,
+        // the tree depth if codes are the same
+        size_t diverge_level(uint64_t a, uint64_t b) const
         {
-            w >>= 1;
-            size_t retval = rb;
-            if (w)
+            size_t level = 0;
+            while (level < m_treeDepth && !((a ^ b) >> (2 * (m_treeDepth - 1 - level))))
+                ++level;
+            return level;
+        }
+
+        // recalculates bounds of the node with side w from its children
+        void update_bounds(Node* n, uint64_t w)
+        {
+            const uint64_t half = w >> 1;
+            n->reset_bounds();
+            for (size_t i = 0; i < 4; ++i)
             {
-                if ((n->quadNodes[ pi[0] ] || n->quadNodes[ pi[1] ]) && (rb + 1) >= current)
+                const Node* child = n->quadNodes[i];
+                if (!child)
+                    continue;
+                const uint64_t x = (i & 1) ? half : 0;
+                const uint64_t y = (i & 2) ? half : 0;
+                if (half > 1)
                 {
-                    if (n->quadNodes[ pi[0] ]) retval = scan_nodes_rb(pi, si, n->quadNodes[ pi[0] ].get(), rb, w, current);
-                    if (n->quadNodes[ pi[1] ]) retval = scan_nodes_rb(pi, si, n->quadNodes[ pi[1] ].get(), rb, w, current);
+                    n->extend(x + child->bounds[0], y + child->bounds[1]);
+                    n->extend(x + child->bounds[2], y + child->bounds[3]);
                 }
-                else if ((n->quadNodes[ si[0] ] || n->quadNodes[ si[1] ]) && (rb + w + 1) >= current)
+                else
+                    n->extend(x, y);
+            }
+        }
+
+        // drops a reference to the node, the last one returns node and its children to the pool
+        static void unref(Node* n, Pool<Node>& pool)
+        {
+            if (--n->refs)
+                return;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (n->quadNodes[i])
+                    unref(n->quadNodes[i], pool);
+            }
+            pool.release(n);
+        }
+
+        // path copying: the child is copied before it's modified, if snapshots share it
+        Node* own(Node*& child)
+        {
+            if (m_snapshots && child->refs > 1)
+                child = clone(child);
+            return child;
+        }
+
+        Node* clone(Node* n)
+        {
+            Node* copy;
+            {
+                // parallel traversals copy nodes of different subtrees concurrently
+                std::lock_guard<std::mutex> lock(m_storage->lock);
+                copy = m_pool.allocate();
+            }
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if ((copy->quadNodes[i] = n->quadNodes[i]) != nullptr)
+                    ++copy->quadNodes[i]->refs;
+                copy->bounds[i] = n->bounds[i];
+            }
+            copy->value = n->value;
+            --n->refs;
+            return copy;
+        }
+
+        // unrefs nodes of snapshots released since the last write
+        void release_retired()
+        {
+            if (!m_storage->hasRetired)
+                return;
+            std::vector<Node*> retired;
+            {
+                std::lock_guard<std::mutex> lock(m_storage->lock);
+                retired.swap(m_storage->retired);
+                m_storage->hasRetired = false;
+            }
+            for (auto root : retired)
+                unref(root, m_pool);
+            m_snapshots -= retired.size();
+        }
+
+        void release_nodes()
+        {
+            for (size_t i =0; i < 4; ++i)
+            {
+                if (m_root.quadNodes[i])
                 {
-                    rb -= w;
-                    if (n->quadNodes[ si[0] ]) retval = scan_nodes_rb(pi, si, n->quadNodes[ si[0] ].get(), rb, w, current);
-                    if (n->quadNodes[ si[1] ]) retval = scan_nodes_rb(pi, si, n->quadNodes[ si[1] ].get(), rb, w, current);
+                    unref(m_root.quadNodes[i], m_pool);
+                    m_root.quadNodes[i] = nullptr;
                 }
             }
-            current = (retval > current) ? retval : current;
-            return current;
+            m_root.reset_bounds();
+            while (m_squareSide > m_minSide)
+            {
+                m_squareSide >>= 1;
+                --m_treeDepth;
+            }
+        }
+
+        static const T* lookup(const Node* node, uint64_t side, int32_t ix, int32_t iy)
+        {
+            uint64_t x, y;
+            if (!to_local(ix, iy, side, x, y))
+                return nullptr;
+            for (uint64_t width = side >> 1; width; width >>= 1)
+            {
+                node = node->quadNodes[(!!(x & width)) + ((!!(y & width)) << 1)];
+                if (!node)
+                    return nullptr;
+            }
+            return &node->value;
+        }
+
+        // the distance to a subtree is the distance to bounds of its items
+        static Nearest::Candidate<NearestCell> nearest_candidate(const Node* n, uint64_t x, uint64_t y, uint64_t w, int64_t px, int64_t py)
+        {
+            const NearestCell cell = {n, x, y, w};
+            const uint64_t code = Morton::encode(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+            const Nearest::Candidate<NearestCell> result = {
+                (w == 1) ? Nearest::distance(px, py, x, y, x, y) :
+                           Nearest::distance(px, py, x + n->bounds[0], y + n->bounds[1], x + n->bounds[2], y + n->bounds[3]),
+                code, cell};
+            return result;
+        }
+
+        static void count_nodes(const Node* n, size_t level, std::vector<size_t>& nodes)
+        {
+            ++nodes[level];
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (n->quadNodes[i])
+                    count_nodes(n->quadNodes[i], level + 1, nodes);
+            }
+        }
+
+        // collects non empty subtrees at depth in for_each order
+        void collect_tasks(Node* n, uint64_t x, uint64_t y, uint64_t w, size_t depth, std::vector<Task>& tasks)
+        {
+            if (!depth || w == 1)
+            {
+                Task task = {n, x, y, w};
+                tasks.push_back(task);
+                return;
+            }
+            w >>= 1;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (n->quadNodes[i])
+                    collect_tasks(own(n->quadNodes[i]), (i & 1) ? x + w : x, (i & 2) ? y + w : y, w, depth - 1, tasks);
+            }
+        }
+
+        template <class F>
+        void _visit(Node* n, uint64_t x, uint64_t y, uint64_t w, F& v)
+        {
+            w >>= 1;
+            if (w)
+            {
+                if (n->quadNodes[0])
+                    _visit(own(n->quadNodes[0]), x, y, w, v);
+                if (n->quadNodes[1])
+                    _visit(own(n->quadNodes[1]), x + w, y, w, v);
+                if (n->quadNodes[2])
+                    _visit(own(n->quadNodes[2]), x, y + w, w, v);
+                if (n->quadNodes[3])
+                    _visit(own(n->quadNodes[3]), x + w, y + w, w, v);
+            }
+            else
+                v(to_global(x), to_global(y), n->value);
         }
 
-        void _foreach(Node* n, size_t x, size_t y, size_t w, std::function<void(size_t, size_t, T&)> v)
+        // read only _visit, side is the side of the tree the node belongs to
+        template <class F>
+        static void _read(const Node* n, uint64_t x, uint64_t y, uint64_t w, uint64_t side, F& v)
         {
             w >>= 1;
             if (w)
             {
-                if (n->quadNodes[0]) 
-                    _foreach(n->quadNodes[0].get(), x, y, w, v);
-                if (n->quadNodes[1]) 
-                    _foreach(n->quadNodes[1].get(), x + w, y, w, v);
-                if (n->quadNodes[2]) 
-                    _foreach(n->quadNodes[2].get(), x, y + w, w, v);
-                if (n->quadNodes[3]) 
-                    _foreach(n->quadNodes[3].get(), x + w, y + w, w, v);
+                for (size_t i = 0; i < 4; ++i)
+                {
+                    if (n->quadNodes[i])
+                        _read(n->quadNodes[i], (i & 1) ? x + w : x, (i & 2) ? y + w : y, w, side, v);
+                }
             }
             else
-                v(x, y, n->value);
+                v(to_global(x, side), to_global(y, side), static_cast<const T&>(n->value));
+        }
+
+        template <class F>
+        void _query(Node* n, uint64_t x, uint64_t y, uint64_t w, const uint64_t* rect, F& v)
+        {
+            if (rect[0] <= x && x + w <= rect[2] && rect[1] <= y && y + w <= rect[3])
+            {
+                _visit(n, x, y, w, v);
+                return;
+            }
+            w >>= 1;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                const uint64_t cx = (i & 1) ? x + w : x;
+                const uint64_t cy = (i & 2) ? y + w : y;
+                if (n->quadNodes[i] && cx < rect[2] && cx + w > rect[0] && cy < rect[3] && cy + w > rect[1])
+                    _query(own(n->quadNodes[i]), cx, cy, w, rect, v);
+            }
         }
     };
 
+    template <class T> const size_t QuadTree<T>::c_maxDepth;
+    template <class T> const size_t QuadTree<T>::c_splitDepth;
+
 }
-// eof
\ No newline at end of file
+// eof
@@ -1,15 +1,27 @@
 #pragma once
-#include <list>
 #include <vector>
+#include <algorithm>
+#include <iterator>
 #include <memory>
-#include <functional>
+#include "Stats.h"
 
 namespace Utils
 {
-    template <class T>
+    // Sparse array of items: items with continuous indices form a range,
+    // ranges are kept in a vector sorted by start, so the range of an index is found
+    // with binary search and ranges of a pillar are adjacent in memory
+    // a single range of up to N items is kept inside of the list object without any allocation,
+    // the list moves it to the vector of ranges when the second range appears or the range grows,
+    // and back when a single range of up to N/2 items is left after removal or merge
+    // (the gap prevents reallocations when a full range grows and shrinks by an item)
+    // NOTE: pointers returned by get_item_at are valid until the next insertion or removal
+    template <class T, size_t N = 4>
     class RangeList
     {
     public:
+        typedef T value_type;
+        static const size_t c_inlineSize = N;
+
         struct range_desc
         {
             size_t start;
@@ -17,55 +29,61 @@ namespace Utils
         };
 
     public:
-        RangeList() {}
+        RangeList() : m_start(0), m_count(0) {}
         ~RangeList() {}
 
-        size_t ranges_count() {return m_rs.size();}
+        size_t ranges_count() const {return spans_count();}
 
         // get item by index
-        T* get_item_at(size_t index) 
+        T* get_item_at(size_t index)
         {
-            auto range = m_rs.begin();
-            for (; range != m_rs.end(); ++range)
-            {
-                if (range->start <= index && (index - range->start) < range->items.size())
-                {
-                    return &range->items[index - range->start];
-                }
-            }
-            return nullptr; 
+            return const_cast<T*>(static_cast<const RangeList&>(*this).get_item_at(index));
         }
 
-        // insert item to the range list
-        void insert(size_t index, T value) 
+        const T* get_item_at(size_t index) const
         {
-            auto range = m_rs.begin();
+            if (m_count)
+                return (index - m_start < m_count) ? &m_items[index - m_start] : nullptr;
+
+            auto range = std::upper_bound(m_rs.begin(), m_rs.end(), index, starts_after);
+            if (m_rs.begin() == range)
+                return nullptr;
+            --range;
+            return (index - range->start < range->items.size()) ? &range->items[index - range->start] : nullptr;
+        }
 
-            for (; range != m_rs.end(); ++range)
+        // insert item to the range list
+        void insert(size_t index, T value)
+        {
+            if (m_count || (m_rs.empty() && N))
             {
-                range_desc &desc = *range;
-                size_t local_index = index - desc.start;
-                if (range->start > index)
-                    break;
+                if (insert_inline(index, value))
+                    return;
+                spill();
+            }
 
-                if (desc.start <= index && local_index <= desc.items.size())
+            // the first range after index, the range before it is the only one index may belong or adjoin to
+            auto range = upper_range(index);
+            if (m_rs.begin() != range)
+            {
+                auto prev = range - 1;
+                const size_t local_index = index - prev->start;
+                if (local_index < prev->items.size())
                 {
-                    if (local_index == desc.items.size())
+                    // replace value if we are in range
+                    prev->items[local_index] = value;
+                    return;
+                }
+                if (local_index == prev->items.size())
+                {
+                    prev->items.push_back(value);
+                    // merge two ranges if item is inserted between 2 neighbour ranges
+                    if (m_rs.end() != range && prev->start + prev->items.size() == range->start)
                     {
-                        desc.items.push_back(value);
-                        if (range != m_rs.end())
-                        {
-                            // mergetwo items if item is inserted between 2 neighbour ranges
-                            auto next = range;
-                            if (++next != m_rs.end() && desc.start + desc.items.size() == next->start)
-                            {
-                                desc.items.insert(desc.items.end(), next->items.begin(), next->items.end());
-                                m_rs.erase(next);
-                            }
-                        }
+                        prev->items.insert(prev->items.end(), range->items.begin(), range->items.end());
+                        m_rs.erase(range);
+                        unspill();
                     }
-                    else // replacevalueif we are in range
-                        desc.items[local_index] = value;
                     return;
                 }
             }
@@ -80,60 +98,612 @@ namespace Utils
                 range_desc desc;
                 desc.start = index;
                 desc.items.push_back(value);
-
-                m_rs.insert(range, desc);
+                m_rs.insert(range, std::move(desc));
             }
         }
 
+        // removes item and splits its range, ranges never stay empty
         void remove(size_t index)
         {
-            auto range = m_rs.begin();
+            if (m_count)
+            {
+                if (remove_inline(index))
+                    return;
+                spill();
+            }
+
+            auto range = find_range(index);
+            if (m_rs.end() == range)
+                return;
 
-            for (; range != m_rs.end(); ++range)
+            const size_t local_index = index - range->start;
+            if (1 == range->items.size())
+            {
+                m_rs.erase(range);
+            }
+            else if (0 == local_index)
+            {
+                range->items.erase(range->items.begin());
+                ++range->start;
+            }
+            else if (local_index + 1 == range->items.size())
+            {
+                range->items.pop_back();
+            }
+            else
             {
-                range_desc &desc = *range;
-                size_t local_index = index - desc.start;
-                if (range->start > index)
-                    break;
+                range_desc splitted;
+                splitted.start = index + 1;
+                splitted.items.assign(range->items.begin() + local_index + 1, range->items.end());
+                range->items.resize(local_index);
+                m_rs.insert(range + 1, std::move(splitted));
+            }
+            unspill();
+        }
 
-                if (desc.start <= index && local_index <= desc.items.size())
-                {
-                    range_desc splitted;
-                    splitted.start = index + 1;
-                    T* start = &desc.items[local_index + 1];
-                    splitted.items.assign(start, start + desc.items.size() - local_index - 1);
+        // writes items [first, last) to indices from start, existing items are overwritten,
+        // touched ranges are merged with a single search
+        template <class Iterator>
+        void insert_range(size_t start, Iterator first, Iterator last)
+        {
+            CopyWriter<Iterator> writer = {first, last};
+            write_range(start, std::distance(first, last), writer);
+        }
 
-                    m_rs.insert(++range, splitted);
-                    desc.items.resize(local_index);
+        // writes count copies of value to indices from start, see insert_range
+        void fill(size_t start, size_t count, const T& value)
+        {
+            FillWriter writer = {count, value};
+            write_range(start, count, writer);
+        }
 
+        // removes items [start, start + count), ranges are cut or split with a single search
+        void erase_range(size_t start, size_t count)
+        {
+            if (!count)
+                return;
+            const size_t end = start + count;
+            if (m_count)
+            {
+                const size_t inlineEnd = m_start + m_count;
+                if (end <= m_start || inlineEnd <= start)
+                    return;
+                if (start <= m_start || inlineEnd <= end)
+                {
+                    // the head or the tail of the inline range is cut
+                    const size_t first = std::max(start, m_start);
+                    const size_t last  = std::min(end, inlineEnd);
+                    std::copy(m_items + (last - m_start), m_items + m_count, m_items + (first - m_start));
+                    m_count -= last - first;
+                    if (first == m_start)
+                        m_start = m_count ? last : 0;
                     return;
                 }
+                spill();
             }
+
+            // ranges intersecting [start, end)
+            auto lo = upper_range(start);
+            if (m_rs.begin() != lo && (lo - 1)->start + (lo - 1)->items.size() > start)
+                --lo;
+            auto hi = upper_range(end - 1);
+            if (lo == hi)
+                return;
+
+            auto last = hi - 1;
+            const size_t lastEnd = last->start + last->items.size();
+            if (lo == last && lo->start < start && end < lastEnd)
+            {
+                // split the range
+                range_desc splitted;
+                splitted.start = end;
+                splitted.items.assign(lo->items.begin() + (end - lo->start), lo->items.end());
+                lo->items.resize(start - lo->start);
+                m_rs.insert(lo + 1, std::move(splitted));
+                return;
+            }
+            if (lo->start < start)
+            {
+                lo->items.resize(start - lo->start);
+                ++lo;
+            }
+            if (end < lastEnd)
+            {
+                last->items.erase(last->items.begin(), last->items.begin() + (end - last->start));
+                last->start = end;
+                --hi;
+            }
+            m_rs.erase(lo, hi);
+            unspill();
         }
 
-        size_t start() 
+        size_t start()
         {
+            if (m_count)
+                return m_start;
             return m_rs.size() ? m_rs.front().start : 0;
         }
 
-        size_t size() 
+        size_t size()
         {
+            if (m_count)
+                return m_start + m_count;
             return m_rs.size() ? m_rs.back().start + m_rs.back().items.size() : 0;
         }
 
-        void for_each(std::function<void(size_t, T&)> visitor)
+        // true if items are kept inside of the list
+        bool is_inline() const {return m_count || m_rs.empty();}
+
+        // continuous items [start, start + count) of a range, items can be processed as a plain array
+        template <class Item>
+        struct basic_span
+        {
+            size_t  start;
+            Item*   items;
+            size_t  count;
+
+            Item* begin() const {return items;}
+            Item* end() const {return items + count;}
+        };
+
+        typedef basic_span<T>       span;
+        typedef basic_span<const T> const_span;
+
+        // iterator over ranges of the list, dereferenced to a span
+        // any insertion or removal invalidates it
+        template <class List, class Item>
+        class basic_range_iterator
+        {
+        public:
+            typedef std::input_iterator_tag    iterator_category;
+            typedef basic_span<Item>           value_type;
+            typedef ptrdiff_t                  difference_type;
+            typedef const basic_span<Item>*    pointer;
+            typedef basic_span<Item>           reference;
+
+            basic_range_iterator() : m_list(nullptr), m_index(0) {}
+
+            basic_span<Item> operator*() const {return m_list->span_at(m_index);}
+
+            basic_range_iterator& operator++()
+            {
+                ++m_index;
+                return *this;
+            }
+
+            basic_range_iterator operator++(int)
+            {
+                basic_range_iterator tmp(*this);
+                ++m_index;
+                return tmp;
+            }
+
+            bool operator==(const basic_range_iterator& other) const {return m_index == other.m_index;}
+            bool operator!=(const basic_range_iterator& other) const {return m_index != other.m_index;}
+
+        private:
+            friend class RangeList;
+            basic_range_iterator(List* list, size_t index) : m_list(list), m_index(index) {}
+
+            List*   m_list;
+            size_t  m_index;
+        };
+
+        typedef basic_range_iterator<RangeList, T>             range_iterator;
+        typedef basic_range_iterator<const RangeList, const T> const_range_iterator;
+
+        // begin and end of the ranges for range based for loops
+        template <class Iterator>
+        struct basic_ranges
+        {
+            Iterator first;
+            Iterator last;
+
+            Iterator begin() const {return first;}
+            Iterator end() const {return last;}
+        };
+
+        basic_ranges<range_iterator> ranges()
+        {
+            const basic_ranges<range_iterator> result = {range_iterator(this, 0), range_iterator(this, spans_count())};
+            return result;
+        }
+
+        basic_ranges<const_range_iterator> ranges() const
         {
-            for (auto& range : m_rs)
+            const basic_ranges<const_range_iterator> result = {const_range_iterator(this, 0), const_range_iterator(this, spans_count())};
+            return result;
+        }
+
+        // forward iterator over items in the order of indices, index() is the index of the current item
+        // the iterator walks the items of a span as a pointer and looks for the next span at its end only
+        // any insertion or removal invalidates it
+        template <class RangeIterator, class Item>
+        class basic_iterator
+        {
+        public:
+            typedef std::forward_iterator_tag   iterator_category;
+            typedef Item                        value_type;
+            typedef ptrdiff_t                   difference_type;
+            typedef Item*                       pointer;
+            typedef Item&                       reference;
+
+            basic_iterator() : m_start(0), m_first(nullptr), m_item(nullptr), m_last(nullptr) {}
+
+            Item& operator*() const {return *m_item;}
+            Item* operator->() const {return m_item;}
+
+            size_t index() const {return m_start + (m_item - m_first);}
+
+            basic_iterator& operator++()
             {
-                for (size_t index = 0; index != range.items.size(); ++index)
+                if (++m_item == m_last)
+                {
+                    ++m_range;
+                    load();
+                }
+                return *this;
+            }
+
+            basic_iterator operator++(int)
+            {
+                basic_iterator tmp(*this);
+                ++*this;
+                return tmp;
+            }
+
+            bool operator==(const basic_iterator& other) const {return m_item == other.m_item;}
+            bool operator!=(const basic_iterator& other) const {return m_item != other.m_item;}
+
+        private:
+            friend class RangeList;
+            basic_iterator(RangeIterator range, RangeIterator end) : m_range(range), m_end(end), m_start(0), m_first(nullptr), m_item(nullptr), m_last(nullptr)
+            {
+                load();
+            }
+
+            // goes to the first item of the current span, the end iterator has no item
+            void load()
+            {
+                for (; m_end != m_range; ++m_range)
+                {
+                    const basic_span<Item> current = *m_range;
+                    if (current.count)
+                    {
+                        m_start = current.start;
+                        m_first = m_item = current.items;
+                        m_last  = current.items + current.count;
+                        return;
+                    }
+                }
+                m_item = nullptr;
+            }
+
+            RangeIterator   m_range;
+            RangeIterator   m_end;
+            size_t          m_start;    // index of the first item of the span
+            Item*           m_first;
+            Item*           m_item;
+            Item*           m_last;
+        };
+
+        typedef basic_iterator<range_iterator, T>               iterator;
+        typedef basic_iterator<const_range_iterator, const T>   const_iterator;
+
+        iterator begin() {return iterator(range_iterator(this, 0), range_iterator(this, spans_count()));}
+        iterator end() {return iterator();}
+
+        const_iterator begin() const {return const_iterator(const_range_iterator(this, 0), const_range_iterator(this, spans_count()));}
+        const_iterator end() const {return const_iterator();}
+
+        // visits items as visitor(index, item)
+        template <class F>
+        void for_each(F&& visitor)
+        {
+            visit(visitor);
+        }
+
+        // visits items span by span, so the visitor is inlined into the loop over a plain array
+        template <class F>
+        void visit(F&& visitor)
+        {
+            for (const span range : ranges())
+            {
+                for (size_t index = 0; index != range.count; ++index)
+                {
+                    visitor(range.start + index, range.items[index]);
+                }
+            }
+        }
+
+        template <class F>
+        void visit(F&& visitor) const
+        {
+            for (const const_span range : ranges())
+            {
+                for (size_t index = 0; index != range.count; ++index)
                 {
                     visitor(range.start + index, range.items[index]);
                 }
             }
         }
+
+        // visits non empty ranges as visitor(start, items, count)
+        template <class F>
+        void visit_ranges(F&& visitor) const
+        {
+            for (const const_span range : ranges())
+            {
+                if (range.count)
+                    visitor(range.start, range.items, range.count);
+            }
+        }
+
+        // appends items [first, last) at indices from start, start must not be less than size()
+        // used for bulk loading: ranges are built without searching for the place
+        template <class Iterator>
+        void push_range(size_t start, Iterator first, Iterator last)
+        {
+            if (first == last)
+                return;
+            if (is_inline())
+            {
+                const size_t count = std::distance(first, last);
+                if (!m_count && count <= N)
+                {
+                    m_start = start;
+                    m_count = count;
+                    std::copy(first, last, m_items);
+                    return;
+                }
+                if (m_count && start == m_start + m_count && m_count + count <= N)
+                {
+                    std::copy(first, last, m_items + m_count);
+                    m_count += count;
+                    return;
+                }
+                spill();
+            }
+            if (m_rs.empty() || size() != start)
+            {
+                range_desc desc;
+                desc.start = start;
+                m_rs.push_back(desc);
+            }
+            m_rs.back().items.insert(m_rs.back().items.end(), first, last);
+        }
+
+        // ranges and memory of the list, the inline range has capacity of N items and no heap memory
+        RangeStats stats() const
+        {
+            RangeStats result;
+            if (m_count)
+            {
+                result.ranges   = 1;
+                result.items    = m_count;
+                result.capacity = N;
+            }
+            result.bytes = m_rs.capacity() * sizeof(range_desc);
+            for (const auto& range : m_rs)
+            {
+                ++result.ranges;
+                result.items    += range.items.size();
+                result.capacity += range.items.capacity();
+                result.bytes    += range.items.capacity() * sizeof(T);
+            }
+            return result;
+        }
     private:
-        //iterator m_iterator;
-        std::list<range_desc> m_rs; //list of ranges
+        typedef typename std::vector<range_desc>::iterator desc_iterator;
+
+        static bool starts_after(size_t index, const range_desc& range) {return index < range.start;}
+
+        // the first range starting after index
+        desc_iterator upper_range(size_t index)
+        {
+            return std::upper_bound(m_rs.begin(), m_rs.end(), index, starts_after);
+        }
+
+        // the range containing index or end()
+        desc_iterator find_range(size_t index)
+        {
+            auto range = upper_range(index);
+            if (m_rs.begin() == range)
+                return m_rs.end();
+            --range;
+            return (index - range->start < range->items.size()) ? range : m_rs.end();
+        }
+
+        // false if the item doesn't fit to the inline range
+        bool insert_inline(size_t index, const T& value)
+        {
+            const size_t local_index = index - m_start;
+            if (!m_count)
+            {
+                m_start = index;
+                m_items[m_count++] = value;
+            }
+            else if (local_index < m_count)
+            {
+                m_items[local_index] = value;
+            }
+            else if (local_index == m_count && m_count < N)
+            {
+                m_items[m_count++] = value;
+            }
+            else if (index + 1 == m_start && m_count < N)
+            {
+                std::copy_backward(m_items, m_items + m_count, m_items + m_count + 1);
+                m_items[0] = value;
+                --m_start;
+                ++m_count;
+            }
+            else
+                return false;
+            return true;
+        }
+
+        // false if the removal splits the inline range
+        bool remove_inline(size_t index)
+        {
+            const size_t local_index = index - m_start;
+            if (local_index >= m_count)
+            {
+                // nothing to remove
+            }
+            else if (0 == local_index)
+            {
+                std::copy(m_items + 1, m_items + m_count, m_items);
+                ++m_start;
+                --m_count;
+            }
+            else if (local_index + 1 == m_count)
+            {
+                --m_count;
+            }
+            else
+                return false;
+            return true;
+        }
+
+        // writers of bulk insertions: append(items) adds items to the vector, assign(out) copies them to the array
+        template <class Iterator>
+        struct CopyWriter
+        {
+            Iterator first;
+            Iterator last;
+
+            void append(std::vector<T>& items) const {items.insert(items.end(), first, last);}
+            void assign(T* out) const {std::copy(first, last, out);}
+        };
+
+        struct FillWriter
+        {
+            size_t      count;
+            const T&    value;
+
+            void append(std::vector<T>& items) const {items.insert(items.end(), count, value);}
+            void assign(T* out) const {std::fill_n(out, count, value);}
+        };
+
+        // writes count items to indices from start: ranges intersecting or adjoining
+        // [start, start + count] are merged into the first of them
+        template <class Writer>
+        void write_range(size_t start, size_t count, const Writer& writer)
+        {
+            if (!count)
+                return;
+            const size_t end = start + count;
+            if (is_inline())
+            {
+                const size_t inlineEnd = m_start + m_count;
+                const size_t newStart  = m_count ? std::min(start, m_start) : start;
+                const size_t newEnd    = m_count ? std::max(end, inlineEnd) : end;
+                if ((!m_count || (start <= inlineEnd && m_start <= end)) && newEnd - newStart <= N)
+                {
+                    if (m_count && newStart < m_start)
+                        std::copy_backward(m_items, m_items + m_count, m_items + (m_start - newStart) + m_count);
+                    m_start = newStart;
+                    m_count = newEnd - newStart;
+                    writer.assign(m_items + (start - newStart));
+                    return;
+                }
+                spill();
+            }
+
+            // ranges intersecting or adjoining [start, end]
+            auto lo = upper_range(start);
+            if (m_rs.begin() != lo && (lo - 1)->start + (lo - 1)->items.size() >= start)
+                --lo;
+            auto hi = upper_range(end);
+            if (lo == hi)
+            {
+                range_desc desc;
+                desc.start = start;
+                writer.append(desc.items);
+                m_rs.insert(lo, std::move(desc));
+                return;
+            }
+
+            auto last = hi - 1;
+            const size_t lastEnd = last->start + last->items.size();
+            if (lo == last && lo->start <= start && end <= lastEnd)
+            {
+                // items are overwritten in place
+                writer.assign(&lo->items[start - lo->start]);
+                return;
+            }
+
+            // the tail of the last range survives after the written items
+            std::vector<T> tail;
+            if (end < lastEnd)
+                tail.assign(last->items.begin() + (end - last->start), last->items.end());
+            if (lo->start <= start)
+            {
+                lo->items.resize(start - lo->start);
+            }
+            else
+            {
+                lo->items.clear();
+                lo->start = start;
+            }
+            writer.append(lo->items);
+            lo->items.insert(lo->items.end(), tail.begin(), tail.end());
+            m_rs.erase(lo + 1, hi);
+            unspill();
+        }
+
+        // the inline range is the only span while it's used
+        size_t spans_count() const {return m_count ? 1 : m_rs.size();}
+
+        span span_at(size_t index)
+        {
+            const const_span range = static_cast<const RangeList&>(*this).span_at(index);
+            const span result = {range.start, const_cast<T*>(range.items), range.count};
+            return result;
+        }
+
+        const_span span_at(size_t index) const
+        {
+            if (m_count)
+            {
+                const const_span result = {m_start, m_items, m_count};
+                return result;
+            }
+            const range_desc& range = m_rs[index];
+            const const_span result = {range.start, range.items.data(), range.items.size()};
+            return result;
+        }
+
+        // moves the inline range to the vector of ranges
+        void spill()
+        {
+            if (!m_count)
+                return;
+            range_desc desc;
+            desc.start = m_start;
+            desc.items.assign(m_items, m_items + m_count);
+            m_rs.insert(m_rs.begin(), std::move(desc));
+            m_count = 0;
+        }
+
+        // moves the last range inside of the list if it's short, the vector keeps its memory for the next spill
+        void unspill()
+        {
+            if (1 != m_rs.size() || m_rs.front().items.size() > N / 2)
+                return;
+            m_start = m_rs.front().start;
+            m_count = m_rs.front().items.size();
+            std::copy(m_rs.front().items.begin(), m_rs.front().items.end(), m_items);
+            m_rs.clear();
+        }
+
+        size_t                  m_start;    // the inline range, it's used while there are no other ranges
+        size_t                  m_count;
+        T                       m_items[N ? N : 1];
+        std::vector<range_desc> m_rs;       // ranges sorted by start
     };
+
+    template <class T, size_t N> const size_t RangeList<T, N>::c_inlineSize;
 }
-// eof
\ No newline at end of file
+// eof
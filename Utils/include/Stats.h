@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+namespace Utils
+{
+    // shape and memory of a 2D map: QuadTree::stats, LinearQuadTree::stats
+    struct TreeStats
+    {
+        TreeStats() : leaves(0), bytes(0), fill(0) {}
+
+        std::vector<size_t> nodes;  // nodes per level, the root is the level 0, leaves are the last level
+        size_t              leaves;
+        size_t              bytes;  // memory reserved by the map, memory owned by items is not included
+        double              fill;   // average share of used slots: children of inner nodes or hash table slots
+    };
+
+    // shape and memory of range lists, stats of several lists can be summed up
+    struct RangeStats
+    {
+        RangeStats() : ranges(0), items(0), capacity(0), bytes(0) {}
+
+        size_t slack() const {return capacity - items;}
+
+        RangeStats& operator+=(const RangeStats& other)
+        {
+            ranges   += other.ranges;
+            items    += other.items;
+            capacity += other.capacity;
+            bytes    += other.bytes;
+            return *this;
+        }
+
+        size_t ranges;      // runs of items with continuous indices
+        size_t items;
+        size_t capacity;    // items the ranges can keep without reallocation
+        size_t bytes;       // memory allocated by lists, the list objects and memory owned by items are not included
+    };
+}
+// eof
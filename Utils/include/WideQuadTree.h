@@ -0,0 +1,977 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include "Morton.h"
+#include "Pool.h"
+#include "Parallel.h"
+#include "Stats.h"
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace Utils
+{
+    inline unsigned int popcount(uint64_t v)
+    {
+#if defined(_MSC_VER)
+        return static_cast<unsigned int>(__popcnt64(v));
+#elif defined(__POPCNT__)
+        return static_cast<unsigned int>(__builtin_popcountll(v));
+#else
+        // the builtin is a library call without the instruction
+        v = v - ((v >> 1) & 0x5555555555555555ULL);
+        v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+        v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return static_cast<unsigned int>((v * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+    // index of the lowest set bit, v must be non zero
+    inline unsigned int lowest_bit(uint64_t v)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, v);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctzll(v));
+#endif
+    }
+
+    // Wide branching quad tree: every node covers (2^Log2Side)x(2^Log2Side) cells
+    // (4x4 or 8x8), so the tree is Log2Side times shallower than QuadTree.
+    // Nodes keep a bit mask of occupied children and an inline array of occupied ones only,
+    // child position in the array is the popcount of the mask below its bit. The array
+    // follows the node header in the same pool slot, its capacity is a power of two:
+    // a full node moves to the pool of the next capacity, a mostly empty one to the previous.
+    // Values live in leaf nodes only.
+    // Like QuadTree, the area is centered on the origin and grows (or shrinks) on demand,
+    // snapshot() is O(1) and writes copy nodes shared with snapshots on the path to the item.
+    // Children inside of a node are numbered in Z order, so visit visits items
+    // in the same order as QuadTree does.
+    // NOTE: pointers returned by get_item_at and item are valid until the next
+    // insertion or removal in the same leaf
+    template <class T, size_t Log2Side = 2>
+    class WideQuadTree
+    {
+        static_assert(Log2Side > 0 && Log2Side <= 3, "node mask is limited by 64 children");
+    public:
+        static const size_t c_nodeSide  = size_t(1) << Log2Side;
+        static const size_t c_nodeSize  = c_nodeSide * c_nodeSide;
+
+        // squareSide is the initial (and the minimal) side of the tree, it's rounded up
+        // to a power of c_nodeSide, the root is always an inner node
+        WideQuadTree(size_t squareSide = 0)
+            : m_levels(2)
+            , m_root(nullptr)
+            , m_storage(std::make_shared<Storage>())
+            , m_snapshots(0)
+        {
+            while (side_of(m_levels) < squareSide)
+                ++m_levels;
+            m_minLevels = m_levels;
+            m_root = allocate<Node*>(0);
+            init_edge_masks();
+        }
+
+        ~WideQuadTree()
+        {
+            // nodes shared with alive snapshots are released by the last of them
+            std::lock_guard<std::mutex> lock(m_storage->lock);
+            m_storage->owned = false;
+            for (auto& root : m_storage->retired)
+                unref(root.first, root.second - 1, *m_storage);
+            m_storage->retired.clear();
+            unref(m_root, m_levels - 1, *m_storage);
+        }
+
+        // item of bulk loading
+        struct Item
+        {
+            int32_t x;
+            int32_t y;
+            T       value;
+        };
+
+        // replaces content of the tree by items [first, last), items are Item or anything with x, y and value
+        // items are inserted in visit order, so node arrays are filled at their ends
+        // the last of repeated items wins
+        template <class Iterator>
+        void assign(Iterator first, Iterator last)
+        {
+            clear();
+            std::vector< std::pair<uint64_t, Iterator> > items;
+            for (Iterator it = first; it != last; ++it)
+                items.push_back(std::make_pair(Morton::encode_signed(it->x, it->y), it));
+            auto less = [](const std::pair<uint64_t, Iterator>& a, const std::pair<uint64_t, Iterator>& b) {return a.first < b.first;};
+            if (!std::is_sorted(items.begin(), items.end(), less))
+                std::stable_sort(items.begin(), items.end(), less);
+            for (auto& entry : items)
+                item(entry.second->x, entry.second->y) = entry.second->value;
+        }
+
+        void insert(int32_t x, int32_t y, T value)
+        {
+            item(x, y) = value;
+        }
+
+        T* get_item_at(int32_t ix, int32_t iy)
+        {
+            // missing items copy nothing, neither do lookups without snapshots
+            const T* found = find(ix, iy);
+            if (!found || !m_snapshots)
+                return const_cast<T*>(found);
+            uint64_t x, y;
+            to_local(ix, iy, x, y);
+            return &item_at(x, y);
+        }
+
+        // read only lookup, nodes are never copied, so it's safe to call it concurrently
+        const T* find(int32_t x, int32_t y) const
+        {
+            return lookup(m_root, m_levels, x, y);
+        }
+
+        T& item(int32_t ix, int32_t iy)
+        {
+            release_retired();
+            uint64_t x, y;
+            grow_to(ix, iy, x, y);
+            return item_at(x, y);
+        }
+
+        void remove(int32_t ix, int32_t iy)
+        {
+            release_retired();
+            if (!find(ix, iy))
+                return;
+            uint64_t x, y;
+            to_local(ix, iy, x, y);
+
+            Node** path[c_maxLevels];
+            Node** slot = &m_root;
+            for (size_t level = m_levels - 1; level > 0; --level)
+            {
+                path[level] = slot;
+                Node* node = own(*slot, level);
+                slot = &children(node)[rank(node->mask, child_bit(x, y, level))];
+            }
+            own(*slot, 0);
+            erase_slot<T>(*slot, child_bit(x, y, 0));
+
+            // drop emptied nodes, root stays alive
+            for (size_t level = 1; level < m_levels && !(*slot)->mask; ++level)
+            {
+                unref(*slot, level - 1, *m_storage);
+                erase_slot<Node*>(*path[level], child_bit(x, y, level));
+                slot = path[level];
+            }
+            shrink();
+        }
+
+        // bounding rect of items: [left, right) x [top, bottom), see QuadTree::left()
+        // the first (last) non empty column or row of a node is the only candidate
+        int32_t left() const
+        {
+            uint64_t current = side_of(m_levels);
+            return empty() ? 0 : to_global(scan(m_root, m_levels - 1, 0, 0, m_columnMasks, false, true, current));
+        }
+
+        int32_t top() const
+        {
+            uint64_t current = side_of(m_levels);
+            return empty() ? 0 : to_global(scan(m_root, m_levels - 1, 0, 0, m_rowMasks, false, false, current));
+        }
+
+        int64_t right() const
+        {
+            uint64_t current = 0;
+            return empty() ? 0 : int64_t(to_global(scan(m_root, m_levels - 1, 0, 0, m_columnMasks, true, true, current))) + 1;
+        }
+
+        int64_t bottom() const
+        {
+            uint64_t current = 0;
+            return empty() ? 0 : int64_t(to_global(scan(m_root, m_levels - 1, 0, 0, m_rowMasks, true, false, current))) + 1;
+        }
+
+        void for_each(std::function<void(int32_t, int32_t, T&)> visitor)
+        {
+            visit(visitor);
+        }
+
+        // same as for_each, but visitor is not wrapped to std::function and can be inlined
+        template <class F>
+        void visit(F&& visitor)
+        {
+            _visit(own(m_root, m_levels - 1), m_levels - 1, 0, 0, visitor);
+        }
+
+        // visits items inside of the rect [x0, x1) x [y0, y1) in visit order
+        // subtrees outside of the rect are skipped, subtrees inside of it are visited without checks
+        template <class F>
+        void query(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& visitor)
+        {
+            uint64_t rect[4];
+            if (to_local_rect(x0, y0, x1, y1, rect))
+                _query(own(m_root, m_levels - 1), m_levels - 1, 0, 0, rect, visitor);
+        }
+
+        // number of items inside of the rect [x0, x1) x [y0, y1)
+        size_t count(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+        {
+            size_t result = 0;
+            query(x0, y0, x1, y1, [&](int32_t, int32_t, T&) {++result;});
+            return result;
+        }
+
+        // visits items in parallel, subtrees at splitDepth are visited concurrently, see QuadTree::parallel_for_each
+        template <class F>
+        void parallel_for_each(F&& visitor, size_t splitDepth = c_splitDepth)
+        {
+            std::vector<Task> tasks;
+            collect_tasks(own(m_root, m_levels - 1), m_levels - 1, 0, 0, splitDepth, tasks);
+            parallel_tasks(tasks.size(), [&](size_t i)
+            {
+                _visit(tasks[i].node, tasks[i].level, tasks[i].x, tasks[i].y, visitor);
+            });
+        }
+
+        // parallel reduction in visit order, see QuadTree::parallel_reduce
+        template <class R, class F, class C>
+        R parallel_reduce(const R& identity, F&& visitor, C&& combine, size_t splitDepth = c_splitDepth)
+        {
+            std::vector<Task> tasks;
+            collect_tasks(own(m_root, m_levels - 1), m_levels - 1, 0, 0, splitDepth, tasks);
+            return parallel_reduce_tasks(tasks.size(), identity, [&](size_t i, R& accumulator)
+            {
+                auto v = [&](int32_t x, int32_t y, T& item) {visitor(x, y, item, accumulator);};
+                _visit(tasks[i].node, tasks[i].level, tasks[i].x, tasks[i].y, v);
+            }, combine);
+        }
+
+        void clear()
+        {
+            release_retired();
+            unref(m_root, m_levels - 1, *m_storage);
+            m_levels = m_minLevels;
+            m_root = allocate<Node*>(0);
+        }
+
+        bool empty() const
+        {
+            return !m_root->mask;
+        }
+
+        // current side of the tree area
+        uint64_t side() const {return side_of(m_levels);}
+
+        // nodes per level of the tree, items are the last level, nodes shared with snapshots are counted as well
+        // bytes include the whole node pools, free slots too
+        TreeStats stats() const
+        {
+            TreeStats result;
+            result.nodes.assign(m_levels + 1, 0);
+            size_t slots = 0;
+            count_nodes(m_root, m_levels - 1, 0, result.nodes, slots);
+            result.leaves = result.nodes.back();
+            result.bytes  = sizeof(*this) + sizeof(Storage);
+            for (auto& pools : m_storage->pools)
+            {
+                for (auto& pool : pools)
+                    result.bytes += pool.capacity() * pool.slot_size();
+            }
+
+            // every node except the root and every item take a slot of an array
+            size_t used = 0;
+            for (auto n : result.nodes)
+                used += n;
+            result.fill = slots ? (used - 1) / static_cast<double>(slots) : 0;
+            return result;
+        }
+
+    private:
+
+        // header of a pool slot, the array of children (inner nodes) or values (leaves) follows it
+        struct Node
+        {
+            uint64_t mask;      // occupied children in Z order
+            uint32_t refs;      // number of trees and snapshots sharing the node, only the tree modifies it
+            uint32_t capacity;  // log2 of the array size
+        };
+
+        // array of a node: E is Node* for inner nodes and T for leaves
+        template <class E>
+        struct Slots
+        {
+            static const size_t c_kind   = std::is_same<E, Node*>::value ? 1 : 0;
+            static const size_t c_offset = (sizeof(Node) + std::alignment_of<E>::value - 1) / std::alignment_of<E>::value * std::alignment_of<E>::value;
+
+            static E* of(Node* n)              {return reinterpret_cast<E*>(reinterpret_cast<char*>(n) + c_offset);}
+            static const E* of(const Node* n)  {return reinterpret_cast<const E*>(reinterpret_cast<const char*>(n) + c_offset);}
+        };
+
+        // capacities of arrays are 1, 2, 4 .. c_nodeSize
+        static const size_t c_classes = 2 * Log2Side + 1;
+
+        // the tree side doesn't exceed 2^32 much, so the number of levels is limited
+        static const size_t c_maxLevels = (32 + Log2Side - 1) / Log2Side;
+
+        // subtrees of the second level for parallel traversal, the grown root has the central children only
+        static const size_t c_splitDepth = 2;
+
+        // node storage shared by the tree and its snapshots
+        struct Storage
+        {
+            Storage() : hasRetired(false), owned(true)
+            {
+                for (size_t c = 0; c < c_classes; ++c)
+                {
+                    pools[Slots<T>::c_kind][c].set_slot_size(Slots<T>::c_offset + (size_t(1) << c) * sizeof(T));
+                    pools[Slots<Node*>::c_kind][c].set_slot_size(Slots<Node*>::c_offset + (size_t(1) << c) * sizeof(Node*));
+                }
+            }
+
+            SlotPool            pools[2][c_classes];    // leaves and inner nodes by capacity
+            std::mutex          lock;
+            std::vector< std::pair<Node*, size_t> > retired;   // roots and levels of released snapshots, the tree unrefs them on the next write
+            std::atomic<bool>   hasRetired;
+            bool                owned;      // false when the tree is destroyed, snapshots release nodes themselves
+        };
+
+        // subtree visited by a single thread
+        struct Task
+        {
+            Node*    node;
+            size_t   level;
+            uint64_t x;
+            uint64_t y;
+        };
+
+    public:
+        // read only state of the tree at the moment of snapshot() call, see QuadTree::Snapshot
+        class Snapshot
+        {
+        public:
+            Snapshot(Snapshot&& other)
+                : m_storage(std::move(other.m_storage))
+                , m_root(other.m_root)
+                , m_levels(other.m_levels)
+            {
+                other.m_root = nullptr;
+            }
+
+            Snapshot& operator=(Snapshot&& other)
+            {
+                if (this != &other)
+                {
+                    release();
+                    m_storage       = std::move(other.m_storage);
+                    m_root          = other.m_root;
+                    m_levels        = other.m_levels;
+                    other.m_root    = nullptr;
+                }
+                return *this;
+            }
+
+            ~Snapshot()
+            {
+                release();
+            }
+
+            const T* find(int32_t x, int32_t y) const
+            {
+                return lookup(m_root, m_levels, x, y);
+            }
+
+            // visits items in visit order
+            template <class F>
+            void visit(F&& visitor) const
+            {
+                _read(m_root, m_levels - 1, 0, 0, side_of(m_levels), visitor);
+            }
+
+            bool empty() const
+            {
+                return !m_root->mask;
+            }
+
+        private:
+            friend class WideQuadTree;
+
+            Snapshot(const std::shared_ptr<Storage>& storage, Node* root, size_t levels)
+                : m_storage(storage), m_root(root), m_levels(levels) {}
+
+            // the tree unrefs nodes of the snapshot on its next write, nobody else modifies nodes
+            void release()
+            {
+                if (!m_root)
+                    return;
+                std::lock_guard<std::mutex> lock(m_storage->lock);
+                if (m_storage->owned)
+                {
+                    m_storage->retired.push_back(std::make_pair(m_root, m_levels));
+                    m_storage->hasRetired = true;
+                }
+                else
+                    unref(m_root, m_levels - 1, *m_storage);
+                m_root = nullptr;
+            }
+
+            std::shared_ptr<Storage>    m_storage;
+            Node*                       m_root;     // shared with the tree until it writes
+            size_t                      m_levels;
+
+            Snapshot(const Snapshot&);
+            const Snapshot& operator=(const Snapshot&);
+        };
+
+        // O(1): the root is shared, the tree copies it on the next write
+        Snapshot snapshot()
+        {
+            release_retired();
+            ++m_root->refs;
+            ++m_snapshots;
+            return Snapshot(m_storage, m_root, m_levels);
+        }
+
+    private:
+
+        size_t                      m_levels;       // levels of nodes, leaves are the level 0
+        size_t                      m_minLevels;
+        Node*                       m_root;
+        std::shared_ptr<Storage>    m_storage;
+        size_t                      m_snapshots;    // not released yet, nodes aren't shared if there are none
+        uint64_t                    m_columnMasks[c_nodeSide]; // children of every column of a node
+        uint64_t                    m_rowMasks[c_nodeSide];    // children of every row of a node
+
+        WideQuadTree(const WideQuadTree&);
+        const WideQuadTree& operator=(const WideQuadTree);
+
+        static uint64_t side_of(size_t levels)
+        {
+            return uint64_t(1) << (levels * Log2Side);
+        }
+
+        // converts coordinates to the local space of the tree [0, side)
+        static bool to_local(int32_t ix, int32_t iy, uint64_t side, uint64_t& x, uint64_t& y)
+        {
+            const int64_t half = side >> 1;
+            if (ix < -half || ix >= half || iy < -half || iy >= half)
+                return false;
+            x = static_cast<uint64_t>(ix + half);
+            y = static_cast<uint64_t>(iy + half);
+            return true;
+        }
+
+        bool to_local(int32_t ix, int32_t iy, uint64_t& x, uint64_t& y) const
+        {
+            return to_local(ix, iy, side_of(m_levels), x, y);
+        }
+
+        // clamps the rect to the tree area: {x0, y0, x1, y1} in local space, false if nothing is left
+        bool to_local_rect(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint64_t* rect) const
+        {
+            const int64_t half = side_of(m_levels) >> 1;
+            const int64_t left   = std::max<int64_t>(x0, -half) + half;
+            const int64_t top    = std::max<int64_t>(y0, -half) + half;
+            const int64_t right  = std::min<int64_t>(x1, half) + half;
+            const int64_t bottom = std::min<int64_t>(y1, half) + half;
+            if (left >= right || top >= bottom)
+                return false;
+            rect[0] = left; rect[1] = top; rect[2] = right; rect[3] = bottom;
+            return true;
+        }
+
+        static int32_t to_global(uint64_t local, uint64_t side)
+        {
+            return static_cast<int32_t>(static_cast<int64_t>(local) - static_cast<int64_t>(side >> 1));
+        }
+
+        int32_t to_global(uint64_t local) const
+        {
+            return to_global(local, side_of(m_levels));
+        }
+
+        // Morton code of a child inside of a node, the short form of Morton::encode for up to 3 bits
+        static size_t child_index(uint64_t cx, uint64_t cy)
+        {
+            return static_cast<size_t>(spread_digit(cx) | (spread_digit(cy) << 1));
+        }
+
+        static size_t child_index(uint64_t x, uint64_t y, size_t level)
+        {
+            const size_t shift = level * Log2Side;
+            return child_index((x >> shift) & (c_nodeSide - 1), (y >> shift) & (c_nodeSide - 1));
+        }
+
+        static uint64_t spread_digit(uint64_t v)
+        {
+            v = (v | (v << 2)) & 0x33;
+            return (v | (v << 1)) & 0x55;
+        }
+
+        // child coordinates inside of a node, inverse of child_index
+        static uint64_t child_x(size_t index)
+        {
+            uint64_t v = index & 0x15;
+            v = (v | (v >> 1)) & 0x33;
+            return (v | (v >> 2)) & 0x7;
+        }
+
+        static uint64_t child_y(size_t index)
+        {
+            return child_x(index >> 1);
+        }
+
+        static uint64_t child_bit(uint64_t x, uint64_t y, size_t level)
+        {
+            return uint64_t(1) << child_index(x, y, level);
+        }
+
+        static size_t rank(uint64_t mask, uint64_t bit)
+        {
+            return popcount(mask & (bit - 1));
+        }
+
+        static Node** children(Node* n)                 {return Slots<Node*>::of(n);}
+        static Node* const* children(const Node* n)     {return Slots<Node*>::of(n);}
+        static T* values(Node* n)                       {return Slots<T>::of(n);}
+        static const T* values(const Node* n)           {return Slots<T>::of(n);}
+
+        // empty node with the array of 2^capacity slots
+        template <class E>
+        Node* allocate(uint32_t capacity)
+        {
+            Node* n = static_cast<Node*>(m_storage->pools[Slots<E>::c_kind][capacity].allocate());
+            n->mask     = 0;
+            n->refs     = 1;
+            n->capacity = capacity;
+            return n;
+        }
+
+        Node* allocate_node(size_t level)
+        {
+            return level ? allocate<Node*>(0) : allocate<T>(0);
+        }
+
+        // destroys occupied slots and returns the node to its pool
+        template <class E>
+        static void release(Node* n, Storage& storage)
+        {
+            E* slots = Slots<E>::of(n);
+            for (size_t i = 0, count = popcount(n->mask); i < count; ++i)
+                slots[i].~E();
+            storage.pools[Slots<E>::c_kind][n->capacity].release(n);
+        }
+
+        // drops a reference to the node, the last one returns node and its children to pools
+        static void unref(Node* n, size_t level, Storage& storage)
+        {
+            if (--n->refs)
+                return;
+            if (level)
+            {
+                Node** c = children(n);
+                for (size_t i = 0, count = popcount(n->mask); i < count; ++i)
+                    unref(c[i], level - 1, storage);
+                release<Node*>(n, storage);
+            }
+            else
+                release<T>(n, storage);
+        }
+
+        // path copying: the node is copied before it's modified, if snapshots share it
+        Node* own(Node*& n, size_t level)
+        {
+            if (m_snapshots && n->refs > 1)
+            {
+                if (level)
+                {
+                    n = clone<Node*>(n);
+                    Node** c = children(n);
+                    for (size_t i = 0, count = popcount(n->mask); i < count; ++i)
+                        ++c[i]->refs;
+                }
+                else
+                    n = clone<T>(n);
+            }
+            return n;
+        }
+
+        template <class E>
+        Node* clone(Node* n)
+        {
+            Node* copy;
+            {
+                // parallel traversals copy nodes of different subtrees concurrently
+                std::lock_guard<std::mutex> lock(m_storage->lock);
+                copy = allocate<E>(n->capacity);
+            }
+            const E* source = Slots<E>::of(n);
+            E* target = Slots<E>::of(copy);
+            for (size_t i = 0, count = popcount(n->mask); i < count; ++i)
+                new (&target[i]) E(source[i]);
+            copy->mask = n->mask;
+            --n->refs;
+            return copy;
+        }
+
+        // adds the default slot of the child bit, a full node moves to the pool of the next capacity
+        template <class E>
+        E& insert_slot(Node*& n, uint64_t bit)
+        {
+            const size_t count    = popcount(n->mask);
+            const size_t position = rank(n->mask, bit);
+            E* slots = Slots<E>::of(n);
+            if (count == (size_t(1) << n->capacity))
+            {
+                Node* grown = allocate<E>(n->capacity + 1);
+                E* target = Slots<E>::of(grown);
+                for (size_t i = 0; i < count; ++i)
+                    new (&target[i < position ? i : i + 1]) E(std::move(slots[i]));
+                new (&target[position]) E();
+                grown->mask = n->mask;
+                release<E>(n, *m_storage);
+                n = grown;
+                slots = target;
+            }
+            else if (position < count)
+            {
+                new (&slots[count]) E(std::move(slots[count - 1]));
+                std::move_backward(slots + position, slots + count - 1, slots + count);
+                slots[position] = E();
+            }
+            else
+                new (&slots[count]) E();
+            n->mask |= bit;
+            return slots[position];
+        }
+
+        // removes the slot of the child bit, a node filled by a quarter moves to the pool of the previous capacity
+        template <class E>
+        void erase_slot(Node*& n, uint64_t bit)
+        {
+            const size_t count    = popcount(n->mask);
+            const size_t position = rank(n->mask, bit);
+            E* slots = Slots<E>::of(n);
+            std::move(slots + position + 1, slots + count, slots + position);
+            slots[count - 1].~E();
+            n->mask &= ~bit;
+            if (count > 1 && n->capacity && 4 * (count - 1) <= (size_t(1) << n->capacity))
+            {
+                Node* shrunk = allocate<E>(n->capacity - 1);
+                E* target = Slots<E>::of(shrunk);
+                for (size_t i = 0; i + 1 < count; ++i)
+                    new (&target[i]) E(std::move(slots[i]));
+                shrunk->mask = n->mask;
+                release<E>(n, *m_storage);
+                n = shrunk;
+            }
+        }
+
+        // the path to the item is copied from snapshots, missing nodes and the item are created
+        T& item_at(uint64_t x, uint64_t y)
+        {
+            Node** slot = &m_root;
+            for (size_t level = m_levels - 1; level > 0; --level)
+            {
+                const uint64_t bit = child_bit(x, y, level);
+                if (!(own(*slot, level)->mask & bit))
+                {
+                    Node* child = allocate_node(level - 1);
+                    insert_slot<Node*>(*slot, bit) = child;
+                }
+                slot = &children(*slot)[rank((*slot)->mask, bit)];
+            }
+            const uint64_t bit = child_bit(x, y, 0);
+            Node* leaf = own(*slot, 0);
+            return (leaf->mask & bit) ? values(leaf)[rank(leaf->mask, bit)] : insert_slot<T>(*slot, bit);
+        }
+
+        // the area grows c_nodeSide times until the item fits to it
+        // children of the root keep their place: the unit u of the old root is the unit u + offset
+        // of the new root children, where offset centers the old area, e.g. for 4x4 nodes:
+        // | 0 1 2 3 |    | . . . . | . . . . | . . . . | . . . . |
+        //                | . . . . | . . 0 1 | 2 3 . . | . . . . |
+        void grow_to(int32_t ix, int32_t iy, uint64_t& x, uint64_t& y)
+        {
+            const uint64_t offset = (c_nodeSize - c_nodeSide) / 2;
+            while (!to_local(ix, iy, x, y))
+            {
+                Node* root = allocate<Node*>(0);
+                Node* const* c = children(m_root);
+                uint64_t mask = m_root->mask;
+                for (size_t position = 0; mask; ++position)
+                {
+                    const unsigned int index = lowest_bit(mask);
+                    mask &= mask - 1;
+                    const uint64_t ux = child_x(index) + offset;
+                    const uint64_t uy = child_y(index) + offset;
+                    const uint64_t parentBit = uint64_t(1) << child_index(ux >> Log2Side, uy >> Log2Side);
+                    if (!(root->mask & parentBit))
+                    {
+                        Node* parent = allocate<Node*>(0);
+                        insert_slot<Node*>(root, parentBit) = parent;
+                    }
+                    Node*& parent = children(root)[rank(root->mask, parentBit)];
+                    // the old root may be shared with snapshots, so the child is referenced before it goes
+                    ++c[position]->refs;
+                    insert_slot<Node*>(parent, uint64_t(1) << child_index(ux & (c_nodeSide - 1), uy & (c_nodeSide - 1))) = c[position];
+                }
+                unref(m_root, m_levels - 1, *m_storage);
+                m_root = root;
+                ++m_levels;
+            }
+        }
+
+        // inverse of grow_to: the root is replaced by its central grandchildren while all items are there
+        void shrink()
+        {
+            const uint64_t offset = (c_nodeSize - c_nodeSide) / 2;
+            while (m_levels > m_minLevels)
+            {
+                for (int pass = 0; pass < 2; ++pass)
+                {
+                    Node* root = pass ? allocate<Node*>(0) : nullptr;
+                    Node* const* c = children(m_root);
+                    uint64_t mask = m_root->mask;
+                    for (size_t position = 0; mask; ++position)
+                    {
+                        const unsigned int index = lowest_bit(mask);
+                        mask &= mask - 1;
+                        Node* const* grandchildren = children(c[position]);
+                        uint64_t inner = c[position]->mask;
+                        for (size_t innerPosition = 0; inner; ++innerPosition)
+                        {
+                            const unsigned int innerIndex = lowest_bit(inner);
+                            inner &= inner - 1;
+                            const uint64_t ux = child_x(index) * c_nodeSide + child_x(innerIndex);
+                            const uint64_t uy = child_y(index) * c_nodeSide + child_y(innerIndex);
+                            // the first pass checks that all grandchildren are in the central area
+                            if (!root)
+                            {
+                                if (ux < offset || ux >= offset + c_nodeSide || uy < offset || uy >= offset + c_nodeSide)
+                                    return;
+                                continue;
+                            }
+                            ++grandchildren[innerPosition]->refs;
+                            insert_slot<Node*>(root, uint64_t(1) << child_index(ux - offset, uy - offset)) = grandchildren[innerPosition];
+                        }
+                    }
+                    if (root)
+                    {
+                        unref(m_root, m_levels - 1, *m_storage);
+                        m_root = root;
+                        --m_levels;
+                    }
+                }
+            }
+        }
+
+        // unrefs nodes of snapshots released since the last write
+        void release_retired()
+        {
+            if (!m_storage->hasRetired)
+                return;
+            std::vector< std::pair<Node*, size_t> > retired;
+            {
+                std::lock_guard<std::mutex> lock(m_storage->lock);
+                retired.swap(m_storage->retired);
+                m_storage->hasRetired = false;
+            }
+            for (auto& root : retired)
+                unref(root.first, root.second - 1, *m_storage);
+            m_snapshots -= retired.size();
+        }
+
+        static const T* lookup(const Node* node, size_t levels, int32_t ix, int32_t iy)
+        {
+            uint64_t x, y;
+            if (!to_local(ix, iy, side_of(levels), x, y))
+                return nullptr;
+            for (size_t level = levels - 1; level > 0; --level)
+            {
+                const uint64_t bit = child_bit(x, y, level);
+                if (!(node->mask & bit))
+                    return nullptr;
+                node = children(node)[rank(node->mask, bit)];
+            }
+            const uint64_t bit = child_bit(x, y, 0);
+            return (node->mask & bit) ? &values(node)[rank(node->mask, bit)] : nullptr;
+        }
+
+        void init_edge_masks()
+        {
+            for (size_t i = 0; i < c_nodeSide; ++i)
+            {
+                m_columnMasks[i] = 0;
+                m_rowMasks[i] = 0;
+            }
+            for (size_t index = 0; index < c_nodeSize; ++index)
+            {
+                m_columnMasks[child_x(index)] |= uint64_t(1) << index;
+                m_rowMasks[child_y(index)]    |= uint64_t(1) << index;
+            }
+        }
+
+        // looks for the min (or max) local coordinate along the axis
+        // children in the first non empty column (row) are the only candidates,
+        // the search stops in subtrees that can't improve current value
+        uint64_t scan(const Node* n, size_t level, uint64_t x, uint64_t y, const uint64_t* lineMasks, bool maximum, bool horizontal, uint64_t& current) const
+        {
+            const size_t shift = level * Log2Side;
+            const uint64_t width = uint64_t(1) << shift;
+            for (size_t step = 0; step < c_nodeSide; ++step)
+            {
+                const size_t line = maximum ? c_nodeSide - 1 - step : step;
+                uint64_t candidates = n->mask & lineMasks[line];
+                if (!candidates)
+                    continue;
+
+                const uint64_t origin = (horizontal ? x : y) + line * width;
+                // whole line is out of interest
+                if (maximum ? (origin + width - 1 <= current) : (origin >= current))
+                    return current;
+
+                while (candidates)
+                {
+                    const unsigned int index = lowest_bit(candidates);
+                    candidates &= candidates - 1;
+                    if (level)
+                    {
+                        const uint64_t cx = x + child_x(index) * width;
+                        const uint64_t cy = y + child_y(index) * width;
+                        scan(children(n)[rank(n->mask, uint64_t(1) << index)], level - 1, cx, cy, lineMasks, maximum, horizontal, current);
+                    }
+                    else
+                    {
+                        current = maximum ? std::max(origin, current) : std::min(origin, current);
+                    }
+                }
+                return current;
+            }
+            return current;
+        }
+
+        static void count_nodes(const Node* n, size_t level, size_t depth, std::vector<size_t>& nodes, size_t& slots)
+        {
+            ++nodes[depth];
+            slots += size_t(1) << n->capacity;
+            if (!level)
+            {
+                nodes[depth + 1] += popcount(n->mask);
+                return;
+            }
+            Node* const* c = children(n);
+            for (size_t i = 0, count = popcount(n->mask); i < count; ++i)
+                count_nodes(c[i], level - 1, depth + 1, nodes, slots);
+        }
+
+        // collects non empty subtrees at depth in visit order
+        void collect_tasks(Node* n, size_t level, uint64_t x, uint64_t y, size_t depth, std::vector<Task>& tasks)
+        {
+            if (!depth || !level)
+            {
+                Task task = {n, level, x, y};
+                tasks.push_back(task);
+                return;
+            }
+            const size_t shift = level * Log2Side;
+            uint64_t mask = n->mask;
+            for (size_t position = 0; mask; ++position)
+            {
+                const unsigned int index = lowest_bit(mask);
+                mask &= mask - 1;
+                const uint64_t cx = x + (child_x(index) << shift);
+                const uint64_t cy = y + (child_y(index) << shift);
+                collect_tasks(own(children(n)[position], level - 1), level - 1, cx, cy, depth - 1, tasks);
+            }
+        }
+
+        template <class F>
+        void _visit(Node* n, size_t level, uint64_t x, uint64_t y, F& v)
+        {
+            const size_t shift = level * Log2Side;
+            uint64_t mask = n->mask;
+            for (size_t position = 0; mask; ++position)
+            {
+                const unsigned int index = lowest_bit(mask);
+                mask &= mask - 1;
+                const uint64_t cx = x + (child_x(index) << shift);
+                const uint64_t cy = y + (child_y(index) << shift);
+                if (level)
+                    _visit(own(children(n)[position], level - 1), level - 1, cx, cy, v);
+                else
+                    v(to_global(cx), to_global(cy), values(n)[position]);
+            }
+        }
+
+        // read only _visit, side is the side of the tree the node belongs to
+        template <class F>
+        static void _read(const Node* n, size_t level, uint64_t x, uint64_t y, uint64_t side, F& v)
+        {
+            const size_t shift = level * Log2Side;
+            uint64_t mask = n->mask;
+            for (size_t position = 0; mask; ++position)
+            {
+                const unsigned int index = lowest_bit(mask);
+                mask &= mask - 1;
+                const uint64_t cx = x + (child_x(index) << shift);
+                const uint64_t cy = y + (child_y(index) << shift);
+                if (level)
+                    _read(children(n)[position], level - 1, cx, cy, side, v);
+                else
+                    v(to_global(cx, side), to_global(cy, side), values(n)[position]);
+            }
+        }
+
+        template <class F>
+        void _query(Node* n, size_t level, uint64_t x, uint64_t y, const uint64_t* rect, F& v)
+        {
+            const size_t shift = level * Log2Side;
+            const uint64_t w = uint64_t(c_nodeSide) << shift;
+            if (rect[0] <= x && x + w <= rect[2] && rect[1] <= y && y + w <= rect[3])
+            {
+                _visit(n, level, x, y, v);
+                return;
+            }
+            const uint64_t cw = uint64_t(1) << shift;
+            uint64_t mask = n->mask;
+            for (size_t position = 0; mask; ++position)
+            {
+                const unsigned int index = lowest_bit(mask);
+                mask &= mask - 1;
+                const uint64_t cx = x + (child_x(index) << shift);
+                const uint64_t cy = y + (child_y(index) << shift);
+                if (cx >= rect[2] || cx + cw <= rect[0] || cy >= rect[3] || cy + cw <= rect[1])
+                    continue;
+                if (level)
+                    _query(own(children(n)[position], level - 1), level - 1, cx, cy, rect, v);
+                else
+                    v(to_global(cx), to_global(cy), values(n)[position]);
+            }
+        }
+    };
+
+    template <class T, size_t Log2Side> const size_t WideQuadTree<T, Log2Side>::c_nodeSide;
+    template <class T, size_t Log2Side> const size_t WideQuadTree<T, Log2Side>::c_nodeSize;
+    template <class T, size_t Log2Side> const size_t WideQuadTree<T, Log2Side>::c_classes;
+    template <class T, size_t Log2Side> const size_t WideQuadTree<T, Log2Side>::c_maxLevels;
+    template <class T, size_t Log2Side> const size_t WideQuadTree<T, Log2Side>::c_splitDepth;
+
+    // 4x4 nodes with the single template parameter, the map of PillarStorage
+    template <class T>
+    using WideQuadTree4x4 = WideQuadTree<T, 2>;
+}
+// eof
@@ -0,0 +1,198 @@
+#include "BrickMap.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <cstdlib>
+
+using namespace Utils;
+
+typedef std::tuple<int32_t, int32_t, int32_t> Position;
+
+class BrickMapTest : public ::testing::Test
+{
+public:
+    void SetUp()
+    {
+        m_map.reset(new BrickMap<int>());
+    }
+    void TearDown()
+    {
+        m_map.reset();
+    }
+protected:
+    std::unique_ptr< BrickMap<int> > m_map;
+};
+
+TEST_F(BrickMapTest, EmptyItem)
+{
+    ASSERT_TRUE(nullptr == m_map->get_item_at(0, 0, 0));
+    ASSERT_TRUE(nullptr == m_map->find(-100, 100, 5));
+    ASSERT_TRUE(m_map->empty());
+}
+
+TEST_F(BrickMapTest, NegativeCoordinates)
+{
+    // cells around the origin belong to 8 different bricks
+    for (int32_t x = -1; x <= 0; ++x)
+        for (int32_t y = -1; y <= 0; ++y)
+            for (int32_t z = -1; z <= 0; ++z)
+                m_map->insert(x, y, z, x * 100 + y * 10 + z);
+    ASSERT_EQ(8, m_map->bricks_count());
+    ASSERT_EQ(8, m_map->size());
+    ASSERT_EQ(-111, *m_map->get_item_at(-1, -1, -1));
+    ASSERT_EQ(-10, *m_map->find(0, -1, 0));
+    ASSERT_TRUE(nullptr == m_map->get_item_at(1, 0, 0));
+    ASSERT_TRUE(nullptr == m_map->find(-2, 0, 0));
+
+    const int32_t side = static_cast<int32_t>(BrickMap<int>::c_side);
+    m_map->insert(INT32_MIN, INT32_MAX, -side, 7);
+    ASSERT_EQ(7, *m_map->find(INT32_MIN, INT32_MAX, -side));
+    ASSERT_TRUE(nullptr == m_map->find(INT32_MIN, INT32_MAX, -side - 1));
+}
+
+TEST_F(BrickMapTest, RemoveReleasesBricks)
+{
+    m_map->insert(0, 0, 0, 1);
+    m_map->insert(1, 0, 0, 2);
+    m_map->insert(100, 0, 0, 3);
+    ASSERT_EQ(2, m_map->bricks_count());
+
+    m_map->remove(0, 0, 0);
+    m_map->remove(0, 0, 0);
+    ASSERT_EQ(2, m_map->bricks_count());
+    ASSERT_TRUE(nullptr == m_map->get_item_at(0, 0, 0));
+
+    m_map->remove(1, 0, 0);
+    ASSERT_EQ(1, m_map->bricks_count());
+    ASSERT_EQ(3, *m_map->get_item_at(100, 0, 0));
+    m_map->insert(0, 0, 0, 4);
+    ASSERT_EQ(4, *m_map->get_item_at(0, 0, 0)) << "the released cell keeps no value";
+    ASSERT_EQ(2, m_map->size());
+}
+
+TEST_F(BrickMapTest, RandomOperations)
+{
+    std::map<Position, int> reference;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const int32_t x = rand() % 40 - 20;
+        const int32_t y = rand() % 40 - 20;
+        const int32_t z = rand() % 40 - 20;
+        if (rand() % 4)
+        {
+            m_map->insert(x, y, z, i);
+            reference[Position(x, y, z)] = i;
+        }
+        else
+        {
+            m_map->remove(x, y, z);
+            reference.erase(Position(x, y, z));
+        }
+    }
+
+    ASSERT_EQ(reference.size(), m_map->size());
+    size_t count = 0;
+    m_map->visit([&](int32_t x, int32_t y, int32_t z, int& v)
+    {
+        auto expected = reference.find(Position(x, y, z));
+        ASSERT_TRUE(reference.end() != expected);
+        ASSERT_EQ(expected->second, v);
+        ++count;
+    });
+    ASSERT_EQ(reference.size(), count);
+
+    for (int32_t x = -21; x < 21; ++x)
+        for (int32_t y = -21; y < 21; ++y)
+            for (int32_t z = -21; z < 21; ++z)
+            {
+                const bool expected = 0 != reference.count(Position(x, y, z));
+                ASSERT_EQ(expected, nullptr != m_map->get_item_at(x, y, z));
+                ASSERT_EQ(expected, nullptr != m_map->find(x, y, z));
+            }
+}
+
+TEST_F(BrickMapTest, Query)
+{
+    for (int32_t x = -20; x < 20; ++x)
+        for (int32_t z = -20; z < 20; ++z)
+            m_map->insert(x, x + z, z, 1);
+
+    size_t expected = 0;
+    m_map->visit([&](int32_t x, int32_t y, int32_t z, int&)
+    {
+        if (-5 <= x && x < 17 && -3 <= y && y < 3 && 0 <= z && z < 20)
+            ++expected;
+    });
+    ASSERT_LT(0, expected);
+
+    size_t actual = 0;
+    m_map->query(-5, -3, 0, 17, 3, 20, [&](int32_t x, int32_t y, int32_t z, int&)
+    {
+        ASSERT_TRUE(-5 <= x && x < 17 && -3 <= y && y < 3 && 0 <= z && z < 20);
+        ++actual;
+    });
+    ASSERT_EQ(expected, actual);
+}
+
+TEST_F(BrickMapTest, ParallelReduce)
+{
+    int64_t expected = 0;
+    for (int32_t i = 0; i < 1000; ++i)
+    {
+        m_map->insert(i % 50, i / 50, -i % 7, i);
+        expected += i;
+    }
+
+    m_map->parallel_for_each([](int32_t, int32_t, int32_t, int& v) {v *= 2;});
+    const int64_t sum = m_map->parallel_reduce(int64_t(0),
+        [](int32_t, int32_t, int32_t, int& v, int64_t& accumulator) {accumulator += v;},
+        [](int64_t& result, int64_t part) {result += part;});
+    ASSERT_EQ(2 * expected, sum);
+}
+
+TEST_F(BrickMapTest, SnapshotKeepsItems)
+{
+    for (int32_t x = 0; x < 40; ++x)
+        m_map->insert(x, 0, 0, 1);
+
+    BrickMap<int>::Snapshot snapshot = m_map->snapshot();
+    *m_map->get_item_at(0, 0, 0) = 2;
+    m_map->insert(1, 1, 1, 3);
+    m_map->remove(39, 0, 0);
+    m_map->visit([](int32_t, int32_t, int32_t, int& v) {v += 10;});
+
+    ASSERT_EQ(1, *snapshot.find(0, 0, 0));
+    ASSERT_EQ(1, *snapshot.find(39, 0, 0));
+    ASSERT_TRUE(nullptr == snapshot.find(1, 1, 1));
+    size_t count = 0;
+    snapshot.visit([&](int32_t, int32_t, int32_t, const int& v)
+    {
+        ASSERT_EQ(1, v);
+        ++count;
+    });
+    ASSERT_EQ(40, count);
+
+    ASSERT_EQ(12, *m_map->get_item_at(0, 0, 0));
+    ASSERT_EQ(13, *m_map->get_item_at(1, 1, 1));
+    ASSERT_TRUE(nullptr == m_map->get_item_at(39, 0, 0));
+}
+
+TEST_F(BrickMapTest, Stats)
+{
+    TreeStats stats = m_map->stats();
+    EXPECT_EQ(0, stats.leaves);
+    EXPECT_EQ(0, stats.fill);
+
+    for (int32_t x = 0; x < 16; ++x)
+        for (int32_t y = 0; y < 16; ++y)
+            m_map->insert(x, y, 0, 1);
+    m_map->insert(100, 0, 0, 1);
+    stats = m_map->stats();
+    EXPECT_EQ(2, stats.leaves);
+    EXPECT_DOUBLE_EQ(257.0 / (2 * BrickMap<int>::c_volume), stats.fill);
+    EXPECT_LE(2 * sizeof(BrickMap<int>::Brick), stats.bytes);
+}
+
+// eof
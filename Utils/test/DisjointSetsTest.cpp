@@ -0,0 +1,70 @@
+#include "DisjointSets.h"
+#include <gtest/gtest.h>
+#include <vector>
+#include <cstdlib>
+
+using namespace Utils;
+
+TEST(DisjointSetsTest, SingleSets)
+{
+    DisjointSets sets;
+    sets.resize(10);
+    ASSERT_EQ(10, sets.size());
+    for (uint32_t id = 0; id < 10; ++id)
+        ASSERT_EQ(id, sets.find(id));
+}
+
+TEST(DisjointSetsTest, Unite)
+{
+    DisjointSets sets;
+    sets.resize(6);
+    const uint32_t root = sets.unite(0, 1);
+    ASSERT_EQ(root, sets.find(0));
+    ASSERT_EQ(root, sets.find(1));
+    ASSERT_EQ(root, sets.unite(1, 0)) << "ids of the same set";
+
+    sets.unite(2, 3);
+    sets.unite(3, 1);
+    ASSERT_EQ(sets.find(0), sets.find(2));
+    ASSERT_NE(sets.find(0), sets.find(4));
+
+    // new ids don't change existing sets
+    sets.resize(8);
+    ASSERT_EQ(sets.find(0), sets.find(3));
+    ASSERT_EQ(7, sets.find(7));
+
+    const DisjointSets& constSets = sets;
+    ASSERT_EQ(sets.find(2), constSets.find(2));
+}
+
+TEST(DisjointSetsTest, RandomUnions)
+{
+    // labels are merged explicitly as the reference
+    const size_t count = 1000;
+    std::vector<size_t> labels(count);
+    for (size_t i = 0; i < count; ++i)
+        labels[i] = i;
+
+    DisjointSets sets;
+    sets.resize(count);
+    for (int i = 0; i < 700; ++i)
+    {
+        const uint32_t a = rand() % count;
+        const uint32_t b = rand() % count;
+        sets.unite(a, b);
+        const size_t from = labels[b];
+        for (auto& label : labels)
+        {
+            if (label == from)
+                label = labels[a];
+        }
+    }
+
+    for (uint32_t a = 0; a < count; a += 7)
+    {
+        for (uint32_t b = 0; b < count; b += 13)
+            ASSERT_EQ(labels[a] == labels[b], sets.find(a) == sets.find(b));
+    }
+}
+
+// eof
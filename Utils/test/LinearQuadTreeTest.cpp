@@ -0,0 +1,544 @@
+#include "LinearQuadTree.h"
+#include "QuadTree.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+using namespace Utils;
+
+class LinearQuadTreeTest : public ::testing::Test
+{
+public:
+    static const size_t c_size = 512;
+    void SetUp()
+    {
+        m_tree.reset(new LinearQuadTree<int>(c_size));
+    }
+    void TearDown()
+    {
+        m_tree.reset();
+    }
+protected:
+    std::unique_ptr< LinearQuadTree<int> > m_tree;
+};
+
+const size_t LinearQuadTreeTest::c_size;
+
+TEST(MortonTest, EncodeDecode)
+{
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        uint32_t x = rand() * rand();
+        uint32_t y = rand() * rand();
+        uint64_t code = Morton::encode(x, y);
+        ASSERT_EQ(x, Morton::decode_x(code));
+        ASSERT_EQ(y, Morton::decode_y(code));
+    }
+}
+
+TEST(MortonTest, QuadOrder)
+{
+    EXPECT_EQ(0, Morton::encode(0, 0));
+    EXPECT_EQ(1, Morton::encode(1, 0));
+    EXPECT_EQ(2, Morton::encode(0, 1));
+    EXPECT_EQ(3, Morton::encode(1, 1));
+    EXPECT_EQ(4, Morton::encode(2, 0));
+}
+
+TEST(MortonTest, NextInRect)
+{
+    for (int i = 0; i < 100; ++i)
+    {
+        const uint32_t x0 = rand() % 16, x1 = x0 + rand() % 16;
+        const uint32_t y0 = rand() % 16, y1 = y0 + rand() % 16;
+        const uint64_t minCode = Morton::encode(x0, y0);
+        const uint64_t maxCode = Morton::encode(x1, y1);
+        uint64_t expected = maxCode;
+        for (uint64_t code = maxCode; code-- > minCode;)
+        {
+            const uint32_t x = Morton::decode_x(code);
+            const uint32_t y = Morton::decode_y(code);
+            if (x0 <= x && x <= x1 && y0 <= y && y <= y1)
+                expected = code;
+            else
+                ASSERT_EQ(expected, Morton::next_in_rect(code, minCode, maxCode)) << "code " << code;
+        }
+    }
+}
+
+TEST_F(LinearQuadTreeTest, EmptyItem)
+{
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(254, 400) );
+}
+
+TEST_F(LinearQuadTreeTest, InsertedItem)
+{
+    ASSERT_NO_THROW( m_tree->insert(254, 400, 10) );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(400, 254) );
+    ASSERT_EQ(10, *m_tree->get_item_at(254, 400));
+}
+
+TEST_F(LinearQuadTreeTest, GetAndCreateItem)
+{
+    ASSERT_NO_THROW( m_tree->item(254, 400) = 10 );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(400, 254) );
+    ASSERT_EQ(10, *m_tree->get_item_at(254, 400));
+}
+
+TEST_F(LinearQuadTreeTest, RewriteItem)
+{
+    m_tree->insert(254, 400, 10);
+    ASSERT_EQ(10, *m_tree->get_item_at(254, 400));
+    m_tree->insert(254, 400, 50);
+    ASSERT_EQ(50, *m_tree->get_item_at(254, 400));
+    ASSERT_EQ(1, m_tree->size());
+}
+
+TEST_F(LinearQuadTreeTest, RemoveItems)
+{
+    m_tree->insert(254, 400, 10);
+    m_tree->insert(254, 401, 15);
+    ASSERT_NO_THROW( m_tree->remove(254, 400) );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(254, 400) );
+    ASSERT_TRUE( nullptr != m_tree->get_item_at(254, 401) );
+    ASSERT_EQ( 15, *m_tree->get_item_at(254, 401) );
+    ASSERT_NO_THROW( m_tree->remove(254, 400) );
+    ASSERT_EQ(1, m_tree->size());
+}
+
+TEST_F(LinearQuadTreeTest, BoundingRectDiagonale)
+{
+    m_tree->item(0, 0) = 10;
+    m_tree->item(1, 2) = 10;
+    m_tree->item(2, 0) = 10;
+    EXPECT_EQ(0, m_tree->left());
+    EXPECT_EQ(0, m_tree->top());
+    EXPECT_EQ(3, m_tree->right());
+    EXPECT_EQ(3, m_tree->bottom());
+}
+
+TEST_F(LinearQuadTreeTest, NegativeCoordinates)
+{
+    m_tree->item(-1, -1) = 1;
+    m_tree->item(-1000, 5) = 2;
+    m_tree->item(7, -100000) = 3;
+    ASSERT_EQ(1, *m_tree->get_item_at(-1, -1));
+    ASSERT_EQ(2, *m_tree->get_item_at(-1000, 5));
+    ASSERT_EQ(3, *m_tree->get_item_at(7, -100000));
+    ASSERT_TRUE(nullptr == m_tree->get_item_at(1, 1));
+
+    EXPECT_EQ(-1000, m_tree->left());
+    EXPECT_EQ(-100000, m_tree->top());
+    EXPECT_EQ(8, m_tree->right());
+    EXPECT_EQ(6, m_tree->bottom());
+}
+
+TEST_F(LinearQuadTreeTest, ExtremeCoordinates)
+{
+    m_tree->item(INT32_MIN, INT32_MAX) = 1;
+    m_tree->item(INT32_MAX, INT32_MIN) = 2;
+    ASSERT_EQ(1, *m_tree->get_item_at(INT32_MIN, INT32_MAX));
+    ASSERT_EQ(2, *m_tree->get_item_at(INT32_MAX, INT32_MIN));
+    EXPECT_EQ(INT32_MIN, m_tree->left());
+    EXPECT_EQ(INT32_MIN, m_tree->top());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->right());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->bottom());
+}
+
+TEST_F(LinearQuadTreeTest, BoundingRectAfterRemoval)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 20000; ++i)
+    {
+        const int32_t x = rand() % 32 - 16;
+        const int32_t y = rand() % 32 - 16;
+        if (rand() % 2)
+        {
+            m_tree->item(x, y) = i;
+            reference.item(x, y) = i;
+        }
+        else
+        {
+            m_tree->remove(x, y);
+            reference.remove(x, y);
+        }
+        if (i % 7)
+        {
+            continue;
+        }
+        ASSERT_EQ(reference.left(), m_tree->left());
+        ASSERT_EQ(reference.top(), m_tree->top());
+        ASSERT_EQ(reference.right(), m_tree->right());
+        ASSERT_EQ(reference.bottom(), m_tree->bottom());
+    }
+}
+
+TEST_F(LinearQuadTreeTest, ForEachInQuadTreeOrder)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int32_t x = rand() % c_size - c_size / 2;
+        int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference.item(x, y) = i;
+    }
+
+    std::vector<int32_t> expected;
+    reference.for_each([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+    std::vector<int32_t> actual;
+    m_tree->for_each([&](int32_t x, int32_t y, int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+}
+
+TEST_F(LinearQuadTreeTest, IteratorInQuadTreeOrder)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int32_t x = rand() % c_size - c_size / 2;
+        int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference.item(x, y) = i;
+    }
+
+    auto expected = reference.begin();
+    for (auto it = m_tree->begin(); it != m_tree->end(); ++it, ++expected)
+    {
+        ASSERT_TRUE(expected != reference.end());
+        ASSERT_EQ(expected.x(), it.x());
+        ASSERT_EQ(expected.y(), it.y());
+        ASSERT_EQ(*expected, *it);
+    }
+    ASSERT_TRUE(expected == reference.end());
+}
+
+TEST_F(LinearQuadTreeTest, QueryInQuadTreeOrder)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int32_t x = rand() % c_size - c_size / 2;
+        int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference.item(x, y) = i;
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        const int32_t x0 = rand() % c_size - c_size / 2, x1 = x0 + rand() % 100;
+        const int32_t y0 = rand() % c_size - c_size / 2, y1 = y0 + rand() % 100;
+        std::vector<int32_t> expected;
+        reference.query(x0, y0, x1, y1, [&](int32_t x, int32_t y, int& v) {
+            expected.push_back(x); expected.push_back(y); expected.push_back(v);
+        });
+        std::vector<int32_t> actual;
+        m_tree->query(x0, y0, x1, y1, [&](int32_t x, int32_t y, int& v) {
+            actual.push_back(x); actual.push_back(y); actual.push_back(v);
+        });
+        ASSERT_EQ(expected, actual);
+        ASSERT_EQ(expected.size() / 3, m_tree->count(x0, y0, x1, y1));
+    }
+}
+
+TEST_F(LinearQuadTreeTest, ParallelReduceInQuadTreeOrder)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 10000; ++i)
+    {
+        int32_t x = rand() % c_size - c_size / 2;
+        int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference.item(x, y) = i;
+    }
+
+    auto collect = [](int32_t x, int32_t y, int& v, std::vector<int32_t>& out) {
+        out.push_back(x); out.push_back(y); out.push_back(v);
+    };
+    auto concat = [](std::vector<int32_t>& result, std::vector<int32_t>& part) {
+        result.insert(result.end(), part.begin(), part.end());
+    };
+    ASSERT_EQ(reference.parallel_reduce(std::vector<int32_t>(), collect, concat),
+              m_tree->parallel_reduce(std::vector<int32_t>(), collect, concat));
+}
+
+TEST_F(LinearQuadTreeTest, AssignMatchesInsertion)
+{
+    std::vector<LinearQuadTree<int>::Item> items;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const int32_t x = rand() % c_size - c_size / 2;
+        const int32_t y = rand() % c_size - c_size / 2;
+        LinearQuadTree<int>::Item item = {x, y, i};
+        items.push_back(item);
+    }
+    QuadTree<int> reference(c_size);
+    for (auto& item : items)
+        reference.item(item.x, item.y) = item.value;
+
+    m_tree->item(100000, 100000) = -1;
+    m_tree->assign(items.begin(), items.end());
+
+    std::vector<int32_t> expected;
+    reference.visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+    std::vector<int32_t> actual;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+        ASSERT_EQ(v, *m_tree->get_item_at(x, y));
+    });
+    ASSERT_EQ(expected, actual);
+    ASSERT_EQ(expected.size() / 3, m_tree->size());
+}
+
+TEST_F(LinearQuadTreeTest, RandomOperations)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 100000; ++i)
+    {
+        size_t x = rand() % 64;
+        size_t y = rand() % 64;
+        if (rand() % 3)
+        {
+            m_tree->insert(x, y, i);
+            reference.insert(x, y, i);
+        }
+        else
+        {
+            m_tree->remove(x, y);
+            reference.remove(x, y);
+        }
+        int* expected = reference.get_item_at(x, y);
+        int* actual = m_tree->get_item_at(x, y);
+        ASSERT_EQ(nullptr == expected, nullptr == actual);
+        if (expected)
+        {
+            ASSERT_EQ(*expected, *actual);
+        }
+    }
+
+    size_t count = 0;
+    reference.for_each([&](size_t x, size_t y, int& v) {
+        ++count;
+        ASSERT_EQ(v, *m_tree->get_item_at(x, y));
+    });
+    ASSERT_EQ(count, m_tree->size());
+}
+
+TEST_F(LinearQuadTreeTest, ClearAndReuse)
+{
+    for (size_t i = 0; i < c_size; ++i)
+        m_tree->item(i, i) = i;
+    m_tree->clear();
+    ASSERT_EQ(0, m_tree->size());
+    ASSERT_TRUE(nullptr == m_tree->get_item_at(10, 10));
+    m_tree->item(10, 10) = 1;
+    ASSERT_EQ(1, *m_tree->get_item_at(10, 10));
+}
+
+TEST_F(LinearQuadTreeTest, SnapshotKeepsState)
+{
+    for (int i = 0; i < 1000; ++i)
+        m_tree->item(rand() % c_size, rand() % c_size) = i;
+    // unsorted leaves are visited in Z order as well
+    m_tree->item(-1, -1) = -1;
+    std::vector<int32_t> expected;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+    m_tree->remove(-1, -1);
+    m_tree->item(-1, -1) = -1;
+
+    LinearQuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    for (int i = 0; i < 10000; ++i)
+    {
+        const int32_t x = rand() % c_size;
+        const int32_t y = rand() % c_size;
+        if (rand() % 2)
+            m_tree->item(x, y) = -i;
+        else
+            m_tree->remove(x, y);
+    }
+    m_tree->visit([](int32_t, int32_t, int& v) {v = 0;});
+
+    std::vector<int32_t> actual;
+    snapshot.visit([&](int32_t x, int32_t y, const int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+    for (size_t i = 0; i < expected.size(); i += 3)
+        ASSERT_EQ(expected[i + 2], *snapshot.find(expected[i], expected[i + 1]));
+    ASSERT_EQ(expected.size() / 3, snapshot.size());
+}
+
+TEST_F(LinearQuadTreeTest, SnapshotSharesUntouchedLeaves)
+{
+    for (int i = 0; i < 4096; ++i)
+        m_tree->item(i % 64, i / 64) = i;
+
+    LinearQuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    const int* untouched = m_tree->find(60, 60);
+    m_tree->item(5, 5) = -1;
+    m_tree->item(100, 100) = -2;
+    m_tree->remove(7, 7);
+    EXPECT_EQ(5 * 64 + 5, *snapshot.find(5, 5));
+    EXPECT_EQ(-1, *m_tree->find(5, 5));
+    EXPECT_TRUE(nullptr == snapshot.find(100, 100));
+    EXPECT_EQ(7 * 64 + 7, *snapshot.find(7, 7));
+    EXPECT_TRUE(nullptr == m_tree->find(7, 7));
+
+    // only written pages are copied, the rest is shared
+    EXPECT_EQ(untouched, m_tree->find(60, 60));
+    size_t shared = 0;
+    snapshot.visit([&](int32_t x, int32_t y, const int& v) {
+        if (&v == m_tree->find(x, y))
+            ++shared;
+    });
+    EXPECT_LE(4096 - 3 * 256, shared);
+}
+
+TEST_F(LinearQuadTreeTest, LookupDoesntCopySharedPages)
+{
+    for (int i = 0; i < 1000; ++i)
+        m_tree->item(i, -i) = i;
+    LinearQuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    EXPECT_TRUE(nullptr == m_tree->get_item_at(1, 1));
+    EXPECT_EQ(snapshot.find(10, -10), m_tree->find(10, -10));
+    m_tree->remove(1, 1);
+    EXPECT_EQ(snapshot.find(10, -10), m_tree->find(10, -10));
+}
+
+TEST_F(LinearQuadTreeTest, PointersSurviveInsertion)
+{
+    int* item = &m_tree->item(3, 3);
+    *item = 3;
+    for (int i = 0; i < 1000; ++i)
+        m_tree->item(-i, i) = i;
+    EXPECT_EQ(item, m_tree->get_item_at(3, 3));
+    EXPECT_EQ(3, *item);
+}
+
+TEST_F(LinearQuadTreeTest, KNearestMatchesQuadTree)
+{
+    QuadTree<int> reference(c_size);
+    ASSERT_FALSE(m_tree->nearest(0, 0, [](int32_t, int32_t, int&) {}));
+    for (int i = 0; i < 2000; ++i)
+    {
+        const int32_t x = rand() % c_size - c_size / 2;
+        const int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference.item(x, y) = i;
+    }
+
+    const int32_t points[][2] = {{0, 0}, {-1, -1}, {255, 100}, {-1000, 3}, {INT32_MAX, INT32_MIN}};
+    for (const auto& p : points)
+    {
+        std::vector<int32_t> expected, actual;
+        reference.k_nearest(p[0], p[1], 50, [&](int32_t x, int32_t y, int& v) {
+            expected.push_back(x); expected.push_back(y); expected.push_back(v);
+        });
+        EXPECT_EQ(50, m_tree->k_nearest(p[0], p[1], 50, [&](int32_t x, int32_t y, int& v) {
+            actual.push_back(x); actual.push_back(y); actual.push_back(v);
+        }));
+        ASSERT_EQ(expected, actual) << p[0] << "," << p[1];
+    }
+}
+
+TEST_F(LinearQuadTreeTest, Stats)
+{
+    TreeStats stats = m_tree->stats();
+    EXPECT_EQ(0, stats.leaves);
+    EXPECT_EQ(0, stats.fill);
+
+    for (int i = 0; i < 40; ++i)
+        m_tree->item(i, -i) = i;
+    stats = m_tree->stats();
+    ASSERT_EQ(1, stats.nodes.size()) << "there are leaves only";
+    EXPECT_EQ(40, stats.nodes[0]);
+    EXPECT_EQ(40, stats.leaves);
+    EXPECT_DOUBLE_EQ(40.0 / 128, stats.fill) << "the table grows to keep load factor below 1/2";
+    EXPECT_LE(40 * (sizeof(uint64_t) + sizeof(int)) + 128 * sizeof(uint32_t), stats.bytes);
+}
+
+class LinearQuadTreeBerthBenchmark : public ::testing::Test
+{
+public:
+    static const size_t c_side      = 256;
+    static const size_t c_pillars   = 16384;
+    static const size_t c_passes    = 20;
+
+    static void SetUpTestCase()
+    {
+        m_tree.reset(new LinearQuadTree<int>(c_side));
+        x.resize(c_pillars);
+        y.resize(c_pillars);
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            x[i] = rand() % c_side;
+            y[i] = rand() % c_side;
+        }
+    }
+    static void TearDownTestCase()
+    {
+        m_tree.reset();
+    }
+protected:
+    static std::vector<size_t> x;
+    static std::vector<size_t> y;
+    static std::unique_ptr< LinearQuadTree<int> > m_tree;
+};
+
+std::vector<size_t> LinearQuadTreeBerthBenchmark::x;
+std::vector<size_t> LinearQuadTreeBerthBenchmark::y;
+std::unique_ptr< LinearQuadTree<int> > LinearQuadTreeBerthBenchmark::m_tree;
+
+TEST_F(LinearQuadTreeBerthBenchmark, InsertPerformance)
+{
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        m_tree->clear();
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            m_tree->item(x[i], y[i]) = i;
+        }
+    }
+}
+
+TEST_F(LinearQuadTreeBerthBenchmark, LookupPerformance)
+{
+    size_t found = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            found += (nullptr != m_tree->get_item_at(x[i], y[i]));
+        }
+    }
+    ASSERT_EQ(c_passes * 10 * c_pillars, found);
+}
+
+TEST_F(LinearQuadTreeBerthBenchmark, ForEachPerformance)
+{
+    size_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        m_tree->for_each([&](size_t, size_t, int& v){ sum += v; });
+    }
+    ASSERT_NE(0, sum);
+}
+
+TEST_F(LinearQuadTreeBerthBenchmark, VisitPerformance)
+{
+    size_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        m_tree->visit([&](int32_t, int32_t, int& v){ sum += v; });
+    }
+    ASSERT_NE(0, sum);
+}
+// eof
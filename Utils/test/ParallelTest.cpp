@@ -0,0 +1,57 @@
+#include "Parallel.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace Utils;
+
+TEST(ParallelTest, EveryTaskRunsOnce)
+{
+    for (size_t threads = 1; threads <= 8; threads *= 2)
+    {
+        std::vector< std::atomic<int> > runs(1000);
+        for (auto& r : runs)
+            r = 0;
+        parallel_tasks(runs.size(), [&](size_t i) {++runs[i];}, threads);
+        for (size_t i = 0; i < runs.size(); ++i)
+            ASSERT_EQ(1, runs[i]) << "task " << i << ", threads " << threads;
+    }
+}
+
+TEST(ParallelTest, NoTasks)
+{
+    ASSERT_NO_THROW(parallel_tasks(0, [](size_t) {FAIL();}, 4));
+}
+
+TEST(ParallelTest, ExceptionIsRethrown)
+{
+    std::atomic<int> runs(0);
+    ASSERT_THROW(parallel_tasks(100, [&](size_t i)
+    {
+        ++runs;
+        if (i == 10)
+            throw std::runtime_error("task failed");
+    }, 4), std::runtime_error);
+    ASSERT_GE(runs, 11);
+}
+
+TEST(ParallelTest, ReduceInTasksOrder)
+{
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < 1000; ++i)
+        expected.push_back(i);
+
+    std::vector<size_t> actual = parallel_reduce_tasks(expected.size(), std::vector<size_t>(),
+        [](size_t i, std::vector<size_t>& out) {out.push_back(i);},
+        [](std::vector<size_t>& result, std::vector<size_t>& part) {result.insert(result.end(), part.begin(), part.end());},
+        4);
+    ASSERT_EQ(expected, actual);
+
+    const bool found = parallel_reduce_tasks(100, false,
+        [](size_t i, bool& out) {out = out || (i == 50);},
+        [](bool& result, bool part) {result = result || part;},
+        4);
+    ASSERT_TRUE(found);
+}
+// eof
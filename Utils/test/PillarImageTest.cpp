@@ -0,0 +1,183 @@
+#include "PillarImage.h"
+#include "MappedFile.h"
+#include "QuadTree.h"
+#include "LinearQuadTree.h"
+#include "RangeList.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+
+using namespace Utils;
+
+typedef RangeList<int> Pillar;
+
+class PillarImageTest : public ::testing::Test
+{
+public:
+    static const int c_size = 256;
+    void SetUp()
+    {
+        m_tree.reset(new QuadTree<Pillar>(c_size));
+        for (int i = 0; i < 5000; ++i)
+        {
+            const int32_t x = rand() % c_size - c_size / 2;
+            const int32_t y = rand() % c_size - c_size / 2;
+            m_tree->item(x, y).insert(rand() % 64, i);
+        }
+    }
+    void TearDown()
+    {
+        m_tree.reset();
+    }
+protected:
+    // image in 8 bytes aligned memory
+    std::vector<uint64_t> MakeImage()
+    {
+        std::ostringstream out;
+        PillarImage<int>::write(out, *m_tree);
+        const std::string bytes = out.str();
+        std::vector<uint64_t> image((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        memcpy(image.data(), bytes.data(), bytes.size());
+        m_imageSize = bytes.size();
+        return image;
+    }
+
+    template <class Map>
+    std::vector<int32_t> Items(Map& map)
+    {
+        std::vector<int32_t> items;
+        map.visit([&](int32_t x, int32_t y, Pillar& pillar) {
+            pillar.visit([&](size_t index, int& v) {
+                items.push_back(x); items.push_back(y); items.push_back(static_cast<int32_t>(index)); items.push_back(v);
+            });
+        });
+        return items;
+    }
+
+    std::unique_ptr< QuadTree<Pillar> > m_tree;
+    size_t m_imageSize;
+};
+
+const int PillarImageTest::c_size;
+
+TEST_F(PillarImageTest, QueryInPlace)
+{
+    const std::vector<int32_t> expected = Items(*m_tree);
+    const std::vector<uint64_t> data = MakeImage();
+    PillarImage<int> image;
+    ASSERT_TRUE(image.attach(data.data(), m_imageSize));
+    ASSERT_EQ(expected.size() / 4, image.values());
+    ASSERT_EQ(m_tree->count(INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX), image.pillars());
+
+    std::vector<int32_t> actual;
+    image.visit([&](int32_t x, int32_t y, size_t index, const int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(static_cast<int32_t>(index)); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+
+    for (size_t i = 0; i < expected.size(); i += 4)
+    {
+        const int* item = image.find(expected[i], expected[i + 1], expected[i + 2]);
+        ASSERT_TRUE(nullptr != item);
+        ASSERT_EQ(expected[i + 3], *item);
+    }
+    ASSERT_TRUE(nullptr == image.find(c_size, c_size, 0));
+    ASSERT_TRUE(nullptr == image.find(expected[0], expected[1], 64));
+
+    std::vector<int32_t> region;
+    m_tree->query(-10, -20, 30, 5, [&](int32_t x, int32_t y, Pillar& pillar) {
+        pillar.visit([&](size_t index, int& v) {
+            region.push_back(x); region.push_back(y); region.push_back(static_cast<int32_t>(index)); region.push_back(v);
+        });
+    });
+    actual.clear();
+    image.query(-10, -20, 30, 5, [&](int32_t x, int32_t y, size_t index, const int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(static_cast<int32_t>(index)); actual.push_back(v);
+    });
+    ASSERT_FALSE(region.empty());
+    ASSERT_EQ(region, actual);
+}
+
+TEST_F(PillarImageTest, Inflate)
+{
+    const std::vector<int32_t> expected = Items(*m_tree);
+    const std::vector<uint64_t> data = MakeImage();
+    PillarImage<int> image;
+    ASSERT_TRUE(image.attach(data.data(), m_imageSize));
+
+    QuadTree<Pillar> tree;
+    tree.item(1000, 1000).insert(0, 0);
+    image.inflate(tree);
+    ASSERT_EQ(expected, Items(tree));
+
+    LinearQuadTree<Pillar> linear;
+    image.inflate(linear, [](const int& v) {return v;});
+    ASSERT_EQ(expected, Items(linear));
+}
+
+TEST_F(PillarImageTest, WriteSnapshot)
+{
+    const std::vector<uint64_t> expected = MakeImage();
+    QuadTree<Pillar>::Snapshot snapshot = m_tree->snapshot();
+    m_tree->item(0, 0).insert(100, -1);
+
+    std::ostringstream out;
+    PillarImage<int>::write(out, snapshot);
+    const std::string bytes = out.str();
+    ASSERT_EQ(m_imageSize, bytes.size());
+    ASSERT_EQ(0, memcmp(expected.data(), bytes.data(), bytes.size()));
+}
+
+TEST_F(PillarImageTest, RejectWrongImage)
+{
+    std::vector<uint64_t> data = MakeImage();
+    PillarImage<int> image;
+    ASSERT_FALSE(image.attach(data.data(), m_imageSize - 1));
+    ASSERT_FALSE(image.attach(data.data(), 8));
+    PillarImage<int64_t> other;
+    ASSERT_FALSE(other.attach(data.data(), m_imageSize)) << "size of items is different";
+    reinterpret_cast<uint32_t*>(data.data())[1] = PillarImage<int>::c_version + 1;
+    ASSERT_FALSE(image.attach(data.data(), m_imageSize)) << "unknown version";
+    ASSERT_FALSE(image.attached());
+}
+
+TEST_F(PillarImageTest, EmptyMap)
+{
+    m_tree->clear();
+    const std::vector<uint64_t> data = MakeImage();
+    PillarImage<int> image;
+    ASSERT_TRUE(image.attach(data.data(), m_imageSize));
+    ASSERT_EQ(0, image.pillars());
+    ASSERT_TRUE(nullptr == image.find(0, 0, 0));
+    LinearQuadTree<Pillar> linear;
+    linear.item(1, 1);
+    image.inflate(linear);
+    ASSERT_EQ(0, linear.size());
+}
+
+TEST_F(PillarImageTest, MappedFile)
+{
+    const std::vector<int32_t> expected = Items(*m_tree);
+    const char* path = "PillarImageTest.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        PillarImage<int>::write(file, *m_tree);
+    }
+
+    MappedFile file;
+    ASSERT_TRUE(file.open(path));
+    PillarImage<int> image;
+    ASSERT_TRUE(image.attach(file.data(), file.size()));
+    QuadTree<Pillar> tree;
+    image.inflate(tree);
+    EXPECT_EQ(expected, Items(tree));
+    file.close();
+    std::remove(path);
+
+    ASSERT_FALSE(file.open(path));
+}
+
+// eof
@@ -2,6 +2,9 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <thread>
 
 using namespace Utils;
 
@@ -21,6 +24,8 @@ protected:
     std::unique_ptr< QuadTree<int> > m_tree;
 };
 
+const size_t QuadTreeTest::c_size;
+
 TEST_F(QuadTreeTest, EmptyItem)
 {
     ASSERT_TRUE( nullptr == m_tree->get_item_at(254, 400) );
@@ -178,6 +183,502 @@ TEST_F(QuadTreeTest, ForEachUpdateItems)
         ASSERT_EQ(100, *m_tree->get_item_at(i, i)) << "update for_each element failed on [" << i << "," << i << "]th";
 }
 
+TEST_F(QuadTreeTest, ClearAndReuse)
+{
+    for (size_t i = 0; i < c_size; ++i)
+        m_tree->item(i, c_size - i - 1) = i;
+
+    m_tree->clear();
+    for (size_t i = 0; i < c_size; ++i)
+        ASSERT_TRUE(nullptr == m_tree->get_item_at(i, c_size - i - 1));
+
+    for (size_t i = 0; i < c_size; ++i)
+        m_tree->item(i, i) = i;
+    for (size_t i = 0; i < c_size; ++i)
+        ASSERT_EQ(i, *m_tree->get_item_at(i, i)) << "item reinserted after clear is incorrect on [" << i << "," << i << "]th";
+}
+
+TEST_F(QuadTreeTest, RemoveAndReinsert)
+{
+    for (size_t i = 0; i < c_size; ++i)
+        m_tree->item(i, i) = i;
+    for (size_t i = 0; i < c_size; i += 2)
+        m_tree->remove(i, i);
+    for (size_t i = 0; i < c_size; i += 2)
+        m_tree->item(i, 0) = i;
+
+    for (size_t i = 1; i < c_size; i += 2)
+        ASSERT_EQ(i, *m_tree->get_item_at(i, i));
+    for (size_t i = 2; i < c_size; i += 2)
+    {
+        ASSERT_TRUE(nullptr == m_tree->get_item_at(i, i));
+        ASSERT_EQ(i, *m_tree->get_item_at(i, 0));
+    }
+}
+
+TEST_F(QuadTreeTest, NegativeCoordinates)
+{
+    m_tree->item(-1, -1) = 1;
+    m_tree->item(-1000, 5) = 2;
+    m_tree->item(7, -100000) = 3;
+    ASSERT_EQ(1, *m_tree->get_item_at(-1, -1));
+    ASSERT_EQ(2, *m_tree->get_item_at(-1000, 5));
+    ASSERT_EQ(3, *m_tree->get_item_at(7, -100000));
+    ASSERT_TRUE(nullptr == m_tree->get_item_at(1, 1));
+    ASSERT_TRUE(nullptr == m_tree->get_item_at(-100000, 7));
+
+    EXPECT_EQ(-1000, m_tree->left());
+    EXPECT_EQ(-100000, m_tree->top());
+    EXPECT_EQ(8, m_tree->right());
+    EXPECT_EQ(6, m_tree->bottom());
+}
+
+TEST_F(QuadTreeTest, ExtremeCoordinates)
+{
+    m_tree->item(INT32_MIN, INT32_MIN) = 1;
+    m_tree->item(INT32_MAX, INT32_MAX) = 2;
+    ASSERT_EQ(1, *m_tree->get_item_at(INT32_MIN, INT32_MIN));
+    ASSERT_EQ(2, *m_tree->get_item_at(INT32_MAX, INT32_MAX));
+    EXPECT_EQ(INT32_MIN, m_tree->left());
+    EXPECT_EQ(INT32_MIN, m_tree->top());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->right());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->bottom());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->snapshot().right());
+
+    int count = 0;
+    m_tree->for_each([&](int32_t x, int32_t y, int& v)
+    {
+        EXPECT_EQ(x, y);
+        EXPECT_EQ((count ? INT32_MAX : INT32_MIN), x);
+        EXPECT_EQ(++count, v);
+    });
+    EXPECT_EQ(2, count);
+}
+
+TEST_F(QuadTreeTest, GrowAndShrink)
+{
+    const uint64_t initialSide = m_tree->side();
+    m_tree->item(0, 0) = 1;
+    m_tree->item(-3, 2) = 2;
+    EXPECT_EQ(initialSide, m_tree->side()) << "items fit to the initial area";
+
+    m_tree->item(100000, 0) = 3;
+    EXPECT_LE(200000u, m_tree->side()) << "tree should grow to fit far items";
+    ASSERT_EQ(1, *m_tree->get_item_at(0, 0));
+    ASSERT_EQ(2, *m_tree->get_item_at(-3, 2));
+
+    m_tree->remove(100000, 0);
+    EXPECT_EQ(initialSide, m_tree->side()) << "tree should shrink back when far items are removed";
+    ASSERT_EQ(1, *m_tree->get_item_at(0, 0));
+    ASSERT_EQ(2, *m_tree->get_item_at(-3, 2));
+    ASSERT_TRUE(nullptr == m_tree->get_item_at(100000, 0));
+}
+
+TEST(QuadTreeGrowingTest, DepthDependsOnExtent)
+{
+    QuadTree<int> tree;
+    tree.item(0, 0) = 1;
+    tree.item(-1, -1) = 1;
+    EXPECT_EQ(2, tree.side());
+    tree.item(3, 0) = 1;
+    EXPECT_EQ(8, tree.side());
+    tree.remove(3, 0);
+    EXPECT_EQ(2, tree.side());
+    tree.clear();
+    EXPECT_TRUE(tree.empty());
+    EXPECT_EQ(0, tree.left());
+    EXPECT_EQ(0, tree.right());
+}
+
+TEST_F(QuadTreeTest, BoundingRectAfterRandomOperations)
+{
+    std::vector<std::pair<int32_t, int32_t> > items;
+    for (int i = 0; i < 10000; ++i)
+    {
+        if (items.empty() || rand() % 3)
+        {
+            const int32_t x = rand() % (4 * c_size) - 2 * c_size;
+            const int32_t y = rand() % (4 * c_size) - 2 * c_size;
+            if (!m_tree->get_item_at(x, y))
+                items.push_back(std::make_pair(x, y));
+            m_tree->item(x, y) = i;
+        }
+        else
+        {
+            const size_t index = rand() % items.size();
+            m_tree->remove(items[index].first, items[index].second);
+            items[index] = items.back();
+            items.pop_back();
+        }
+
+        int32_t left = INT32_MAX, top = INT32_MAX, right = INT32_MIN, bottom = INT32_MIN;
+        for (auto& item : items)
+        {
+            left   = std::min(left, item.first);
+            top    = std::min(top, item.second);
+            right  = std::max(right, item.first + 1);
+            bottom = std::max(bottom, item.second + 1);
+        }
+        if (items.empty())
+            left = top = right = bottom = 0;
+        ASSERT_EQ(left, m_tree->left()) << "step " << i;
+        ASSERT_EQ(top, m_tree->top()) << "step " << i;
+        ASSERT_EQ(right, m_tree->right()) << "step " << i;
+        ASSERT_EQ(bottom, m_tree->bottom()) << "step " << i;
+    }
+}
+
+TEST_F(QuadTreeTest, IteratorVisitsForEachOrder)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = i;
+    }
+    m_tree->item(-1000000, 1000000) = -1;
+
+    std::vector<int32_t> expected;
+    m_tree->for_each([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+
+    std::vector<int32_t> visited;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        visited.push_back(x); visited.push_back(y); visited.push_back(v);
+    });
+    ASSERT_EQ(expected, visited);
+
+    std::vector<int32_t> iterated;
+    for (auto it = m_tree->begin(); it != m_tree->end(); ++it)
+    {
+        iterated.push_back(it.x()); iterated.push_back(it.y()); iterated.push_back(*it);
+    }
+    ASSERT_EQ(expected, iterated);
+}
+
+TEST_F(QuadTreeTest, IteratorUpdateItems)
+{
+    ASSERT_TRUE(m_tree->begin() == m_tree->end());
+    for (size_t i = 0; i < c_size; ++i)
+        m_tree->item(i, i) = 10;
+
+    for (auto& v : *m_tree)
+        v = 100;
+
+    for (size_t i = 0; i < c_size; ++i)
+        ASSERT_EQ(100, *m_tree->get_item_at(i, i));
+}
+
+TEST_F(QuadTreeTest, QueryRegion)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = i;
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        const int32_t x0 = rand() % c_size - c_size / 2, x1 = x0 + rand() % 100;
+        const int32_t y0 = rand() % c_size - c_size / 2, y1 = y0 + rand() % 100;
+        std::vector<int32_t> expected;
+        m_tree->visit([&](int32_t x, int32_t y, int& v) {
+            if (x0 <= x && x < x1 && y0 <= y && y < y1)
+            {
+                expected.push_back(x); expected.push_back(y); expected.push_back(v);
+            }
+        });
+        std::vector<int32_t> actual;
+        m_tree->query(x0, y0, x1, y1, [&](int32_t x, int32_t y, int& v) {
+            actual.push_back(x); actual.push_back(y); actual.push_back(v);
+        });
+        ASSERT_EQ(expected, actual) << "[" << x0 << "," << y0 << "] - [" << x1 << "," << y1 << "]";
+        ASSERT_EQ(expected.size() / 3, m_tree->count(x0, y0, x1, y1));
+    }
+}
+
+TEST_F(QuadTreeTest, QueryOutOfArea)
+{
+    m_tree->item(0, 0) = 1;
+    EXPECT_EQ(0, m_tree->count(INT32_MIN, INT32_MIN, -1, -1));
+    EXPECT_EQ(0, m_tree->count(1, 1, INT32_MAX, INT32_MAX));
+    EXPECT_EQ(0, m_tree->count(0, 0, 0, 1)) << "empty rect";
+    EXPECT_EQ(1, m_tree->count(INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX));
+}
+
+TEST_F(QuadTreeTest, AssignMatchesInsertion)
+{
+    std::vector<QuadTree<int>::Item> items;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const int32_t x = rand() % (4 * c_size) - 2 * c_size;
+        const int32_t y = rand() % c_size - c_size / 2;
+        QuadTree<int>::Item item = {x, y, i};
+        items.push_back(item);
+    }
+    QuadTree<int> reference(c_size);
+    for (auto& item : items)
+        reference.item(item.x, item.y) = item.value;
+
+    std::vector<int32_t> expected;
+    reference.visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+
+    // unsorted input, then the sorted one
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        m_tree->item(100000, 100000) = -1;
+        m_tree->assign(items.begin(), items.end());
+
+        std::vector<int32_t> actual;
+        m_tree->visit([&](int32_t x, int32_t y, int& v) {
+            actual.push_back(x); actual.push_back(y); actual.push_back(v);
+        });
+        ASSERT_EQ(expected, actual);
+        ASSERT_EQ(reference.side(), m_tree->side());
+        ASSERT_EQ(reference.left(), m_tree->left());
+        ASSERT_EQ(reference.top(), m_tree->top());
+        ASSERT_EQ(reference.right(), m_tree->right());
+        ASSERT_EQ(reference.bottom(), m_tree->bottom());
+
+        items.clear();
+        for (size_t i = 0; i < expected.size(); i += 3)
+        {
+            QuadTree<int>::Item item = {expected[i], expected[i + 1], expected[i + 2]};
+            items.push_back(item);
+        }
+    }
+
+    // the loaded tree is a regular one
+    m_tree->remove(items.front().x, items.front().y);
+    reference.remove(items.front().x, items.front().y);
+    ASSERT_EQ(reference.left(), m_tree->left());
+    ASSERT_EQ(reference.top(), m_tree->top());
+    m_tree->item(-100000, 5) = 1;
+    ASSERT_EQ(-100000, m_tree->left());
+}
+
+TEST_F(QuadTreeTest, AssignEmpty)
+{
+    m_tree->item(1, 1) = 1;
+    std::vector<QuadTree<int>::Item> items;
+    m_tree->assign(items.begin(), items.end());
+    ASSERT_TRUE(m_tree->empty());
+}
+
+TEST_F(QuadTreeTest, ParallelForEach)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = i;
+    }
+
+    std::vector<int32_t> expected;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+        v = -v;
+    });
+
+    m_tree->parallel_for_each([&](int32_t, int32_t, int& v) {v = -v;});
+    for (size_t i = 0; i < expected.size(); i += 3)
+        ASSERT_EQ(expected[i + 2], *m_tree->get_item_at(expected[i], expected[i + 1]));
+
+    for (size_t depth = 0; depth < 5; ++depth)
+    {
+        std::vector<int32_t> actual = m_tree->parallel_reduce(std::vector<int32_t>(),
+            [&](int32_t x, int32_t y, int& v, std::vector<int32_t>& out) {
+                out.push_back(x); out.push_back(y); out.push_back(v);
+            },
+            [](std::vector<int32_t>& result, std::vector<int32_t>& part) {
+                result.insert(result.end(), part.begin(), part.end());
+            }, depth);
+        ASSERT_EQ(expected, actual) << "split depth " << depth;
+    }
+}
+
+TEST_F(QuadTreeTest, SnapshotKeepsState)
+{
+    std::map<std::pair<int32_t, int32_t>, int> reference;
+    for (int i = 0; i < 2000; ++i)
+    {
+        const int32_t x = rand() % c_size - c_size / 2;
+        const int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference[std::make_pair(x, y)] = i;
+    }
+    std::vector<int32_t> expected;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+    const int64_t extents[4] = {m_tree->left(), m_tree->top(), m_tree->right(), m_tree->bottom()};
+
+    QuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    for (int i = 0; i < 20000; ++i)
+    {
+        // the area grows and shrinks as well
+        const int32_t x = rand() % (8 * c_size) - 4 * c_size;
+        const int32_t y = rand() % c_size - c_size / 2;
+        if (rand() % 2)
+        {
+            m_tree->item(x, y) = -i;
+            reference[std::make_pair(x, y)] = -i;
+        }
+        else
+        {
+            m_tree->remove(x, y);
+            reference.erase(std::make_pair(x, y));
+        }
+        if (i % 1000 == 0)
+        {
+            // released snapshots don't affect the tree
+            QuadTree<int>::Snapshot temporary = m_tree->snapshot();
+            m_tree->parallel_for_each([](int32_t, int32_t, int& v) {v *= 2;});
+            m_tree->visit([](int32_t, int32_t, int& v) {v /= 2;});
+        }
+    }
+
+    std::vector<int32_t> actual;
+    snapshot.visit([&](int32_t x, int32_t y, const int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+    for (size_t i = 0; i < expected.size(); i += 3)
+        ASSERT_EQ(expected[i + 2], *snapshot.find(expected[i], expected[i + 1]));
+    EXPECT_EQ(extents[0], snapshot.left());
+    EXPECT_EQ(extents[1], snapshot.top());
+    EXPECT_EQ(extents[2], snapshot.right());
+    EXPECT_EQ(extents[3], snapshot.bottom());
+
+    size_t count = 0;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        ++count;
+        ASSERT_EQ(reference[std::make_pair(x, y)], v);
+    });
+    ASSERT_EQ(reference.size(), count);
+}
+
+TEST_F(QuadTreeTest, SnapshotOutlivesTree)
+{
+    for (int i = 0; i < 1000; ++i)
+        m_tree->item(i, -i) = i;
+    QuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    m_tree->clear();
+    m_tree.reset();
+
+    size_t count = 0;
+    snapshot.visit([&](int32_t x, int32_t y, const int& v) {
+        ++count;
+        ASSERT_EQ(x, v);
+        ASSERT_EQ(-y, v);
+    });
+    ASSERT_EQ(1000, count);
+}
+
+TEST_F(QuadTreeTest, SnapshotReadByAnotherThread)
+{
+    for (int i = 0; i < 10000; ++i)
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = 1;
+    size_t expected = 0;
+    m_tree->visit([&](int32_t, int32_t, int& v) {expected += v;});
+
+    QuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    size_t actual = 0;
+    std::thread reader([&]()
+    {
+        for (int pass = 0; pass < 10; ++pass)
+        {
+            actual = 0;
+            snapshot.visit([&](int32_t, int32_t, const int& v) {actual += v;});
+        }
+    });
+    for (int i = 0; i < 100000; ++i)
+    {
+        const int32_t x = rand() % c_size - c_size / 2;
+        const int32_t y = rand() % c_size - c_size / 2;
+        if (rand() % 2)
+            m_tree->item(x, y) = 2;
+        else
+            m_tree->remove(x, y);
+    }
+    reader.join();
+    ASSERT_EQ(expected, actual);
+}
+
+TEST_F(QuadTreeTest, KNearestMatchesBruteForce)
+{
+    for (int i = 0; i < 2000; ++i)
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = i;
+
+    // items sorted by the distance, ties in for_each order
+    auto brute = [&](int32_t px, int32_t py, size_t k)
+    {
+        std::vector< std::pair<int64_t, int> > items;
+        m_tree->visit([&](int32_t x, int32_t y, int& v) {
+            items.push_back(std::make_pair(int64_t(x - px) * (x - px) + int64_t(y - py) * (y - py), v));
+        });
+        std::stable_sort(items.begin(), items.end(), [](const std::pair<int64_t, int>& a, const std::pair<int64_t, int>& b) {return a.first < b.first;});
+        items.resize(std::min(k, items.size()));
+        return items;
+    };
+
+    const int32_t points[][2] = {{0, 0}, {-256, -256}, {255, 100}, {-1000, 3}, {70000, -70000}};
+    for (const auto& p : points)
+    {
+        for (size_t k : {size_t(1), size_t(7), size_t(100)})
+        {
+            std::vector< std::pair<int64_t, int> > actual;
+            const size_t found = m_tree->k_nearest(p[0], p[1], k, [&](int32_t x, int32_t y, int& v) {
+                actual.push_back(std::make_pair(int64_t(x - p[0]) * (x - p[0]) + int64_t(y - p[1]) * (y - p[1]), v));
+            });
+            EXPECT_EQ(k, found);
+            ASSERT_EQ(brute(p[0], p[1], k), actual) << p[0] << "," << p[1] << " k=" << k;
+        }
+    }
+}
+
+TEST_F(QuadTreeTest, NearestWithSnapshot)
+{
+    int32_t nx = 0, ny = 0;
+    ASSERT_FALSE(m_tree->nearest(0, 0, [&](int32_t, int32_t, int&) {}));
+
+    m_tree->insert(10, 10, 1);
+    m_tree->insert(-20, 5, 2);
+    QuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    ASSERT_TRUE(m_tree->nearest(-12, 0, [&](int32_t x, int32_t y, int& v) {nx = x; ny = y; v = 3;}));
+    EXPECT_EQ(-20, nx);
+    EXPECT_EQ(5, ny);
+    EXPECT_EQ(3, *m_tree->get_item_at(-20, 5));
+    EXPECT_EQ(2, *snapshot.find(-20, 5)) << "the item is written to the tree only";
+    EXPECT_EQ(2, m_tree->k_nearest(0, 0, 5, [](int32_t, int32_t, int&) {}));
+}
+
+TEST_F(QuadTreeTest, Stats)
+{
+    TreeStats stats = m_tree->stats();
+    ASSERT_EQ(10, stats.nodes.size()) << "root and 9 levels of 512x512 tree";
+    EXPECT_EQ(1, stats.nodes[0]);
+    EXPECT_EQ(0, stats.leaves);
+    EXPECT_EQ(0, stats.fill);
+
+    // neighbours share the whole path, the opposite corner makes the second one
+    m_tree->insert(-256, -256, 1);
+    m_tree->insert(-255, -256, 2);
+    m_tree->insert(255, 255, 3);
+    stats = m_tree->stats();
+    EXPECT_EQ(1, stats.nodes[0]);
+    for (size_t level = 1; level < 9; ++level)
+        EXPECT_EQ(2, stats.nodes[level]) << level;
+    EXPECT_EQ(3, stats.leaves);
+    EXPECT_DOUBLE_EQ((2 * 8 + 3) / (4.0 * (1 + 2 * 8)), stats.fill);
+    EXPECT_LE(19 * sizeof(int), stats.bytes);
+
+    // nodes shared with a snapshot are counted once
+    QuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    m_tree->remove(255, 255);
+    stats = m_tree->stats();
+    EXPECT_EQ(1, stats.nodes[1]);
+    EXPECT_EQ(2, stats.leaves);
+}
+
 class QuadTreeBenchmark : public ::testing::Test
 {
 public:
@@ -274,4 +775,189 @@ TEST_F(QuadTreeBenchmark, AllOperations)
         }
     }
 }
+
+// benchmark on the berth sized tree (see Core::m_pillars): the tree is
+// repeatedly filled with scattered pillars and cleared, nodes are reused
+class QuadTreeBerthBenchmark : public ::testing::Test
+{
+public:
+    static const size_t c_side      = 256;
+    static const size_t c_pillars   = 16384;
+    static const size_t c_passes    = 20;
+
+    static void SetUpTestCase()
+    {
+        m_tree.reset(new QuadTree<int>(c_side));
+        x.resize(c_pillars);
+        y.resize(c_pillars);
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            x[i] = rand() % c_side;
+            y[i] = rand() % c_side;
+        }
+    }
+    static void TearDownTestCase()
+    {
+        m_tree.reset();
+    }
+protected:
+    static std::vector<size_t> x;
+    static std::vector<size_t> y;
+    static std::unique_ptr< QuadTree<int> > m_tree;
+};
+
+std::vector<size_t> QuadTreeBerthBenchmark::x;
+std::vector<size_t> QuadTreeBerthBenchmark::y;
+std::unique_ptr< QuadTree<int> > QuadTreeBerthBenchmark::m_tree;
+
+TEST_F(QuadTreeBerthBenchmark, InsertPerformance)
+{
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        m_tree->clear();
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            m_tree->item(x[i], y[i]) = i;
+        }
+    }
+}
+
+TEST_F(QuadTreeBerthBenchmark, AssignPerformance)
+{
+    std::vector<QuadTree<int>::Item> items;
+    for (size_t i = 0; i < c_pillars; ++i)
+    {
+        QuadTree<int>::Item item = {static_cast<int32_t>(x[i]), static_cast<int32_t>(y[i]), static_cast<int>(i)};
+        items.push_back(item);
+    }
+    // pillars come in Morton order from a file
+    QuadTree<int> sorted(c_side);
+    sorted.assign(items.begin(), items.end());
+    items.clear();
+    sorted.visit([&](int32_t x, int32_t y, int& v) {
+        QuadTree<int>::Item item = {x, y, v};
+        items.push_back(item);
+    });
+
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        m_tree->assign(items.begin(), items.end());
+    }
+}
+
+TEST_F(QuadTreeBerthBenchmark, LookupPerformance)
+{
+    size_t found = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            found += (nullptr != m_tree->get_item_at(x[i], y[i]));
+        }
+    }
+    ASSERT_EQ(c_passes * 10 * c_pillars, found);
+}
+
+TEST_F(QuadTreeBerthBenchmark, ForEachPerformance)
+{
+    size_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        m_tree->for_each([&](size_t, size_t, int& v){ sum += v; });
+    }
+    ASSERT_NE(0, sum);
+}
+
+TEST_F(QuadTreeBerthBenchmark, VisitPerformance)
+{
+    size_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        m_tree->visit([&](int32_t, int32_t, int& v){ sum += v; });
+    }
+    ASSERT_NE(0, sum);
+}
+
+TEST_F(QuadTreeBerthBenchmark, IteratorPerformance)
+{
+    size_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        for (auto it = m_tree->begin(), end = m_tree->end(); it != end; ++it)
+            sum += *it;
+    }
+    ASSERT_NE(0, sum);
+}
+
+TEST_F(QuadTreeBerthBenchmark, FootprintLookupPerformance)
+{
+    size_t found = 0;
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        for (size_t i = 0; i < c_pillars; ++i)
+            for (size_t dx = 0; dx < 3; ++dx)
+                for (size_t dy = 0; dy < 3; ++dy)
+                    found += (nullptr != m_tree->get_item_at(x[i] + dx, y[i] + dy));
+    }
+    ASSERT_NE(0, found);
+}
+
+TEST_F(QuadTreeBerthBenchmark, FootprintQueryPerformance)
+{
+    size_t found = 0;
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        for (size_t i = 0; i < c_pillars; ++i)
+            found += m_tree->count(x[i], y[i], x[i] + 3, y[i] + 3);
+    }
+    ASSERT_NE(0, found);
+}
+
+// pillar visit with some work to do, like mesh generation
+static void process_pillar(int& v)
+{
+    for (int i = 0; i < 1000; ++i)
+        v = v * 1103515245 + 12345;
+}
+
+TEST_F(QuadTreeBerthBenchmark, HeavyVisitPerformance)
+{
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        m_tree->visit([&](int32_t, int32_t, int& v){ process_pillar(v); });
+    }
+}
+
+TEST_F(QuadTreeBerthBenchmark, HeavyParallelForEachPerformance)
+{
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        m_tree->parallel_for_each([&](int32_t, int32_t, int& v){ process_pillar(v); });
+    }
+}
+
+TEST_F(QuadTreeBerthBenchmark, BoundingRectPerformance)
+{
+    size_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 1000; ++pass)
+    {
+        sum += m_tree->left() + m_tree->top() + m_tree->right() + m_tree->bottom();
+    }
+    ASSERT_NE(0, sum);
+}
+
+TEST_F(QuadTreeBerthBenchmark, RemovePerformance)
+{
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            m_tree->remove(x[i], y[i]);
+        }
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            m_tree->item(x[i], y[i]) = i;
+        }
+    }
+}
 // eof
\ No newline at end of file
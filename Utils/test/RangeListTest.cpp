@@ -2,6 +2,8 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <map>
+#include <vector>
+#include <numeric>
 
 using namespace Utils;
 
@@ -208,4 +210,352 @@ TEST_F(RangeVectorTest, ForEachItemsUpdate)
     }
 }
 
+TEST_F(RangeVectorTest, Iterators)
+{
+    ASSERT_TRUE(m_ranges->begin() == m_ranges->end());
+    ASSERT_TRUE(m_ranges->ranges().begin() == m_ranges->ranges().end());
+
+    // the inline range
+    m_ranges->insert(5, 50);
+    m_ranges->insert(6, 60);
+    auto it = m_ranges->begin();
+    ASSERT_EQ(5, it.index());
+    ASSERT_EQ(50, *it);
+    ++it;
+    ASSERT_EQ(6, it.index());
+    ASSERT_EQ(60, *it);
+    ASSERT_TRUE(++it == m_ranges->end());
+
+    // ranges of the vector
+    m_ranges->insert(10, 100);
+    m_ranges->insert(20, 200);
+    std::vector<size_t> indices;
+    for (auto i = m_ranges->begin(); i != m_ranges->end(); ++i)
+    {
+        indices.push_back(i.index());
+        *i += 1;
+    }
+    const size_t expected[] = {5, 6, 10, 20};
+    ASSERT_EQ(std::vector<size_t>(expected, expected + 4), indices);
+
+    int sum = 0;
+    for (int v : *m_ranges)
+        sum += v;
+    ASSERT_EQ(51 + 61 + 101 + 201, sum);
+}
+
+TEST_F(RangeVectorTest, Spans)
+{
+    for (size_t i = 0; i < 10; ++i)
+        m_ranges->insert(i, static_cast<int>(i));
+    for (size_t i = 20; i < 25; ++i)
+        m_ranges->insert(i, static_cast<int>(i));
+
+    std::vector<size_t> shape;
+    for (auto range : m_ranges->ranges())
+    {
+        shape.push_back(range.start);
+        shape.push_back(range.count);
+        for (int& v : range)
+            v *= 2;
+    }
+    const size_t expected[] = {0, 10, 20, 5};
+    ASSERT_EQ(std::vector<size_t>(expected, expected + 4), shape);
+    ASSERT_EQ(48, *m_ranges->get_item_at(24));
+
+    const RangeList<int>& ranges = *m_ranges;
+    int sum = 0;
+    for (auto range : ranges.ranges())
+        sum += std::accumulate(range.begin(), range.end(), 0);
+    ASSERT_EQ(2 * (45 + 110), sum);
+}
+
+TEST_F(RangeVectorTest, Stats)
+{
+    RangeStats stats = m_ranges->stats();
+    EXPECT_EQ(0, stats.ranges);
+    EXPECT_EQ(0, stats.bytes);
+
+    for (size_t i = 0; i < 10; ++i)
+        m_ranges->insert(i, 1);
+    m_ranges->insert(20, 2);
+    m_ranges->remove(5);
+    stats = m_ranges->stats();
+    EXPECT_EQ(3, stats.ranges);
+    EXPECT_EQ(10, stats.items);
+    EXPECT_LE(stats.items, stats.capacity);
+    EXPECT_EQ(stats.capacity - stats.items, stats.slack());
+    EXPECT_LE(stats.capacity * sizeof(int), stats.bytes);
+
+    RangeStats sum;
+    sum += stats;
+    sum += stats;
+    EXPECT_EQ(6, sum.ranges);
+    EXPECT_EQ(2 * stats.bytes, sum.bytes);
+}
+
+TEST_F(RangeVectorTest, RemoveEdges)
+{
+    for (size_t i = 10; i < 15; ++i)
+        m_ranges->insert(i, static_cast<int>(i));
+    m_ranges->remove(15);
+    m_ranges->remove(9);
+    ASSERT_EQ(1, m_ranges->ranges_count()) << "missing items are ignored";
+
+    m_ranges->remove(10);
+    m_ranges->remove(14);
+    ASSERT_EQ(1, m_ranges->ranges_count()) << "edge items don't split the range";
+    ASSERT_EQ(11, m_ranges->start());
+    ASSERT_EQ(14, m_ranges->size());
+
+    m_ranges->remove(12);
+    m_ranges->remove(11);
+    m_ranges->remove(13);
+    ASSERT_EQ(0, m_ranges->ranges_count()) << "empty ranges are dropped";
+}
+
+// random insertions and removals of indices [0, side) compared with std::map
+// bulk operations write or erase up to 10 items from the index
+template <size_t N>
+void CheckRandomOperations(size_t side, int removals, bool bulk = false)
+{
+    RangeList<int, N> ranges;
+    std::map<size_t, int> reference;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const size_t index = rand() % side;
+        if (bulk && rand() % 2)
+        {
+            const size_t count = rand() % 10;
+            std::vector<int> values;
+            for (size_t k = 0; k < count; ++k)
+                values.push_back(i * 10 + static_cast<int>(k));
+            switch (rand() % 3)
+            {
+            case 0:
+                ranges.fill(index, count, i);
+                for (size_t k = 0; k < count; ++k)
+                    reference[index + k] = i;
+                break;
+            case 1:
+                ranges.insert_range(index, values.begin(), values.end());
+                for (size_t k = 0; k < count; ++k)
+                    reference[index + k] = values[k];
+                break;
+            default:
+                ranges.erase_range(index, count);
+                for (size_t k = 0; k < count; ++k)
+                    reference.erase(index + k);
+            }
+        }
+        else if (rand() % 6 >= removals)
+        {
+            ranges.insert(index, i);
+            reference[index] = i;
+        }
+        else
+        {
+            ranges.remove(index);
+            reference.erase(index);
+        }
+
+        // ranges are sorted, disjoint and not adjacent
+        size_t count = 0;
+        size_t last = 0;
+        ranges.visit_ranges([&](size_t start, const int*, size_t items) {
+            ASSERT_LT(0, items);
+            ASSERT_TRUE(!count++ || last < start);
+            last = start + items;
+        });
+        ASSERT_EQ(count, ranges.ranges_count());
+        ASSERT_EQ(reference.size(), ranges.stats().items);
+        if (1 == count && reference.size() <= N / 2)
+        {
+            ASSERT_TRUE(ranges.is_inline()) << "a short single range is moved to the list";
+        }
+    }
+
+    auto expected = reference.begin();
+    ranges.visit([&](size_t index, int& v) {
+        ASSERT_TRUE(reference.end() != expected);
+        ASSERT_EQ(expected->first, index);
+        ASSERT_EQ(expected->second, v);
+        ++expected;
+    });
+    ASSERT_TRUE(reference.end() == expected);
+
+    // the const iterator walks the same items
+    const RangeList<int, N>& constRanges = ranges;
+    expected = reference.begin();
+    for (auto it = constRanges.begin(); it != constRanges.end(); ++it, ++expected)
+    {
+        ASSERT_TRUE(reference.end() != expected);
+        ASSERT_EQ(expected->first, it.index());
+        ASSERT_EQ(expected->second, *it);
+    }
+    ASSERT_TRUE(reference.end() == expected);
+
+    for (size_t index = 0; index < side + 10; ++index)
+    {
+        const int* item = ranges.get_item_at(index);
+        ASSERT_EQ(reference.count(index), nullptr != item ? 1u : 0u);
+    }
+}
+
+TEST_F(RangeVectorTest, RandomOperations)
+{
+    CheckRandomOperations<RangeList<int>::c_inlineSize>(300, 2);
+    CheckRandomOperations<0>(300, 2);
+}
+
+TEST_F(RangeVectorTest, InlineRandomOperations)
+{
+    CheckRandomOperations<1>(8, 3);
+    CheckRandomOperations<4>(8, 3);
+    CheckRandomOperations<8>(12, 3);
+}
+
+TEST_F(RangeVectorTest, BulkRandomOperations)
+{
+    CheckRandomOperations<RangeList<int>::c_inlineSize>(300, 2, true);
+    CheckRandomOperations<0>(100, 2, true);
+    CheckRandomOperations<4>(12, 3, true);
+    CheckRandomOperations<16>(30, 3, true);
+}
+
+TEST_F(RangeVectorTest, FillAndEraseRange)
+{
+    m_ranges->insert(0, 1);
+    m_ranges->insert(20, 2);
+    m_ranges->insert(40, 3);
+
+    // the fill joins all three ranges
+    m_ranges->fill(1, 39, 7);
+    ASSERT_EQ(1, m_ranges->ranges_count());
+    ASSERT_EQ(1, *m_ranges->get_item_at(0));
+    ASSERT_EQ(7, *m_ranges->get_item_at(20));
+    ASSERT_EQ(3, *m_ranges->get_item_at(40));
+
+    m_ranges->erase_range(10, 5);
+    ASSERT_EQ(2, m_ranges->ranges_count());
+    ASSERT_TRUE(nullptr == m_ranges->get_item_at(10));
+    ASSERT_TRUE(nullptr == m_ranges->get_item_at(14));
+    ASSERT_EQ(7, *m_ranges->get_item_at(15));
+
+    const int values[] = {4, 5, 6};
+    m_ranges->insert_range(9, values, values + 3);
+    ASSERT_EQ(2, m_ranges->ranges_count());
+    ASSERT_EQ(4, *m_ranges->get_item_at(9));
+    ASSERT_EQ(6, *m_ranges->get_item_at(11));
+
+    m_ranges->erase_range(0, 100);
+    ASSERT_EQ(0, m_ranges->ranges_count());
+    ASSERT_TRUE(m_ranges->is_inline());
+}
+
+TEST_F(RangeVectorTest, InlineRange)
+{
+    for (size_t i = 0; i < RangeList<int>::c_inlineSize; ++i)
+        m_ranges->insert(100 - i, static_cast<int>(i));
+    ASSERT_TRUE(m_ranges->is_inline());
+    ASSERT_EQ(0, m_ranges->stats().bytes) << "nothing is allocated";
+    ASSERT_EQ(101 - RangeList<int>::c_inlineSize, m_ranges->start());
+    ASSERT_EQ(101, m_ranges->size());
+
+    // the second range moves items to the vector of ranges
+    m_ranges->insert(200, 1);
+    ASSERT_FALSE(m_ranges->is_inline());
+    ASSERT_EQ(2, m_ranges->ranges_count());
+    ASSERT_EQ(0, *m_ranges->get_item_at(100));
+    ASSERT_EQ(1, *m_ranges->get_item_at(200));
+
+    // the list copied from inline one doesn't share its items
+    RangeList<int> inlineList;
+    inlineList.insert(5, 5);
+    RangeList<int> copy(inlineList);
+    copy.insert(5, 6);
+    ASSERT_EQ(5, *inlineList.get_item_at(5));
+    ASSERT_EQ(6, *copy.get_item_at(5));
+}
+
+// pillars of the given number of ranges: every range is 4 items, ranges are split by single gaps
+class RangeListBenchmark : public ::testing::Test
+{
+public:
+    static const size_t c_lookups = 4096000;
+    static const size_t c_updates = 400000;
+
+protected:
+    static void Fill(RangeList<int>& list, size_t ranges)
+    {
+        for (size_t i = 0; i < ranges * 5; ++i)
+        {
+            if (i % 5 != 4)
+                list.insert(i, static_cast<int>(i));
+        }
+        ASSERT_EQ(ranges, list.ranges_count());
+    }
+
+    static void Lookup(size_t ranges)
+    {
+        RangeList<int> list;
+        Fill(list, ranges);
+        size_t found = 0;
+        for (size_t i = 0; i < c_lookups; ++i)
+            found += nullptr != list.get_item_at((i * 7919) % (ranges * 5));
+        ASSERT_EQ(c_lookups - c_lookups / 5, found);
+    }
+
+    // fills a gap and opens it again: ranges are merged and split
+    static void Update(size_t ranges)
+    {
+        RangeList<int> list;
+        Fill(list, ranges);
+        for (size_t i = 0; i < c_updates; ++i)
+        {
+            const size_t gap = ((i * 7919) % ranges) * 5 + 4;
+            list.insert(gap, 0);
+            list.remove(gap);
+        }
+        ASSERT_EQ(ranges, list.ranges_count());
+    }
+};
+
+const size_t RangeListBenchmark::c_lookups;
+const size_t RangeListBenchmark::c_updates;
+
+// a column of 256 items is stamped and destroyed item by item and with bulk operations
+TEST_F(RangeListBenchmark, ColumnByItems)
+{
+    RangeList<int> list;
+    for (size_t i = 0; i < c_updates / 256; ++i)
+    {
+        for (size_t y = 256; y-- > 0;)
+            list.insert(y, static_cast<int>(y));
+        for (size_t y = 0; y < 256; ++y)
+            list.remove(y);
+    }
+    ASSERT_EQ(0, list.ranges_count());
+}
+
+TEST_F(RangeListBenchmark, ColumnByRange)
+{
+    RangeList<int> list;
+    for (size_t i = 0; i < c_updates / 256; ++i)
+    {
+        list.fill(0, 256, static_cast<int>(i));
+        list.erase_range(0, 256);
+    }
+    ASSERT_EQ(0, list.ranges_count());
+}
+
+TEST_F(RangeListBenchmark, Lookup1Range)     {Lookup(1);}
+TEST_F(RangeListBenchmark, Lookup8Ranges)    {Lookup(8);}
+TEST_F(RangeListBenchmark, Lookup64Ranges)   {Lookup(64);}
+TEST_F(RangeListBenchmark, Lookup512Ranges)  {Lookup(512);}
+TEST_F(RangeListBenchmark, Update1Range)     {Update(1);}
+TEST_F(RangeListBenchmark, Update8Ranges)    {Update(8);}
+TEST_F(RangeListBenchmark, Update64Ranges)   {Update(64);}
+TEST_F(RangeListBenchmark, Update512Ranges)  {Update(512);}
+
 // eof
\ No newline at end of file
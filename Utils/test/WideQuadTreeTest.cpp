@@ -0,0 +1,472 @@
+#include "WideQuadTree.h"
+#include "QuadTree.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include <map>
+#include <string>
+
+using namespace Utils;
+
+class WideQuadTreeTest : public ::testing::Test
+{
+public:
+    static const int32_t c_size = 512;
+    void SetUp()
+    {
+        m_tree.reset(new WideQuadTree<int>(c_size));
+    }
+    void TearDown()
+    {
+        m_tree.reset();
+    }
+protected:
+    std::unique_ptr< WideQuadTree<int> > m_tree;
+};
+
+const int32_t WideQuadTreeTest::c_size;
+
+TEST_F(WideQuadTreeTest, EmptyItem)
+{
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(254, 400) );
+    ASSERT_TRUE( nullptr == m_tree->find(254, 400) );
+}
+
+TEST_F(WideQuadTreeTest, InsertedItem)
+{
+    ASSERT_NO_THROW( m_tree->insert(254, 400, 10) );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(400, 254) );
+    ASSERT_EQ(10, *m_tree->get_item_at(254, 400));
+    ASSERT_EQ(10, *m_tree->find(254, 400));
+}
+
+TEST_F(WideQuadTreeTest, GetAndCreateItem)
+{
+    ASSERT_NO_THROW( m_tree->item(254, 400) = 10 );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(400, 254) );
+    ASSERT_EQ(10, *m_tree->get_item_at(254, 400));
+}
+
+TEST_F(WideQuadTreeTest, RemoveItems)
+{
+    m_tree->insert(254, 400, 10);
+    m_tree->insert(254, 401, 15);
+    ASSERT_NO_THROW( m_tree->remove(254, 400) );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(254, 400) );
+    ASSERT_EQ( 15, *m_tree->get_item_at(254, 401) );
+    ASSERT_NO_THROW( m_tree->remove(254, 401) );
+    ASSERT_TRUE( nullptr == m_tree->get_item_at(254, 401) );
+    ASSERT_TRUE( m_tree->empty() );
+}
+
+TEST_F(WideQuadTreeTest, BoundingRectSingleItem)
+{
+    for (size_t i = 0; i < 100; ++i)
+    {
+        const int32_t X = rand() % c_size - c_size / 2;
+        const int32_t Y = rand() % c_size - c_size / 2;
+        m_tree->item(X, Y) = 10;
+        ASSERT_EQ(X, m_tree->left()) << "failed for X = " << X;
+        ASSERT_EQ(Y, m_tree->top()) << "failed for Y = " << Y;
+        ASSERT_EQ(X + 1, m_tree->right()) << "failed for X = " << X;
+        ASSERT_EQ(Y + 1, m_tree->bottom()) << "failed for Y = " << Y;
+        m_tree->remove(X, Y);
+    }
+}
+
+TEST_F(WideQuadTreeTest, BoundingRectDiagonale)
+{
+    m_tree->item(0, 0) = 10;
+    m_tree->item(1, 2) = 10;
+    m_tree->item(2, 0) = 10;
+    EXPECT_EQ(0, m_tree->left());
+    EXPECT_EQ(0, m_tree->top());
+    EXPECT_EQ(3, m_tree->right());
+    EXPECT_EQ(3, m_tree->bottom());
+}
+
+TEST_F(WideQuadTreeTest, BoundingRectSameVerticalSlice)
+{
+    for (int32_t i = 2; i < c_size; ++i)
+        m_tree->item(2, i) = 10;
+    for (int32_t i = 2; i < c_size; ++i)
+        m_tree->item(i, 2) = 10;
+    m_tree->item(c_size - 1, 1) = 10;
+    m_tree->item(1, c_size - 1) = 10;
+
+    EXPECT_EQ(1, m_tree->left()) << "the worst case: left is on the bottom";
+    EXPECT_EQ(1, m_tree->top()) << "the worst case: top is on the right";
+    EXPECT_EQ(c_size, m_tree->right());
+    EXPECT_EQ(c_size, m_tree->bottom());
+}
+
+TEST_F(WideQuadTreeTest, ExtremeCoordinates)
+{
+    m_tree->item(INT32_MIN, INT32_MIN) = 1;
+    m_tree->item(INT32_MAX, INT32_MAX) = 2;
+    ASSERT_EQ(1, *m_tree->get_item_at(INT32_MIN, INT32_MIN));
+    ASSERT_EQ(2, *m_tree->get_item_at(INT32_MAX, INT32_MAX));
+    EXPECT_EQ(INT32_MIN, m_tree->left());
+    EXPECT_EQ(INT32_MIN, m_tree->top());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->right());
+    EXPECT_EQ(int64_t(INT32_MAX) + 1, m_tree->bottom());
+
+    int count = 0;
+    m_tree->visit([&](int32_t x, int32_t y, int& v)
+    {
+        EXPECT_EQ(x, y);
+        EXPECT_EQ((count ? INT32_MAX : INT32_MIN), x);
+        EXPECT_EQ(++count, v);
+    });
+    EXPECT_EQ(2, count);
+}
+
+TEST_F(WideQuadTreeTest, GrowAndShrink)
+{
+    const uint64_t initialSide = m_tree->side();
+    m_tree->item(0, 0) = 1;
+    m_tree->item(-3, 2) = 2;
+    EXPECT_EQ(initialSide, m_tree->side()) << "items fit to the initial area";
+
+    m_tree->item(100000, 0) = 3;
+    EXPECT_LE(200000u, m_tree->side()) << "tree should grow to fit far items";
+    ASSERT_EQ(1, *m_tree->get_item_at(0, 0));
+    ASSERT_EQ(2, *m_tree->get_item_at(-3, 2));
+
+    m_tree->remove(100000, 0);
+    EXPECT_EQ(initialSide, m_tree->side()) << "tree should shrink back when far items are removed";
+    ASSERT_EQ(1, *m_tree->get_item_at(0, 0));
+    ASSERT_EQ(2, *m_tree->get_item_at(-3, 2));
+    ASSERT_TRUE(nullptr == m_tree->get_item_at(100000, 0));
+}
+
+TEST_F(WideQuadTreeTest, VisitInQuadTreeOrder)
+{
+    QuadTree<int> reference(c_size);
+    for (int i = 0; i < 1000; ++i)
+    {
+        const int32_t x = rand() % (4 * c_size) - 2 * c_size;
+        const int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference.item(x, y) = i;
+    }
+
+    std::vector<int32_t> expected;
+    reference.visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+    std::vector<int32_t> actual;
+    m_tree->for_each([&](int32_t x, int32_t y, int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+}
+
+TEST_F(WideQuadTreeTest, VisitUpdateItems)
+{
+    for (int32_t i = 0; i < c_size; ++i)
+        m_tree->item(i, i) = 10;
+
+    m_tree->visit([&](int32_t, int32_t, int& v){v = 100;});
+
+    for (int32_t i = 0; i < c_size; ++i)
+        ASSERT_EQ(100, *m_tree->get_item_at(i, i)) << "update visited element failed on [" << i << "," << i << "]th";
+}
+
+TEST_F(WideQuadTreeTest, QueryRegion)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = i;
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        const int32_t x0 = rand() % c_size - c_size / 2, x1 = x0 + rand() % 100;
+        const int32_t y0 = rand() % c_size - c_size / 2, y1 = y0 + rand() % 100;
+        std::vector<int32_t> expected;
+        m_tree->visit([&](int32_t x, int32_t y, int& v) {
+            if (x0 <= x && x < x1 && y0 <= y && y < y1)
+            {
+                expected.push_back(x); expected.push_back(y); expected.push_back(v);
+            }
+        });
+        std::vector<int32_t> actual;
+        m_tree->query(x0, y0, x1, y1, [&](int32_t x, int32_t y, int& v) {
+            actual.push_back(x); actual.push_back(y); actual.push_back(v);
+        });
+        ASSERT_EQ(expected, actual) << "[" << x0 << "," << y0 << "] - [" << x1 << "," << y1 << "]";
+        ASSERT_EQ(expected.size() / 3, m_tree->count(x0, y0, x1, y1));
+    }
+    EXPECT_EQ(m_tree->stats().leaves, m_tree->count(INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX));
+}
+
+TEST_F(WideQuadTreeTest, AssignMatchesInsertion)
+{
+    std::vector<WideQuadTree<int>::Item> items;
+    for (int i = 0; i < 10000; ++i)
+    {
+        WideQuadTree<int>::Item item = {rand() % (4 * c_size) - 2 * c_size, rand() % c_size - c_size / 2, i};
+        items.push_back(item);
+    }
+    QuadTree<int> reference(c_size);
+    for (auto& item : items)
+        reference.item(item.x, item.y) = item.value;
+
+    std::vector<int32_t> expected;
+    reference.visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+
+    m_tree->item(100000, 100000) = -1;
+    m_tree->assign(items.begin(), items.end());
+    std::vector<int32_t> actual;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+    ASSERT_EQ(reference.left(), m_tree->left());
+    ASSERT_EQ(reference.right(), m_tree->right());
+}
+
+TEST_F(WideQuadTreeTest, ParallelForEach)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        m_tree->item(rand() % c_size - c_size / 2, rand() % c_size - c_size / 2) = i;
+    }
+
+    std::vector<int32_t> expected;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+        v = -v;
+    });
+
+    m_tree->parallel_for_each([&](int32_t, int32_t, int& v) {v = -v;});
+    for (size_t i = 0; i < expected.size(); i += 3)
+        ASSERT_EQ(expected[i + 2], *m_tree->get_item_at(expected[i], expected[i + 1]));
+
+    for (size_t depth = 0; depth < 4; ++depth)
+    {
+        std::vector<int32_t> actual = m_tree->parallel_reduce(std::vector<int32_t>(),
+            [&](int32_t x, int32_t y, int& v, std::vector<int32_t>& out) {
+                out.push_back(x); out.push_back(y); out.push_back(v);
+            },
+            [](std::vector<int32_t>& result, std::vector<int32_t>& part) {
+                result.insert(result.end(), part.begin(), part.end());
+            }, depth);
+        ASSERT_EQ(expected, actual) << "split depth " << depth;
+    }
+}
+
+TEST_F(WideQuadTreeTest, SnapshotKeepsState)
+{
+    std::map<std::pair<int32_t, int32_t>, int> reference;
+    for (int i = 0; i < 2000; ++i)
+    {
+        const int32_t x = rand() % c_size - c_size / 2;
+        const int32_t y = rand() % c_size - c_size / 2;
+        m_tree->item(x, y) = i;
+        reference[std::make_pair(x, y)] = i;
+    }
+    std::vector<int32_t> expected;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        expected.push_back(x); expected.push_back(y); expected.push_back(v);
+    });
+
+    WideQuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    for (int i = 0; i < 20000; ++i)
+    {
+        // the area grows and shrinks as well
+        const int32_t x = rand() % (8 * c_size) - 4 * c_size;
+        const int32_t y = rand() % c_size - c_size / 2;
+        if (rand() % 2)
+        {
+            m_tree->item(x, y) = -i;
+            reference[std::make_pair(x, y)] = -i;
+        }
+        else
+        {
+            m_tree->remove(x, y);
+            reference.erase(std::make_pair(x, y));
+        }
+        if (i % 1000 == 0)
+        {
+            // released snapshots don't affect the tree
+            WideQuadTree<int>::Snapshot temporary = m_tree->snapshot();
+            m_tree->parallel_for_each([](int32_t, int32_t, int& v) {v *= 2;});
+            m_tree->visit([](int32_t, int32_t, int& v) {v /= 2;});
+        }
+    }
+
+    std::vector<int32_t> actual;
+    snapshot.visit([&](int32_t x, int32_t y, const int& v) {
+        actual.push_back(x); actual.push_back(y); actual.push_back(v);
+    });
+    ASSERT_EQ(expected, actual);
+    for (size_t i = 0; i < expected.size(); i += 3)
+        ASSERT_EQ(expected[i + 2], *snapshot.find(expected[i], expected[i + 1]));
+
+    size_t count = 0;
+    m_tree->visit([&](int32_t x, int32_t y, int& v) {
+        ++count;
+        ASSERT_EQ(reference[std::make_pair(x, y)], v);
+    });
+    ASSERT_EQ(reference.size(), count);
+}
+
+TEST_F(WideQuadTreeTest, SnapshotOutlivesTree)
+{
+    m_tree->item(1, 2) = 3;
+    WideQuadTree<int>::Snapshot snapshot = m_tree->snapshot();
+    m_tree->item(1, 2) = 4;
+    m_tree.reset();
+    ASSERT_EQ(3, *snapshot.find(1, 2));
+}
+
+TEST_F(WideQuadTreeTest, ItemsOwningMemory)
+{
+    // values are moved between node arrays of different capacities
+    WideQuadTree<std::string> tree;
+    for (int32_t i = 0; i < 200; ++i)
+        tree.item(i % 20, i / 20) = std::string(40, char('a' + i % 26));
+    WideQuadTree<std::string>::Snapshot snapshot = tree.snapshot();
+    for (int32_t i = 0; i < 200; i += 2)
+        tree.remove(i % 20, i / 20);
+    for (int32_t i = 0; i < 200; ++i)
+    {
+        ASSERT_EQ(std::string(40, char('a' + i % 26)), *snapshot.find(i % 20, i / 20));
+        if (i % 2)
+            ASSERT_EQ(std::string(40, char('a' + i % 26)), *tree.find(i % 20, i / 20));
+        else
+            ASSERT_TRUE(nullptr == tree.find(i % 20, i / 20));
+    }
+}
+
+TEST_F(WideQuadTreeTest, Stats)
+{
+    TreeStats stats = m_tree->stats();
+    ASSERT_EQ(6, stats.nodes.size()) << "5 levels of 1024x1024 tree and items";
+    EXPECT_EQ(1, stats.nodes[0]);
+    EXPECT_EQ(0, stats.leaves);
+
+    // a full leaf: arrays hold occupied slots only
+    for (int32_t i = 0; i < 16; ++i)
+        m_tree->item(i % 4, i / 4) = i;
+    stats = m_tree->stats();
+    for (size_t level = 0; level < 5; ++level)
+        EXPECT_EQ(1, stats.nodes[level]) << level;
+    EXPECT_EQ(16, stats.leaves);
+    EXPECT_DOUBLE_EQ(1.0, stats.fill) << "single child paths and the full leaf";
+}
+
+TEST(WideQuadTree8x8Test, RandomOperations)
+{
+    const int32_t side = 1024;
+    WideQuadTree<int, 3> tree(side);
+    QuadTree<int> reference(side);
+    for (int i = 0; i < 100000; ++i)
+    {
+        const int32_t x = rand() % side - side / 2;
+        const int32_t y = rand() % 64 - 32;
+        if (rand() % 3)
+        {
+            tree.insert(x, y, i);
+            reference.insert(x, y, i);
+        }
+        else
+        {
+            tree.remove(x, y);
+            reference.remove(x, y);
+        }
+        int* expected = reference.get_item_at(x, y);
+        int* actual = tree.get_item_at(x, y);
+        ASSERT_EQ(nullptr == expected, nullptr == actual);
+        if (expected)
+        {
+            ASSERT_EQ(*expected, *actual);
+        }
+    }
+
+    EXPECT_EQ(reference.left(), tree.left());
+    EXPECT_EQ(reference.top(), tree.top());
+    EXPECT_EQ(reference.right(), tree.right());
+    EXPECT_EQ(reference.bottom(), tree.bottom());
+
+    size_t count = 0;
+    reference.visit([&](int32_t x, int32_t y, int& v) {
+        ++count;
+        ASSERT_EQ(v, *tree.get_item_at(x, y));
+    });
+    size_t actualCount = 0;
+    tree.visit([&](int32_t, int32_t, int&) { ++actualCount; });
+    ASSERT_EQ(count, actualCount);
+}
+
+class WideQuadTreeBerthBenchmark : public ::testing::Test
+{
+public:
+    static const int32_t c_side     = 256;
+    static const size_t c_pillars   = 16384;
+    static const size_t c_passes    = 20;
+
+    static void SetUpTestCase()
+    {
+        m_tree.reset(new WideQuadTree<int>(c_side));
+        x.resize(c_pillars);
+        y.resize(c_pillars);
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            x[i] = rand() % c_side - c_side / 2;
+            y[i] = rand() % c_side - c_side / 2;
+        }
+    }
+    static void TearDownTestCase()
+    {
+        m_tree.reset();
+    }
+protected:
+    static std::vector<int32_t> x;
+    static std::vector<int32_t> y;
+    static std::unique_ptr< WideQuadTree<int> > m_tree;
+};
+
+std::vector<int32_t> WideQuadTreeBerthBenchmark::x;
+std::vector<int32_t> WideQuadTreeBerthBenchmark::y;
+std::unique_ptr< WideQuadTree<int> > WideQuadTreeBerthBenchmark::m_tree;
+
+TEST_F(WideQuadTreeBerthBenchmark, InsertPerformance)
+{
+    for (size_t pass = 0; pass < c_passes; ++pass)
+    {
+        m_tree->clear();
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            m_tree->item(x[i], y[i]) = static_cast<int>(i);
+        }
+    }
+}
+
+TEST_F(WideQuadTreeBerthBenchmark, LookupPerformance)
+{
+    size_t found = 0;
+    for (size_t pass = 0; pass < c_passes * 10; ++pass)
+    {
+        for (size_t i = 0; i < c_pillars; ++i)
+        {
+            found += (nullptr != m_tree->find(x[i], y[i]));
+        }
+    }
+    ASSERT_EQ(c_passes * 10 * c_pillars, found);
+}
+
+TEST_F(WideQuadTreeBerthBenchmark, BoundingRectPerformance)
+{
+    int64_t sum = 0;
+    for (size_t pass = 0; pass < c_passes * 1000; ++pass)
+    {
+        sum += (m_tree->right() - m_tree->left()) + (m_tree->bottom() - m_tree->top());
+    }
+    ASSERT_NE(0, sum);
+}
+// eof